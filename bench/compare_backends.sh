@@ -0,0 +1,32 @@
+#!/bin/sh
+# Runs the same irc_load workload against each event loop backend and prints one
+# result line per backend, followed by the server's send counters(replies
+# written per send syscall, per worker).
+#
+# Usage: bench/compare_backends.sh [irc_load options]
+# Environment: PORT(default 6790), WORKERS(default 1),
+#              BACKENDS(default "poll epoll epoll-et uring")
+#
+# The server is built separately(bench/ircserv_bench, LOG_LEVEL=WARNING) so the
+# per-message INFO logging doesn't hide the event loop cost.
+
+cd "$(dirname "$0")/.." || exit 1
+PORT=${PORT:-6790}
+WORKERS=${WORKERS:-1}
+BACKENDS=${BACKENDS:-"poll epoll epoll-et uring"}
+PASS=pass1234
+OUT=bench/ircserv_bench.out
+
+make -s re NAME=bench/ircserv_bench OBJS_DIR=bench/objs LOG_LEVEL=WARNING > /dev/null || exit 1
+make -s bench > /dev/null || exit 1
+
+for backend in $BACKENDS; do
+	./bench/ircserv_bench "$PORT" "$PASS" --workers "$WORKERS" --backend "$backend" > "$OUT" 2>&1 &
+	pid=$!
+	sleep 0.5
+	./bench/irc_load --port "$PORT" --pass "$PASS" --pid "$pid" --label "$backend" "$@"
+	kill -INT "$pid"
+	wait "$pid"
+	grep "stats:" "$OUT" | awk '{ printf "  %s, %.1f replies per send call\n", $0, ($7 ? $4 / $7 : 0) }'
+done
+rm -f "$OUT"
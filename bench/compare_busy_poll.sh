@@ -0,0 +1,47 @@
+#!/bin/sh
+# Runs the same latency workload with sleeping event loops and with busy polling
+# (--busy-poll USEC) and prints the relay latency seen by the clients(p50/p99
+# from irc_load), followed by the server's own view: its relay latency(from
+# the turn reading a line to the send call writing the reply) and how often
+# the spinning caught the events before the loops went to sleep.
+#
+# Usage: bench/compare_busy_poll.sh [irc_load options]
+# Environment: PORT(default 6792), WORKERS(default 1), BACKEND(default epoll-et),
+#              WINDOWS(default "0 50", 0 runs without --busy-poll)
+#
+# The default workload keeps a single message in flight per sender, so the
+# loops sleep between messages and every one pays the wakeup. Busy polling
+# costs a core per worker while it spins: compare the CPU time too.
+
+cd "$(dirname "$0")/.." || exit 1
+PORT=${PORT:-6792}
+WORKERS=${WORKERS:-1}
+BACKEND=${BACKEND:-epoll-et}
+WINDOWS=${WINDOWS:-"0 50"}
+PASS=pass1234
+OUT=bench/ircserv_bench.out
+
+if [ $# -eq 0 ]; then
+	set -- --clients 50 --senders 2 --messages 5000 --size 100 --window 1
+fi
+
+make -s re NAME=bench/ircserv_bench OBJS_DIR=bench/objs LOG_LEVEL=WARNING > /dev/null || exit 1
+make -s bench > /dev/null || exit 1
+
+for usec in $WINDOWS; do
+	if [ "$usec" -eq 0 ]; then
+		label=sleep
+		busy_poll=""
+	else
+		label="busy-poll=${usec}us"
+		busy_poll="--busy-poll $usec"
+	fi
+	./bench/ircserv_bench "$PORT" "$PASS" --workers "$WORKERS" --backend "$BACKEND" $busy_poll > "$OUT" 2>&1 &
+	pid=$!
+	sleep 0.5
+	./bench/irc_load --port "$PORT" --pass "$PASS" --pid "$pid" --label "$label" "$@"
+	kill -INT "$pid"
+	wait "$pid"
+	grep -e "stats:" -e "Relay latency:" "$OUT" | sed 's/^/  /'
+done
+rm -f "$OUT"
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Runs the same broadcast workload with plain sends and with MSG_ZEROCOPY
+# (--zerocopy BYTES) and prints the server CPU time per GB delivered, followed
+# by the server's send counters.
+#
+# Usage: bench/compare_zerocopy.sh [irc_load options]
+# Environment: PORT(default 6791), WORKERS(default 1), BACKEND(default epoll-et),
+#              THRESHOLDS(default "0 16384", 0 runs without --zerocopy)
+#
+# The default workload sends big lines to a big channel, so a member's replies
+# of one turn add up to sendmsg() calls of tens of KB. Over loopback the kernel
+# copies the data anyway(the completions say so and the server stops using
+# zerocopy on that socket); the saving only shows on a real NIC, run irc_load
+# from another host with --host.
+
+cd "$(dirname "$0")/.." || exit 1
+PORT=${PORT:-6791}
+WORKERS=${WORKERS:-1}
+BACKEND=${BACKEND:-epoll-et}
+THRESHOLDS=${THRESHOLDS:-"0 16384"}
+PASS=pass1234
+OUT=bench/ircserv_bench.out
+
+if [ $# -eq 0 ]; then
+	set -- --clients 500 --senders 4 --messages 200 --size 4000 --window 16
+fi
+
+make -s re NAME=bench/ircserv_bench OBJS_DIR=bench/objs LOG_LEVEL=WARNING > /dev/null || exit 1
+make -s bench > /dev/null || exit 1
+
+for min in $THRESHOLDS; do
+	if [ "$min" -eq 0 ]; then
+		label=copy
+		zerocopy=""
+	else
+		label="zerocopy>=$min"
+		zerocopy="--zerocopy $min"
+	fi
+	./bench/ircserv_bench "$PORT" "$PASS" --workers "$WORKERS" --backend "$BACKEND" $zerocopy > "$OUT" 2>&1 &
+	pid=$!
+	sleep 0.5
+	./bench/irc_load --port "$PORT" --pass "$PASS" --pid "$pid" --label "$label" "$@"
+	kill -INT "$pid"
+	wait "$pid"
+	grep "stats:" "$OUT" | sed 's/^/  /'
+done
+rm -f "$OUT"
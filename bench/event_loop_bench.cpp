@@ -0,0 +1,350 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   event_loop_bench.cpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * @brief Micro benchmark of the EventLoop backends, without the IRC part.
+ *
+ * For every backend and every connection count it makes that many socketpairs
+ * and registers one end of each as a Client of the loop, which runs on its own
+ * thread. The driver writes to the other ends:
+ *  - wakeup latency: one timestamped line at a time to a random connection,
+ *    the time until the loop hands it to onData();
+ *  - throughput: lines round robin over all connections with at most --window
+ *    of them not yet seen by the loop, for --seconds. events/s counts the
+ *    onData() calls, several lines on one socket can share one.
+ *
+ * Build with `make bench`, run as root to get past the open file limit with
+ * 10k connections.
+ */
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include "EventLoop.hpp"
+#include "Client.hpp"
+
+struct Options{
+	std::vector<BACKEND>	backends = {BACKEND::POLL, BACKEND::EPOLL, BACKEND::EPOLL_ET, BACKEND::URING};
+	std::vector<int>		conns = {100, 1000, 10000};
+	double					seconds = 1.0; // of the throughput phase
+	int						samples = 2000; // of the latency phase
+	long					window = 256;
+};
+
+static const char*	backendName(BACKEND backend){
+	switch (backend){
+		case BACKEND::POLL: return "poll";
+		case BACKEND::EPOLL: return "epoll";
+		case BACKEND::EPOLL_ET: return "epoll-et";
+		case BACKEND::URING: return "io_uring";
+	}
+	return "?";
+}
+
+static long	nowNs(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void	usage(){
+	std::cerr << "Usage: event_loop_bench [--backend poll|epoll|epoll-et|uring]..."
+		" [--conns N]... [--seconds S] [--samples N] [--window N]\n";
+	exit(EXIT_FAILURE);
+}
+
+static Options	parseOptions(int ac, char** av){
+	Options	opt;
+	bool	own_backends = false;
+	bool	own_conns = false;
+	for (int i = 1; i < ac; i++){
+		std::string	key = av[i];
+		if (i + 1 >= ac){
+			usage();
+		}
+		std::string	value = av[++i];
+		if (key == "--backend"){
+			if (!own_backends){
+				opt.backends.clear();
+				own_backends = true;
+			}
+			if (value == "poll") opt.backends.push_back(BACKEND::POLL);
+			else if (value == "epoll") opt.backends.push_back(BACKEND::EPOLL);
+			else if (value == "epoll-et") opt.backends.push_back(BACKEND::EPOLL_ET);
+			else if (value == "uring") opt.backends.push_back(BACKEND::URING);
+			else usage();
+		} else if (key == "--conns"){
+			if (!own_conns){
+				opt.conns.clear();
+				own_conns = true;
+			}
+			opt.conns.push_back(std::stoi(value));
+		}
+		else if (key == "--seconds") opt.seconds = std::stod(value);
+		else if (key == "--samples") opt.samples = std::stoi(value);
+		else if (key == "--window") opt.window = std::stol(value);
+		else usage();
+	}
+	for (int n : opt.conns){
+		if (n < 1){
+			usage();
+		}
+	}
+	if (opt.seconds <= 0 || opt.samples < 1 || opt.window < 1){
+		usage();
+	}
+	return opt;
+}
+
+/**
+ * @brief Make room for 2 fds per connection, root may also raise the hard limit.
+ */
+static void	raiseFdLimit(int n_conns){
+	rlim_t	need = 2 * static_cast<rlim_t>(n_conns) + 64;
+	rlimit	lim;
+	if (getrlimit(RLIMIT_NOFILE, &lim) != 0 || lim.rlim_cur >= need){
+		return;
+	}
+	lim.rlim_cur = need;
+	if (lim.rlim_max < need){
+		lim.rlim_max = need;
+	}
+	if (setrlimit(RLIMIT_NOFILE, &lim) != 0){
+		throw std::runtime_error("can't open " + std::to_string(need) + " files: "
+			+ strerror(errno));
+	}
+}
+
+/**
+ * @brief Counts what the loop delivers. Only the loop thread writes, the driver
+ * reads the counters.
+ */
+class Sink : public EventHandler{
+	public:
+		std::atomic<long>	messages{0};
+		std::atomic<long>	events{0};
+		std::vector<long>	latencies; // ns, read once the driver saw the count
+		bool				record = false;
+
+		std::shared_ptr<Client>	onAccept(int fd, const std::string&) override{
+			close(fd);
+			return nullptr;
+		}
+
+		bool	onData(Client& cli) override{
+			std::string_view	line;
+			long				n_lines = 0;
+			while (cli.getNextMessage(line)){
+				if (record){
+					long	sent = 0;
+					std::from_chars(line.data(), line.data() + line.size(), sent);
+					latencies.push_back(nowNs() - sent);
+				}
+				n_lines++;
+			}
+			events.fetch_add(1, std::memory_order_relaxed);
+			messages.fetch_add(n_lines, std::memory_order_release);
+			return false;
+		}
+
+		void	onDisconnect(Client& cli, const std::string& reason) override{
+			throw std::runtime_error("client " + std::to_string(cli.getSocketFd()) + ": " + reason);
+		}
+
+		void	onWriteError(Client&) override{}
+		void	onWake() override{}
+		void	onTick(uint64_t) override{}
+};
+
+class Run{
+	public:
+		Run(const Options& opt, BACKEND backend, int n_conns)
+			: opt_(opt), n_conns_(n_conns), stop_(false){
+			loop_ = EventLoop::create(backend);
+			for (int i = 0; i < n_conns; i++){
+				int	sv[2];
+				if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) != 0){
+					throw std::runtime_error("socketpair: " + std::string(strerror(errno)));
+				}
+				peers_.push_back(sv[0]);
+				clients_.push_back(std::make_shared<Client>(sv[1], "bench"));
+				loop_->addClient(clients_.back());
+				// let io_uring submit the armed receives before its queue fills up
+				if (i % 256 == 255){
+					settle();
+				}
+			}
+			settle();
+		}
+
+		~Run(){
+			if (thread_.joinable()){
+				stop_ = true;
+				loop_->wake();
+				thread_.join();
+			}
+			// closing an io_uring cancels what is still in flight
+			loop_.reset();
+			for (int fd : peers_){
+				close(fd);
+			}
+			for (auto& cli : clients_){
+				close(cli->getSocketFd());
+			}
+		}
+
+		const char*	getName() const{
+			return loop_->getName();
+		}
+
+		void	start(){
+			thread_ = std::thread([this](){
+				while (!stop_){
+					loop_->runOnce(sink_);
+				}
+			});
+		}
+
+		/**
+		 * @brief One line at a time, to a random connection.
+		 *
+		 * @return p50 and p99 in us
+		 */
+		std::pair<double, double>	measureLatency(){
+			std::mt19937	rng(42);
+			sink_.latencies.reserve(opt_.samples);
+			sink_.record = true;
+			long	base = sink_.messages.load(std::memory_order_acquire);
+			for (int i = 0; i < opt_.samples; i++){
+				sendLine(peers_[rng() % n_conns_]);
+				waitFor(base + i + 1);
+			}
+			sink_.record = false;
+			std::vector<long>&	lat = sink_.latencies;
+			return {percentile(lat, 0.50) / 1e3, percentile(lat, 0.99) / 1e3};
+		}
+
+		/**
+		 * @return events/s and lines/s
+		 */
+		std::pair<double, double>	measureThroughput(){
+			long	base_messages = sink_.messages.load(std::memory_order_acquire);
+			long	base_events = sink_.events.load();
+			long	sent = 0;
+			long	start = nowNs();
+			long	deadline = start + static_cast<long>(opt_.seconds * 1e9);
+			for (size_t next = 0; nowNs() < deadline; ){
+				if (sent - (sink_.messages.load(std::memory_order_acquire) - base_messages) >= opt_.window){
+					std::this_thread::yield();
+					continue;
+				}
+				sendLine(peers_[next]);
+				next = (next + 1) % peers_.size();
+				sent++;
+			}
+			waitFor(base_messages + sent);
+			double	elapsed = (nowNs() - start) / 1e9;
+			return {(sink_.events.load() - base_events) / elapsed, sent / elapsed};
+		}
+
+	private:
+		const Options&							opt_;
+		int										n_conns_;
+		std::unique_ptr<EventLoop>				loop_;
+		std::vector<int>						peers_; // the driver's ends
+		std::vector<std::shared_ptr<Client>>	clients_;
+		Sink									sink_;
+		std::atomic<bool>						stop_;
+		std::thread								thread_;
+
+		// one turn of the loop on this thread, before start()
+		void	settle(){
+			loop_->wake();
+			loop_->runOnce(sink_);
+		}
+
+		void	sendLine(int fd){
+			std::string	line = std::to_string(nowNs()) + "\r\n";
+			while (send(fd, line.data(), line.size(), MSG_NOSIGNAL) < 0){
+				if (errno != EINTR && errno != EAGAIN){
+					throw std::runtime_error("send: " + std::string(strerror(errno)));
+				}
+			}
+		}
+
+		void	waitFor(long n_messages){
+			long	deadline = nowNs() + 10 * 1000000000L;
+			while (sink_.messages.load(std::memory_order_acquire) < n_messages){
+				if (nowNs() > deadline){
+					throw std::runtime_error("the loop stopped delivering");
+				}
+				std::this_thread::yield();
+			}
+		}
+
+		static double	percentile(std::vector<long>& values, double p){
+			if (values.empty()){
+				return 0;
+			}
+			size_t	k = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+			std::nth_element(values.begin(), values.begin() + k, values.end());
+			return values[k];
+		}
+};
+
+int	main(int ac, char** av){
+	std::ostream&	report = std::cout;
+	try {
+		Options	opt = parseOptions(ac, av);
+		report << std::left << std::setw(10) << "backend" << std::right << std::setw(7)
+			<< "conns" << std::setw(12) << "events/s" << std::setw(12) << "lines/s"
+			<< std::setw(11) << "p50 us" << std::setw(11) << "p99 us" << std::endl;
+		for (BACKEND backend : opt.backends){
+			for (int n_conns : opt.conns){
+				try {
+					raiseFdLimit(n_conns);
+				} catch (const std::exception& e){
+					report << std::left << std::setw(10) << backendName(backend) << std::right
+						<< std::setw(7) << n_conns << "  skipped, " << e.what() << std::endl;
+					continue;
+				}
+				Run	run(opt, backend, n_conns);
+				run.start();
+				auto	[p50, p99] = run.measureLatency();
+				auto	[events, lines] = run.measureThroughput();
+				report << std::left << std::setw(10) << run.getName() << std::right
+					<< std::setw(7) << n_conns << std::fixed << std::setprecision(0)
+					<< std::setw(12) << events << std::setw(12) << lines
+					<< std::setprecision(1) << std::setw(11) << p50 << std::setw(11) << p99
+					<< std::endl;
+			}
+		}
+		return EXIT_SUCCESS;
+	} catch (const std::exception& e){
+		std::cerr << "event_loop_bench: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
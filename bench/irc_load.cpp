@@ -0,0 +1,383 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   irc_load.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/23 16:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/23 16:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * @brief Load generator for the benchmarks in this directory.
+ *
+ * It opens --clients connections, registers them and joins all of them to one
+ * channel. Then --senders of them send --messages PRIVMSGs each, every one
+ * carrying its send time, and every other member counts what it receives. At
+ * most --window messages per sender are on the way at once, so the server is
+ * measured, not its send queue limit.
+ *
+ * The report is the delivery rate, the relay latency and, with --pid, the CPU
+ * time the server used for the run(from /proc/<pid>/stat), per message and per
+ * GB of PRIVMSG lines delivered.
+ *
+ * Build with `make bench`.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#define CHANNEL "#bench"
+
+struct Options{
+	std::string	host = "127.0.0.1";
+	int			port = 6667;
+	std::string	pass = "pass1234";
+	int			clients = 50;
+	int			senders = 5;
+	long		messages = 2000;
+	size_t		size = 100; // bytes of PRIVMSG text
+	long		window = 32;
+	int			pid = 0; // server process, for the CPU time
+	int			timeout = 30; // seconds without progress before giving up
+	std::string	label = "run";
+};
+
+struct Conn{
+	int			fd = -1;
+	std::string	nick;
+	std::string	in;
+	std::string	out;
+	bool		joined = false;
+	long		sent = 0;
+	long		delivered = 0; // deliveries of this client's messages to the others
+};
+
+static long	nowNs(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void	usage(){
+	std::cerr << "Usage: irc_load [--host H] [--port P] [--pass PW] [--clients N]"
+		" [--senders N] [--messages N] [--size BYTES] [--window N] [--pid PID]"
+		" [--timeout SEC] [--label NAME]\n";
+	exit(EXIT_FAILURE);
+}
+
+static Options	parseOptions(int ac, char** av){
+	Options	opt;
+	for (int i = 1; i < ac; i++){
+		std::string	key = av[i];
+		if (i + 1 >= ac){
+			usage();
+		}
+		std::string	value = av[++i];
+		if (key == "--host") opt.host = value;
+		else if (key == "--port") opt.port = std::stoi(value);
+		else if (key == "--pass") opt.pass = value;
+		else if (key == "--clients") opt.clients = std::stoi(value);
+		else if (key == "--senders") opt.senders = std::stoi(value);
+		else if (key == "--messages") opt.messages = std::stol(value);
+		else if (key == "--size") opt.size = std::stoul(value);
+		else if (key == "--window") opt.window = std::stol(value);
+		else if (key == "--pid") opt.pid = std::stoi(value);
+		else if (key == "--timeout") opt.timeout = std::stoi(value);
+		else if (key == "--label") opt.label = value;
+		else usage();
+	}
+	if (opt.clients < 2 || opt.senders < 1 || opt.senders > opt.clients
+		|| opt.messages < 1 || opt.size < 32 || opt.window < 1){
+		usage();
+	}
+	return opt;
+}
+
+/**
+ * @brief utime + stime of a process in seconds, 0 without a pid.
+ */
+static double	cpuSeconds(int pid){
+	if (pid <= 0){
+		return 0;
+	}
+	std::ifstream	file("/proc/" + std::to_string(pid) + "/stat");
+	std::string		stat;
+	std::getline(file, stat);
+	// the command name can hold spaces, count the fields after it
+	std::istringstream	fields(stat.substr(stat.rfind(')') + 2));
+	std::string			field;
+	unsigned long		utime = 0, stime = 0;
+	for (int n = 3; fields >> field; n++){
+		if (n == 14) utime = std::stoul(field);
+		if (n == 15){
+			stime = std::stoul(field);
+			break;
+		}
+	}
+	return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static int	connectTo(const Options& opt){
+	int	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0){
+		throw std::runtime_error("socket: " + std::string(strerror(errno)));
+	}
+	sockaddr_in	addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(opt.port);
+	if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1){
+		throw std::runtime_error("bad host " + opt.host);
+	}
+	if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+		throw std::runtime_error("connect: " + std::string(strerror(errno)));
+	}
+	int	one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	return fd;
+}
+
+class Load{
+	public:
+		Load(const Options& opt) : opt_(opt), epoll_fd_(epoll_create1(0)),
+			receivers_(opt.clients - 1), total_(opt.senders * opt.messages * receivers_),
+			delivered_(0){
+			if (epoll_fd_ < 0){
+				throw std::runtime_error("epoll_create1: " + std::string(strerror(errno)));
+			}
+			latencies_.reserve(total_);
+		}
+
+		~Load(){
+			for (auto& c : conns_){
+				if (c.fd >= 0) close(c.fd);
+			}
+			close(epoll_fd_);
+		}
+
+		int	run(){
+			connectAll();
+			if (!waitFor([this]{ return joined_ == opt_.clients; })){
+				std::cerr << opt_.label << ": clients did not get into " CHANNEL "\n";
+				return EXIT_FAILURE;
+			}
+			double	cpu_start = cpuSeconds(opt_.pid);
+			long	start = nowNs();
+			fillSenders();
+			bool	done = waitFor([this]{ return delivered_ == total_; });
+			double	elapsed = (nowNs() - start) / 1e9;
+			double	cpu = cpuSeconds(opt_.pid) - cpu_start;
+			report(elapsed, cpu);
+			return done ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+	private:
+		Options				opt_;
+		int					epoll_fd_;
+		long				receivers_;
+		long				total_; // deliveries expected
+		long				delivered_;
+		long long			delivered_bytes_ = 0; // the delivered lines with CRLF
+		int					joined_ = 0;
+		std::vector<Conn>	conns_;
+		std::vector<long>	latencies_; // ns
+
+		void	connectAll(){
+			conns_.resize(opt_.clients);
+			for (int i = 0; i < opt_.clients; i++){
+				Conn&	c = conns_[i];
+				c.fd = connectTo(opt_);
+				c.nick = "b" + std::to_string(i);
+				epoll_event	ev{};
+				ev.events = EPOLLIN;
+				ev.data.u32 = i;
+				epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, c.fd, &ev);
+				write(i, "PASS " + opt_.pass + "\r\nNICK " + c.nick + "\r\nUSER " + c.nick
+					+ " 0 * :" + c.nick + "\r\nJOIN " CHANNEL "\r\n");
+			}
+		}
+
+		/**
+		 * @brief Run the event loop until done() or no progress for --timeout.
+		 */
+		template <typename Done>
+		bool	waitFor(Done done){
+			std::vector<epoll_event>	events(256);
+			long	last_progress = nowNs();
+			long	last_count = delivered_ + joined_;
+			while (!done()){
+				int	n = epoll_wait(epoll_fd_, events.data(), events.size(), 100);
+				if (n < 0 && errno != EINTR){
+					throw std::runtime_error("epoll_wait: " + std::string(strerror(errno)));
+				}
+				for (int i = 0; i < n; i++){
+					int	idx = events[i].data.u32;
+					if (events[i].events & EPOLLOUT){
+						flush(idx);
+					}
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+						readFrom(idx);
+					}
+				}
+				if (delivered_ + joined_ != last_count){
+					last_count = delivered_ + joined_;
+					last_progress = nowNs();
+				} else if (nowNs() - last_progress > opt_.timeout * 1000000000L){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void	readFrom(int idx){
+			Conn&	c = conns_[idx];
+			char	buf[65536];
+			while (true){
+				ssize_t	n = recv(c.fd, buf, sizeof(buf), 0);
+				if (n > 0){
+					c.in.append(buf, n);
+					continue;
+				}
+				if (n == 0 || (errno != EAGAIN && errno != EINTR)){
+					throw std::runtime_error(c.nick + " lost its connection");
+				}
+				if (errno == EAGAIN){
+					break;
+				}
+			}
+			size_t	start = 0;
+			size_t	end;
+			while ((end = c.in.find("\r\n", start)) != std::string::npos){
+				handleLine(c, c.in.data() + start, end - start);
+				start = end + 2;
+			}
+			c.in.erase(0, start);
+		}
+
+		void	handleLine(Conn& c, const char* line, size_t len){
+			static const std::string	privmsg = " PRIVMSG " CHANNEL " :";
+			std::string	text(line, len);
+			size_t		pos = text.find(privmsg);
+			if (pos != std::string::npos){
+				// "<sender> <send time> xxx..."
+				const char*	body = text.c_str() + pos + privmsg.size();
+				char*		next;
+				long		sender = std::strtol(body, &next, 10);
+				long		sent_at = std::strtol(next, nullptr, 10);
+				latencies_.push_back(nowNs() - sent_at);
+				delivered_++;
+				delivered_bytes_ += len + 2;
+				conns_[sender].delivered++;
+				trySend(sender);
+				return;
+			}
+			if (!c.joined && text.compare(0, c.nick.size() + 2, ":" + c.nick + "!") == 0
+				&& text.find(" JOIN ") != std::string::npos){
+				c.joined = true;
+				joined_++;
+			}
+		}
+
+		void	fillSenders(){
+			for (int i = 0; i < opt_.senders; i++){
+				trySend(i);
+			}
+		}
+
+		/**
+		 * @brief Send while the sender has less than --window messages that not
+		 * every member got yet.
+		 */
+		void	trySend(int idx){
+			Conn&	c = conns_[idx];
+			while (c.sent < opt_.messages && c.sent - c.delivered / receivers_ < opt_.window){
+				std::string	head = std::to_string(idx) + " " + std::to_string(nowNs()) + " ";
+				std::string	msg = "PRIVMSG " CHANNEL " :" + head;
+				msg.append(opt_.size - std::min(opt_.size, head.size()), 'x');
+				msg += "\r\n";
+				write(idx, msg);
+				c.sent++;
+			}
+		}
+
+		void	write(int idx, const std::string& data){
+			Conn&	c = conns_[idx];
+			bool	was_empty = c.out.empty();
+			c.out += data;
+			if (was_empty){
+				flush(idx);
+			}
+		}
+
+		void	flush(int idx){
+			Conn&	c = conns_[idx];
+			while (!c.out.empty()){
+				ssize_t	n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+				if (n < 0){
+					if (errno == EINTR) continue;
+					if (errno != EAGAIN){
+						throw std::runtime_error(c.nick + " send: " + strerror(errno));
+					}
+					break;
+				}
+				c.out.erase(0, n);
+			}
+			epoll_event	ev{};
+			ev.events = c.out.empty() ? EPOLLIN : (EPOLLIN | EPOLLOUT);
+			ev.data.u32 = idx;
+			epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+		}
+
+		double	percentileUs(double p){
+			if (latencies_.empty()){
+				return 0;
+			}
+			size_t	k = std::min(latencies_.size() - 1, static_cast<size_t>(p * latencies_.size()));
+			std::nth_element(latencies_.begin(), latencies_.begin() + k, latencies_.end());
+			return latencies_[k] / 1e3;
+		}
+
+		void	report(double elapsed, double cpu){
+			std::cout << std::fixed << std::setprecision(0)
+				<< opt_.label << ": " << delivered_ << "/" << total_ << " delivered in "
+				<< std::setprecision(2) << elapsed << " s, " << std::setprecision(0)
+				<< delivered_ / elapsed << " msg/s, latency p50 " << percentileUs(0.50)
+				<< " us p99 " << percentileUs(0.99) << " us";
+			if (opt_.pid > 0){
+				std::cout << std::setprecision(2) << ", server cpu " << cpu << " s ("
+					<< (delivered_ ? cpu * 1e6 / delivered_ : 0) << " us/msg, "
+					<< (delivered_bytes_ ? cpu * 1e9 / delivered_bytes_ : 0) << " s/GB)";
+			}
+			std::cout << std::endl;
+		}
+};
+
+int	main(int ac, char** av){
+	try {
+		Options	opt = parseOptions(ac, av);
+		Load	load(opt);
+		return load.run();
+	} catch (const std::exception& e){
+		std::cerr << "irc_load: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
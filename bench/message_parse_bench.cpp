@@ -0,0 +1,281 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   message_parse_bench.cpp                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/30 11:26:44 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/30 11:26:44 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * @brief Micro benchmark of Message::parseMessage(), against the parser it
+ * replaced(istringstream words, a stringstream per comma list, every token
+ * copied into std::vector<std::string>, a std::function map built per line),
+ * which is kept here as LegacyMessage.
+ *
+ * Both parse the same mix of client lines over and over for --seconds each.
+ * Before timing, the results of the two are compared line by line. The
+ * report gives lines/s and the heap allocations per line, counted by the
+ * operator new below.
+ *
+ * Build with `make bench`.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <functional>
+#include <unordered_map>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+#include "Server.hpp"
+#include "CommandArgs.hpp"
+
+static size_t	n_allocations = 0;
+
+void*	operator new(size_t size){
+	n_allocations++;
+	if (void* p = std::malloc(size ? size : 1)){
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void	operator delete(void* p) noexcept{
+	std::free(p);
+}
+
+void	operator delete(void* p, size_t) noexcept{
+	std::free(p);
+}
+
+/**
+ * @brief The parser before the string_view one, as it was(logging left out).
+ */
+class LegacyMessage{
+	public:
+		LegacyMessage(std::string& message) : whole_msg_(message), cmd_type_(INVALID),
+			msg_trailing_empty_(false){
+			command_handlers_ = {
+				{"PASS",   [this](){ cmd_type_ = PASS; return sortParameters(); }},
+				{"NICK",   [this](){ cmd_type_ = NICK; return sortParameters(); }},
+				{"TOPIC",  [this](){ cmd_type_ = TOPIC; return sortParameters(); }},
+				{"USER",   [this](){ cmd_type_ = USER; return sortParameters(); }},
+				{"PRIVMSG",[this](){ cmd_type_ = PRIVMSG; return sortParameters(); }},
+				{"PART",   [this](){ cmd_type_ = PART; return sortParameters(); }},
+				{"JOIN",   [this](){ cmd_type_ = JOIN; return sortParameters(); }},
+				{"QUIT",   [this](){ cmd_type_ = QUIT; return sortParameters(); }},
+				{"INVITE", [this](){ cmd_type_ = INVITE; return sortParameters(); }},
+				{"MODE",   [this](){ cmd_type_ = MODE; return sortParameters(); }},
+				{"CAP",   [this](){ cmd_type_ = CAP; return true; }},
+				{"PING",   [this](){ cmd_type_ = PING; return true; }},
+				{"PONG",   [this](){ cmd_type_ = PONG; return true; }},
+				{"WHOIS",   [this](){ cmd_type_ = WHOIS; return sortParameters(); }},
+				{"WHO",   [this](){ cmd_type_ = WHO; return true; }},
+				{"KICK",   [this](){ cmd_type_ = KICK; return sortParameters(); }}
+			};
+		}
+
+		bool	parseMessage(){
+			std::istringstream input_stream(whole_msg_);
+			std::string command;
+			std::string     word;
+
+			input_stream >> command;
+			cmd_string_ = command;
+			while (input_stream >> word){
+				if (!word.empty() && word[0] == ':'){
+					std::string rest_of_line;
+					std::getline(input_stream, rest_of_line);
+					while (rest_of_line.back() == '\n' || rest_of_line.back() == '\r'){
+						rest_of_line.pop_back();
+					}
+					if (!rest_of_line.empty()){
+						msg_trailing_ = word.substr(1) + rest_of_line;
+					} else{
+						msg_trailing_ = word.substr(1);
+						if (msg_trailing_.empty()){
+							msg_trailing_empty_ = true;
+						}
+					}
+					break;
+				}
+				std::stringstream string_stream(word);
+				std::string token;
+				while (std::getline(string_stream, token, ',')){
+					if (!token.empty()){
+						parameters_.push_back(token);
+					}
+				}
+			}
+			auto it = command_handlers_.find(command);
+			return it != command_handlers_.end() && it->second();
+		}
+
+		std::string								whole_msg_;
+		std::unordered_map<std::string, std::function<bool()>> command_handlers_;
+		std::string								cmd_string_;
+		std::string								msg_trailing_;
+		std::vector<std::string>				parameters_;
+		std::vector<std::string>				msg_channels_;
+		std::vector<std::string>				msg_others_; // users or passwords
+		COMMANDTYPE								cmd_type_;
+		bool									msg_trailing_empty_;
+
+	private:
+		// what handleGeneric()/handleJOIN()/handlePASS() did, users and passwords
+		// both end up in msg_others_
+		bool	sortParameters(){
+			for (const std::string& param : parameters_){
+				(param[0] == '#' ? msg_channels_ : msg_others_).push_back(param);
+			}
+			return true;
+		}
+};
+
+// what a busy server mostly sees
+static const std::vector<std::string>	corpus = {
+	"PRIVMSG #general :did anyone look at the build failure on the release branch?\r\n",
+	"PRIVMSG #general :yes, it's the flaky socket test again\r\n",
+	"PRIVMSG alice,bob :meeting moved to 3pm\r\n",
+	"PING irc.ircserv.com\r\n",
+	"PONG irc.ircserv.com\r\n",
+	"JOIN #general,#random,#dev key1,key2\r\n",
+	"PART #random :see you\r\n",
+	"MODE #dev +kl secret 25\r\n",
+	"KICK #dev mallory :spam\r\n",
+	"TOPIC #general :release on friday\r\n",
+	"NICK alice_\r\n",
+	"USER alice 0 * :Alice Example\r\n",
+	"WHO #general\r\n",
+	"QUIT :gone\r\n",
+};
+
+static void	usage(){
+	std::cerr << "Usage: message_parse_bench [--seconds S]\n";
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Empty items are skipped, trailing ones included("a," is one item),
+ * as the istringstream parser dropped them.
+ */
+static void	checkCommaLists(){
+	const std::pair<std::string_view, size_t>	cases[] = {
+		{"", 0}, {",", 0}, {"a,", 1}, {"a,,", 1}, {",a", 1}, {"a,,b", 2}, {"a,b", 2}
+	};
+	for (const auto& [word, n_items] : cases){
+		CommaList	list(word);
+		size_t		n_iterated = 0;
+		for (std::string_view item : list){
+			if (item.empty()){
+				throw std::runtime_error("CommaList(\"" + std::string(word) + "\") has an empty item");
+			}
+			n_iterated++;
+		}
+		if (list.size() != n_items || n_iterated != n_items){
+			throw std::runtime_error("CommaList(\"" + std::string(word) + "\") has "
+				+ std::to_string(n_iterated) + " items, not " + std::to_string(n_items));
+		}
+	}
+}
+
+/**
+ * @brief Both parsers must agree on every line of the corpus. The new one keeps
+ * the middle parameters whole and leaves the comma lists to the grammar of the
+ * command(CommandArgs.hpp), so they are split here to compare.
+ */
+static void	compareParsers(){
+	for (std::string line : corpus){
+		LegacyMessage	legacy(line);
+		Message			msg(line);
+		legacy.parseMessage();
+		msg.parseMessage();
+
+		std::vector<std::string>	parameters;
+		for (std::string_view word : msg.getParameters()){
+			for (std::string_view item : CommaList(word)){
+				parameters.emplace_back(item);
+			}
+		}
+		if (legacy.cmd_type_ != msg.getCommandType()
+			|| legacy.cmd_string_ != msg.getCommandString()
+			|| legacy.msg_trailing_ != msg.getTrailing()
+			|| legacy.msg_trailing_empty_ != msg.getTrailingEmpty()
+			|| legacy.parameters_ != parameters){
+			throw std::runtime_error("the parsers disagree on " + line);
+		}
+	}
+}
+
+/**
+ * @brief Parse the corpus round and round for the given time.
+ *
+ * @return lines/s and heap allocations per line
+ */
+template <typename Parser>
+static std::pair<double, double>	measure(double seconds){
+	using clock = std::chrono::steady_clock;
+	std::vector<std::string>	lines = corpus;
+	size_t		n_lines = 0;
+	size_t		n_parsed = 0;
+	size_t		allocations_before = n_allocations;
+	auto		start = clock::now();
+	auto		deadline = start + std::chrono::duration<double>(seconds);
+
+	while (clock::now() < deadline){
+		for (int round = 0; round < 100; round++){
+			for (std::string& line : lines){
+				Parser	msg(line);
+				n_parsed += msg.parseMessage();
+				n_lines++;
+			}
+		}
+	}
+	double	elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	if (n_parsed != n_lines){
+		throw std::runtime_error("a line of the corpus failed to parse");
+	}
+	return {n_lines / elapsed,
+		static_cast<double>(n_allocations - allocations_before) / n_lines};
+}
+
+int	main(int ac, char** av){
+	double	seconds = 2;
+	for (int i = 1; i < ac; i += 2){
+		if (std::string(av[i]) != "--seconds" || i + 1 >= ac){
+			usage();
+		}
+		seconds = std::atof(av[i + 1]);
+	}
+	if (seconds <= 0){
+		usage();
+	}
+	try {
+		checkCommaLists();
+		compareParsers();
+		auto	[legacy_rate, legacy_allocs] = measure<LegacyMessage>(seconds);
+		auto	[view_rate, view_allocs] = measure<Message>(seconds);
+		std::cout << std::left << std::setw(14) << "parser" << std::right
+			<< std::setw(14) << "lines/s" << std::setw(14) << "allocs/line" << std::endl
+			<< std::fixed << std::setprecision(0)
+			<< std::left << std::setw(14) << "istringstream" << std::right
+			<< std::setw(14) << legacy_rate << std::setprecision(1) << std::setw(14)
+			<< legacy_allocs << std::endl << std::setprecision(0)
+			<< std::left << std::setw(14) << "string_view" << std::right
+			<< std::setw(14) << view_rate << std::setprecision(1) << std::setw(14)
+			<< view_allocs << std::endl;
+		return EXIT_SUCCESS;
+	} catch (const std::exception& e){
+		std::cerr << "message_parse_bench: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,286 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   mode_parse_bench.cpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/06/01 17:05:31 by jingwu            #+#    #+#             */
+/*   Updated: 2025/06/01 17:05:31 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/**
+ * @brief Micro benchmark of the MODE string handling: ModeParser/ModeDelta
+ * against the code Server::mode() had before(a std::regex built on every user
+ * mode request, a switch per letter for channel modes writing one sign per
+ * letter and copying each argument), which is kept here.
+ *
+ * Only the parsing and the MODE line are measured: no channel is involved, so
+ * every change counts as effective. Both sides produce the same line for each
+ * case, checked before timing(the old one wrote "+t+l", the new "+tl", so the
+ * old output is compared with the signs squeezed). The report gives calls/s
+ * and heap allocations per call, for user and for channel modes.
+ *
+ * Build with `make bench`.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <regex>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+#include "Server.hpp"
+#include "ModeParser.hpp"
+
+static size_t	n_allocations = 0;
+
+void*	operator new(size_t size){
+	n_allocations++;
+	if (void* p = std::malloc(size ? size : 1)){
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void	operator delete(void* p) noexcept{
+	std::free(p);
+}
+
+void	operator delete(void* p, size_t) noexcept{
+	std::free(p);
+}
+
+struct ModeCase{
+	std::string					modes;
+	std::vector<std::string>	args;
+};
+
+static const std::vector<ModeCase>	user_cases = {
+	{"+i", {}}, {"-w+i", {}}, {"+iwO", {}}, {"+x", {}},
+};
+
+static const std::vector<ModeCase>	channel_cases = {
+	{"+itkl", {"secret", "25"}}, {"+o", {"bob"}}, {"-t+k-l", {"key"}},
+	{"+i", {}}, {"-o+o", {"alice", "bob"}}, {"+tz", {}},
+};
+
+/**
+ * @brief The user mode check as it was: is the request well formed.
+ */
+static bool	legacyUserMode(const std::string& mode){
+	std::regex mode_regex("^([+-][iworO]*)+$");
+	return std::regex_match(mode, mode_regex);
+}
+
+static bool	newUserMode(std::string_view mode){
+	ModeChange	change;
+	MODESTATUS	status;
+	ModeParser	check(USER_MODES, mode, WordRange());
+
+	while ((status = check.next(change)) == MODE_CHANGE){
+	}
+	return (mode[0] == '+' || mode[0] == '-') && status == MODE_END;
+}
+
+/**
+ * @brief The channel mode loop as it was, without the channel: the MODE line
+ * it sent, "" when a missing argument made it return.
+ */
+static std::string	legacyChannelMode(const std::string& mode_flags, const WordRange& mode_args){
+	bool adding = true;
+	size_t arg_index = 0;
+	std::string update_modes;
+
+	for (size_t i = 0; i < mode_flags.size(); ++i){
+		char c = mode_flags[i];
+
+		if (c == '+'){
+			adding = true;
+		}
+		else if (c == '-'){
+			adding = false;
+		}
+		else if (c == 'i'){
+			update_modes += (adding ? "+i" : "-i");
+		}
+		else if (c == 't'){
+			update_modes += (adding ? "+t" : "-t");
+		}
+		else if (c == 'k'){
+			if (adding){
+				if (arg_index >= mode_args.size()){
+					return "";
+				}
+				std::string key(mode_args[arg_index++]);
+				update_modes += "+k";
+			} else{
+				update_modes += "-k";
+			}
+		}
+		else if (c == 'l'){
+			if (adding){
+				if (arg_index >= mode_args.size()){
+					return "";
+				}
+				std::stoi(std::string(mode_args[arg_index++]));
+				update_modes += "+l";
+			} else {
+				update_modes += "-l";
+			}
+		}
+		else if (c == 'o'){
+			if (arg_index >= mode_args.size()){
+				return "";
+			}
+			std::string nick(mode_args[arg_index++]);
+			update_modes += (adding ? "+o" : "-o");
+		}
+	}
+	if (arg_index > mode_args.size())
+		arg_index = mode_args.size();
+	std::string	params_str;
+	for (size_t i = 0; i < arg_index; i++){
+		params_str.append(" ").append(mode_args[i]);
+	}
+	return update_modes + params_str;
+}
+
+static std::string	newChannelMode(std::string_view modes, const WordRange& args){
+	ModeParser	parser(CHANNEL_MODES, modes, args);
+	ModeChange	change;
+	ModeDelta	applied;
+	MODESTATUS	status;
+
+	while ((status = parser.next(change)) != MODE_END){
+		if (status == MODE_MISSING_ARG){
+			return "";
+		}
+		if (status == MODE_CHANGE){
+			applied.add(change);
+		}
+	}
+	if (applied.getParams().empty()){
+		return applied.getModes();
+	}
+	return applied.getModes() + " " + applied.getParams();
+}
+
+// "+t+l-k x" -> "+tl-k x"
+static std::string	squeezeSigns(const std::string& line){
+	std::string	out;
+	char		sign = 0;
+
+	for (size_t i = 0; i < line.size(); i++){
+		char	c = line[i];
+		if (c == ' '){
+			return out + line.substr(i);
+		}
+		if (c == '+' || c == '-'){
+			if (c != sign){
+				out += c;
+			}
+			sign = c;
+			continue;
+		}
+		out += c;
+	}
+	return out;
+}
+
+static void	usage(){
+	std::cerr << "Usage: mode_parse_bench [--seconds S]\n";
+	exit(EXIT_FAILURE);
+}
+
+struct Rates{
+	double	calls_per_s;
+	double	allocs_per_call;
+};
+
+template <typename Fn>
+static Rates	measure(const std::vector<ModeCase>& cases, double seconds, Fn fn){
+	using clock = std::chrono::steady_clock;
+	std::vector<std::vector<std::string_view>>	views;
+	for (const ModeCase& c : cases){
+		views.emplace_back(c.args.begin(), c.args.end());
+	}
+	size_t	n_calls = 0;
+	size_t	n_valid = 0;
+	size_t	allocations_before = n_allocations;
+	auto	start = clock::now();
+	auto	deadline = start + std::chrono::duration<double>(seconds);
+
+	while (clock::now() < deadline){
+		for (int round = 0; round < 100; round++){
+			for (size_t i = 0; i < cases.size(); i++){
+				WordRange	args(views[i].data(), views[i].data() + views[i].size());
+				n_valid += fn(cases[i].modes, args);
+				n_calls++;
+			}
+		}
+	}
+	double	elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	if (n_valid == 0){
+		throw std::runtime_error("nothing was valid");
+	}
+	return {n_calls / elapsed, static_cast<double>(n_allocations - allocations_before) / n_calls};
+}
+
+static void	compareImplementations(){
+	for (const ModeCase& c : user_cases){
+		if (legacyUserMode(c.modes) != newUserMode(c.modes)){
+			throw std::runtime_error("the user mode checks disagree on " + c.modes);
+		}
+	}
+	for (const ModeCase& c : channel_cases){
+		std::vector<std::string_view>	views(c.args.begin(), c.args.end());
+		WordRange	args(views.data(), views.data() + views.size());
+		if (squeezeSigns(legacyChannelMode(c.modes, args)) != newChannelMode(c.modes, args)){
+			throw std::runtime_error("the channel mode lines differ for " + c.modes);
+		}
+	}
+}
+
+static void	report(const std::string& name, const Rates& rates){
+	std::cout << std::left << std::setw(22) << name << std::right << std::fixed
+		<< std::setprecision(0) << std::setw(14) << rates.calls_per_s
+		<< std::setprecision(1) << std::setw(14) << rates.allocs_per_call << std::endl;
+}
+
+int	main(int ac, char** av){
+	double	seconds = 1;
+	for (int i = 1; i < ac; i += 2){
+		if (std::string(av[i]) != "--seconds" || i + 1 >= ac){
+			usage();
+		}
+		seconds = std::atof(av[i + 1]);
+	}
+	if (seconds <= 0){
+		usage();
+	}
+	try {
+		compareImplementations();
+		std::cout << std::left << std::setw(22) << "implementation" << std::right
+			<< std::setw(14) << "calls/s" << std::setw(14) << "allocs/call" << std::endl;
+		report("user, std::regex", measure(user_cases, seconds,
+			[](const std::string& modes, const WordRange&){ return legacyUserMode(modes); }));
+		report("user, ModeParser", measure(user_cases, seconds,
+			[](const std::string& modes, const WordRange&){ return newUserMode(modes); }));
+		report("channel, old loop", measure(channel_cases, seconds,
+			[](const std::string& modes, const WordRange& args){
+				return !legacyChannelMode(modes, args).empty(); }));
+		report("channel, ModeParser", measure(channel_cases, seconds,
+			[](const std::string& modes, const WordRange& args){
+				return !newChannelMode(modes, args).empty(); }));
+		return EXIT_SUCCESS;
+	} catch (const std::exception& e){
+		std::cerr << "mode_parse_bench: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -41,6 +41,7 @@ class Channel{
         bool        getTopicMode() const;
         bool        getPasswdMode() const;
         bool        getLimitMode() const;
+        size_t      getUserLimit() const;
         size_t      channelSize();
         const std::unordered_set<Client*>&  getChannelUsers() const;
 
@@ -0,0 +1,155 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CharClass.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/06/02 10:21:47 by jingwu            #+#    #+#             */
+/*   Updated: 2025/06/02 10:21:47 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+#define SPECIAL_CHARS_NAMES "[]\\`_^{|}"
+#define SPECIAL_CHARS_PASSWD "!@#$%^&*()-_=+[]{}|;:'\",.<>?/\\~`"
+
+// character classes, a byte can be in several
+#define CHAR_LETTER (1u << 0) // A-Z a-z
+#define CHAR_DIGIT (1u << 1)
+#define CHAR_UPPER (1u << 2) // A-Z
+#define CHAR_NAME_SPECIAL (1u << 3) // SPECIAL_CHARS_NAMES
+#define CHAR_PASSWD_SPECIAL (1u << 4) // SPECIAL_CHARS_PASSWD
+#define CHAR_SPACE (1u << 5) // ' ' only
+#define CHAR_KEY (1u << 6) // may be in a channel key(RFC 2812 "key")
+#define CHAR_CHANNEL (1u << 7) // may be in a channel name: not NUL, BEL, CR, LF, ' ', ',' or ':'
+
+using CharClassTable = std::array<uint8_t, 256>;
+
+constexpr CharClassTable	makeCharClasses(){
+	CharClassTable	table{};
+
+	for (int c = 0; c < 256; c++){
+		uint8_t	classes = 0;
+		if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')){
+			classes |= CHAR_LETTER;
+		}
+		if (c >= 'A' && c <= 'Z'){
+			classes |= CHAR_UPPER;
+		}
+		if (c >= '0' && c <= '9'){
+			classes |= CHAR_DIGIT;
+		}
+		if (std::string_view(SPECIAL_CHARS_NAMES).find(static_cast<char>(c)) != std::string_view::npos){
+			classes |= CHAR_NAME_SPECIAL;
+		}
+		if (std::string_view(SPECIAL_CHARS_PASSWD).find(static_cast<char>(c)) != std::string_view::npos){
+			classes |= CHAR_PASSWD_SPECIAL;
+		}
+		if (c == ' '){
+			classes |= CHAR_SPACE;
+		}
+		if ((c >= 0x01 && c <= 0x05) || (c >= 0x07 && c <= 0x08) || c == 0x0C
+			|| (c >= 0x0E && c <= 0x1F) || (c >= 0x21 && c <= 0x7F)){
+			classes |= CHAR_KEY;
+		}
+		if (c != 0 && c != 7 && c != '\r' && c != '\n' && c != ' ' && c != ',' && c != ':'){
+			classes |= CHAR_CHANNEL;
+		}
+		table[c] = classes;
+	}
+	return table;
+}
+
+inline constexpr CharClassTable	CHAR_CLASSES = makeCharClasses();
+
+/**
+ * @brief The bytes in any of some classes, as a 256-entry table for single
+ * bytes, and as two 16-entry nibble tables for the vectorized scan: an ASCII
+ * byte is in the set when lo[its low nibble] has the bit of its high nibble,
+ * and bytes from 0x80 up are either all in it or all out(`high`).
+ */
+struct CharSet{
+	std::array<bool, 256>	member;
+	alignas(16) uint8_t		lo[16];
+	alignas(16) uint8_t		hi[16];
+	bool					high;
+
+	constexpr bool	contains(char c) const{
+		return member[static_cast<unsigned char>(c)];
+	}
+};
+
+/**
+ * @brief Built by the compiler. Throws(so doesn't compile) if the bytes from
+ * 0x80 up don't agree, the nibble tables couldn't tell them apart.
+ */
+constexpr CharSet	makeCharSet(unsigned classes){
+	CharSet	set{};
+
+	for (int c = 0; c < 256; c++){
+		set.member[c] = (CHAR_CLASSES[c] & classes) != 0;
+		if (c < 0x80 && set.member[c]){
+			set.lo[c & 0x0F] |= static_cast<uint8_t>(1u << (c >> 4));
+		}
+	}
+	for (int h = 0; h < 8; h++){
+		set.hi[h] = static_cast<uint8_t>(1u << h);
+	}
+	set.high = set.member[0x80];
+	for (int c = 0x80; c < 256; c++){
+		if (set.member[c] != set.high){
+			throw "a CharSet takes all the bytes from 0x80 up or none";
+		}
+	}
+	return set;
+}
+
+inline constexpr CharSet	NICK_FIRST_CHARS = makeCharSet(CHAR_LETTER | CHAR_NAME_SPECIAL);
+inline constexpr CharSet	NICK_CHARS = makeCharSet(CHAR_LETTER | CHAR_DIGIT | CHAR_NAME_SPECIAL);
+inline constexpr CharSet	REALNAME_CHARS = makeCharSet(CHAR_LETTER | CHAR_DIGIT | CHAR_NAME_SPECIAL
+	| CHAR_SPACE);
+inline constexpr CharSet	PASSWORD_CHARS = makeCharSet(CHAR_LETTER | CHAR_DIGIT | CHAR_PASSWD_SPECIAL);
+inline constexpr CharSet	KEY_CHARS = makeCharSet(CHAR_KEY);
+inline constexpr CharSet	CHANNEL_CHARS = makeCharSet(CHAR_CHANNEL);
+inline constexpr CharSet	CHANNEL_ID_CHARS = makeCharSet(CHAR_UPPER | CHAR_DIGIT);
+inline constexpr CharSet	DIGIT_CHARS = makeCharSet(CHAR_DIGIT);
+
+/**
+ * @brief Position of the first byte of s not in set, std::string_view::npos if
+ * they all are. 16 bytes at a time with SSSE3 when the CPU has it.
+ */
+size_t	findFirstNotIn(std::string_view s, const CharSet& set);
+
+inline bool	allIn(std::string_view s, const CharSet& set){
+	return findFirstNotIn(s, set) == std::string_view::npos;
+}
+
+// RFC 1459 casemapping: a-z and "{}|~" are the lower case of A-Z and "[]\\^",
+// so "Nick[a]" and "nick{A}" are the same nickname
+constexpr std::array<char, 256>	makeCaseMap(){
+	std::array<char, 256>	lower{};
+
+	for (int c = 0; c < 256; c++){
+		lower[c] = static_cast<char>(c);
+		if ((c >= 'A' && c <= 'Z') || c == '[' || c == ']' || c == '\\'){
+			lower[c] = static_cast<char>(c + 0x20);
+		} else if (c == '^'){
+			lower[c] = '~';
+		}
+	}
+	return lower;
+}
+
+inline constexpr std::array<char, 256>	RFC1459_LOWER = makeCaseMap();
+
+// the key two nicknames share if they are the same one(a nick fits the SSO
+// buffer, this allocates nothing)
+std::string	casemapNick(std::string_view nick);
@@ -13,13 +13,61 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <sys/socket.h> // for recv()
+#include <sys/uio.h> // for struct iovec
 #include <cstring> // for std::memset
+#include <vector>
+#include <memory> // for std::enable_shared_from_this
+#include <atomic>
+#include <cstdint>
+#include "TimerWheel.hpp"
+#include "RecvBuffer.hpp"
+#include "PoolQueue.hpp"
+
+class TlsContext;
+class TlsSession;
 
 #define BUFFER_SIZE (5000)
+#define CLIENT_SENDQ_LIMIT (512 * 1024) // max bytes waiting in one client's send queue
+#define CLIENT_SEND_IOV (1024) // max queued replies written by one sendmsg(IOV_MAX)
+
+// A reply as it sits in the send queues: immutable and reference counted. A
+// channel broadcast is built once and every member's queue points to the same
+// bytes; they are freed when the last member has written them.
+using SharedMessage = std::shared_ptr<const std::string>;
+// what one client may use of a loop turn: bytes read from its socket and
+// commands executed, counted in CommandDescriptor::cost(a plain line is 1). The
+// rest waits on the loop's ready list for the next turn
+#define CLIENT_READ_BUDGET (4 * BUFFER_SIZE)
+#define CLIENT_COMMAND_BUDGET (64)
+
+/**
+ * @brief Result of Client::receiveRawData().
+ *  DRAINED: the socket has nothing more to read right now;
+ *  BUDGET: the read budget ran out, there may be more;
+ *  CLOSED: end of stream or a read error.
+ */
+enum class RECV_STATUS {
+	DRAINED,
+	BUDGET,
+	CLOSED
+};
+
+/**
+ * @brief A MSG_ZEROCOPY send the kernel hasn't completed yet: it still reads
+ * the bytes of these messages, they can't be freed before the completion with
+ * this id comes back on the socket's error queue.
+ */
+struct ZerocopySend{
+	uint32_t					id;
+	std::vector<SharedMessage>	messages;
+};
 
-class Client{
+// enable_shared_from_this: a reply for a client owned by another worker is
+// handed over together with a shared_ptr, so the Client outlives the handoff
+class Client : public std::enable_shared_from_this<Client>{
 	public:
 		Client();
 		Client(int fd, std::string host);
@@ -33,10 +81,13 @@ class Client{
 		const std::string&	getRealname() const;
 		const std::string&	getHostname() const;
 		const std::string&	getPassword() const;
-		bool				getNextMessage(std::string& buffer);
+		const std::string&	getServername() const;
+		bool				getNextMessage(std::string_view& line);
+		bool				hasCompleteMessage() const;
 		std::string			getPrefix() const;
 		const std::string&	getUserMode() const;
 		int					getUserNChannel() const;
+		int					getWorkerId() const;
 
 		// setters
 		void	setNick(const std::string& nick);
@@ -48,10 +99,66 @@ class Client{
 		void	setRegistrationStatus(bool	status);
 		void	setUserMode(const std::string& mode);
 		void	increaseUserNchannel();
+		void	setUserNChannel(int n);
+		void	setWorkerId(int id);
 
-		bool	receiveRawData();
+		// liveness, in ticks of the owner worker's timer wheel
+		TimerNode&	getTimer();
+		uint64_t	getLastActive() const;
+		void		touch(uint64_t now);
+		bool		isAwaitingPong() const;
+		void		setAwaitingPong(bool awaiting);
+
+		// TLS connection(--tls-listen): the loop drives the handshake, then
+		// reads and writes through the session unless the kernel does it(kTLS)
+		void		startTls(TlsContext& ctx);
+		TlsSession*	getTls() const;
+		// write interest: replies queued, or the TLS handshake waits for room
+		bool		wantsWrite() const;
+
+		RECV_STATUS	receiveRawData(size_t budget);
+		void	appendRawData(const char* data, size_t len);
+		std::string	getRawData() const;
 		bool	isRegistered();
 
+		// outbound queue
+		bool	queueResponse(const SharedMessage& response, uint64_t since = 0);
+		bool	hasPendingOutput() const;
+		uint64_t	getQueuedSince() const;
+		size_t	getSendQueueBytes() const;
+		std::string	getPendingOutput() const;
+		bool	isWriteArmed() const;
+		void	setWriteArmed(bool armed);
+		void	markDisconnected();
+		bool	isDisconnected() const;
+		void	markInputClosed();
+		bool	isInputClosed() const;
+		bool	isReadyListed() const;
+		void	setReadyListed(bool listed);
+		int		getCommandCredit() const;
+		void	setCommandCredit(int credit);
+
+		// the loop writes straight from the queue with one vectored send
+		struct msghdr*	prepareSendMsg();
+		size_t	consumeSent(size_t n_bytes);
+		// io_uring backend: the requests that still reference this client
+		bool	isSendInflight() const;
+		void	setSendInflight(bool inflight);
+		bool	isRecvArmed() const;
+		void	setRecvArmed(bool armed);
+		int		getIoPending() const;
+		void	increaseIoPending();
+		void	decreaseIoPending();
+		// MSG_ZEROCOPY(readiness backends): keep the written messages alive until
+		// the kernel is done with them
+		bool	isZerocopy() const;
+		void	setZerocopy(bool enabled);
+		void	holdForZerocopy(size_t n_bytes);
+		size_t	releaseZerocopy(uint32_t first_id, uint32_t last_id);
+		bool	hasZerocopyPending() const;
+		// pool and heap memory held by the receive and send buffers
+		size_t	getBufferBytes() const;
+
 		// for testing
 		// void	printInfo() const;
 		// void    printRawData() const;
@@ -64,10 +171,39 @@ class Client{
 		std::string	hostname_;
 		std::string	servername_;
 		std::string password_;
-		std::string	raw_data_;
+		RecvBuffer	raw_data_; // received, not executed yet
 		std::string	user_mode_;
 		bool		isRegistered_;
 		int			n_usr_channel_;
 
+		PoolQueue<SharedMessage>	send_queue_; // replies waiting for the socket to become writable
+		size_t		send_offset_; // bytes of send_queue_.front() already written
+		size_t		send_queue_bytes_; // unsent bytes in the whole queue
+		// read time of the lines behind the queued replies, as runs of
+		// (replies, time) in queue order
+		PoolQueue<std::pair<size_t, uint64_t>>	send_stamps_;
+		bool		write_armed_; // the loop watches this socket for writability
+		std::atomic<bool>	isDisconnected_; // removed from the server, drop any further output
+		// end of stream(or a read error): the lines received before it still run,
+		// then the client is removed
+		bool		input_closed_;
+		int			worker_id_; // the worker thread that owns the socket
+		bool		ready_listed_; // on the loop's ready list, input left for the next turn
+		// command budget left this turn, below 0 when the last command cost more
+		// than was left: the next turns pay it back first
+		int			command_credit_;
+		bool		send_inflight_; // io_uring: a sendmsg of the queue front is in flight
+		bool		recv_armed_; // io_uring: the multishot recv is in flight
+		struct msghdr	send_msg_; // io_uring: the in-flight sendmsg
+		PoolBuffer		send_iov_; // iovecs of send_msg_, given back when the queue drains
+		int			io_pending_; // io_uring: requests(recv/send) not completed yet
+		bool		zerocopy_; // SO_ZEROCOPY is set and the kernel didn't fall back to copying
+		uint32_t	zerocopy_next_id_; // id the kernel gives the next MSG_ZEROCOPY send
+		std::vector<ZerocopySend>	zerocopy_pending_; // oldest first
+		TimerNode	timer_; // registration deadline, next idle check or PONG deadline
+		uint64_t	last_active_; // tick of the last line received
+		bool		awaiting_pong_; // we sent a PING, nothing came back yet
+		std::unique_ptr<TlsSession>	tls_; // nullptr for a plain connection
+
 		Client(const Client&) = delete;
 };
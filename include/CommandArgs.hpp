@@ -0,0 +1,302 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CommandArgs.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/31 10:17:05 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/31 10:17:05 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string_view>
+#include <optional>
+#include <cstddef>
+#include "Message.hpp"
+
+/**
+ * @brief A comma separated parameter("#a,#b,#c") seen as the list of its
+ * non-empty items, without copying or splitting anything up front: the items
+ * are found while iterating.
+ */
+class CommaList{
+	public:
+		class iterator{
+			public:
+				explicit iterator(std::string_view rest);
+
+				std::string_view	operator*() const;
+				iterator&			operator++();
+				bool				operator!=(const iterator& other) const;
+
+			private:
+				std::string_view	item_;
+				std::string_view	rest_; // what follows item_
+
+				void				skip();
+		};
+
+		CommaList();
+		explicit CommaList(std::string_view word);
+
+		iterator			begin() const;
+		iterator			end() const;
+		size_t				size() const;
+		bool				empty() const;
+		// the i-th item, std::out_of_range past the end
+		std::string_view	at(size_t i) const;
+		std::string_view	word() const; // as it was sent
+
+	private:
+		std::string_view	word_;
+		size_t				size_;
+};
+
+/**
+ * @brief The middle parameters of a message from some position on, as they
+ * came(the arguments of MODE).
+ */
+class WordRange{
+	public:
+		WordRange();
+		WordRange(const std::string_view* first, const std::string_view* last);
+
+		const std::string_view*	begin() const;
+		const std::string_view*	end() const;
+		size_t				size() const;
+		bool				empty() const;
+		std::string_view	operator[](size_t i) const;
+
+	private:
+		const std::string_view*	first_;
+		const std::string_view*	last_;
+};
+
+/*
+ * The grammar of a command is the list of its parameters, each bound to a
+ * member of its argument struct:
+ *   Param<&Args::member>        the next middle parameter. A std::string_view
+ *                               member takes the word as it is, a CommaList
+ *                               member its comma separated items
+ *   Rest<&Args::member>         every middle parameter left(a WordRange)
+ *   Trailing<&Args::member>     the part after ':'. A std::optional member
+ *                               tells "none" from ":" alone
+ * An ARG_REQUIRED parameter that is missing or empty(a list with no item)
+ * fails the parse, the command is then answered with ERR_NEEDMOREPARAMS.
+ * Parameters beyond the grammar are ignored.
+ */
+enum ARGNEED{
+	ARG_OPTIONAL,
+	ARG_REQUIRED
+};
+
+template <auto Member, ARGNEED Need = ARG_REQUIRED>
+struct Param{};
+
+template <auto Member>
+struct Rest{};
+
+template <auto Member, ARGNEED Need = ARG_OPTIONAL>
+struct Trailing{};
+
+namespace grammar{
+
+	inline void	assign(std::string_view& member, std::string_view word){
+		member = word;
+	}
+
+	inline void	assign(CommaList& member, std::string_view word){
+		member = CommaList(word);
+	}
+
+	inline void	assign(std::optional<std::string_view>& member, std::string_view word){
+		member = word;
+	}
+
+	inline bool	given(std::string_view member){
+		return !member.empty();
+	}
+
+	inline bool	given(const CommaList& member){
+		return !member.empty();
+	}
+
+	inline bool	given(const std::optional<std::string_view>& member){
+		return member && !member->empty();
+	}
+
+	template <auto Member, ARGNEED Need, typename Args>
+	bool	bind(Param<Member, Need>, const Message& msg, Args& args, size_t& word){
+		const ViewList&	words = msg.getParameters();
+
+		if (word < words.size()){
+			assign(args.*Member, words[word++]);
+		}
+		return Need == ARG_OPTIONAL || given(args.*Member);
+	}
+
+	template <auto Member, typename Args>
+	bool	bind(Rest<Member>, const Message& msg, Args& args, size_t& word){
+		const ViewList&	words = msg.getParameters();
+
+		if (word < words.size()){
+			args.*Member = WordRange(words.begin() + word, words.end());
+			word = words.size();
+		}
+		return true;
+	}
+
+	template <auto Member, ARGNEED Need, typename Args>
+	bool	bind(Trailing<Member, Need>, const Message& msg, Args& args, size_t&){
+		if (msg.hasTrailing()){
+			assign(args.*Member, msg.getTrailing());
+		}
+		return Need == ARG_OPTIONAL || given(args.*Member);
+	}
+}
+
+/**
+ * @brief Fills an argument struct from a message, parameter by parameter, as
+ * its grammar says. All the work is laid out by the compiler for each command,
+ * nothing is looked up or allocated while parsing.
+ */
+template <typename... Params>
+struct Grammar{
+	template <typename Args>
+	static bool	parse(const Message& msg, Args& args){
+		[[maybe_unused]] size_t	word = 0; // next middle parameter, none for Grammar<>
+		return (grammar::bind(Params{}, msg, args, word) && ...);
+	}
+};
+
+/*.................................Command arguments.............................*/
+
+// PASS <password>
+struct PassArgs{
+	std::string_view	password;
+
+	using Grammar = ::Grammar<Param<&PassArgs::password>>;
+};
+
+// NICK <nickname>, a missing one is ERR_NONICKNAMEGIVEN
+struct NickArgs{
+	std::string_view	nick;
+
+	using Grammar = ::Grammar<Param<&NickArgs::nick, ARG_OPTIONAL>>;
+};
+
+// USER <user> <mode> <servername> :<realname>
+struct UserArgs{
+	std::string_view	username;
+	std::string_view	mode;
+	std::string_view	servername;
+	std::string_view	realname;
+
+	using Grammar = ::Grammar<Param<&UserArgs::username>, Param<&UserArgs::mode>,
+		Param<&UserArgs::servername>, Trailing<&UserArgs::realname, ARG_REQUIRED>>;
+};
+
+// PRIVMSG <target>{,<target>} :<text>, a target is a channel or a nick
+struct PrivmsgArgs{
+	CommaList							targets;
+	std::optional<std::string_view>		text;
+
+	using Grammar = ::Grammar<Param<&PrivmsgArgs::targets>, Trailing<&PrivmsgArgs::text>>;
+};
+
+// JOIN <channel>{,<channel>} [<key>{,<key>}]
+struct JoinArgs{
+	CommaList	channels;
+	CommaList	keys;
+
+	using Grammar = ::Grammar<Param<&JoinArgs::channels>, Param<&JoinArgs::keys, ARG_OPTIONAL>>;
+};
+
+// PART <channel>{,<channel>} [:<message>]
+struct PartArgs{
+	CommaList			channels;
+	std::string_view	message;
+
+	using Grammar = ::Grammar<Param<&PartArgs::channels>, Trailing<&PartArgs::message>>;
+};
+
+// KICK <channel>{,<channel>} <nick>{,<nick>} [:<reason>]
+struct KickArgs{
+	CommaList			channels;
+	CommaList			nicks;
+	std::string_view	reason;
+
+	using Grammar = ::Grammar<Param<&KickArgs::channels>, Param<&KickArgs::nicks>,
+		Trailing<&KickArgs::reason>>;
+};
+
+// INVITE <nick>{,<nick>} <channel>{,<channel>}
+struct InviteArgs{
+	CommaList	nicks;
+	CommaList	channels;
+
+	using Grammar = ::Grammar<Param<&InviteArgs::nicks>, Param<&InviteArgs::channels>>;
+};
+
+// TOPIC <channel> [:<topic>], no topic shows it, ":" alone clears it
+struct TopicArgs{
+	std::string_view					channel;
+	std::optional<std::string_view>		topic;
+
+	using Grammar = ::Grammar<Param<&TopicArgs::channel>, Trailing<&TopicArgs::topic>>;
+};
+
+// MODE <channel|nick> [<modes> [<mode argument>...]]
+struct ModeArgs{
+	std::string_view	target;
+	std::string_view	modes;
+	WordRange			args;
+
+	using Grammar = ::Grammar<Param<&ModeArgs::target>, Param<&ModeArgs::modes, ARG_OPTIONAL>,
+		Rest<&ModeArgs::args>>;
+};
+
+// QUIT [<reason>]
+struct QuitArgs{
+	std::string_view	reason;
+
+	using Grammar = ::Grammar<Param<&QuitArgs::reason, ARG_OPTIONAL>>;
+};
+
+// CAP <subcommand> [:<capabilities>]
+struct CapArgs{
+	std::string_view	subcommand;
+	std::string_view	capabilities;
+
+	using Grammar = ::Grammar<Param<&CapArgs::subcommand, ARG_OPTIONAL>,
+		Trailing<&CapArgs::capabilities>>;
+};
+
+// PING <origin>, a missing one is ERR_NOORIGIN
+struct PingArgs{
+	std::string_view	origin;
+
+	using Grammar = ::Grammar<Param<&PingArgs::origin, ARG_OPTIONAL>>;
+};
+
+// PONG, whatever it carries
+struct PongArgs{
+	using Grammar = ::Grammar<>;
+};
+
+// WHOIS <nick>, a missing one is ERR_NONICKNAMEGIVEN
+struct WhoisArgs{
+	std::string_view	nick;
+
+	using Grammar = ::Grammar<Param<&WhoisArgs::nick, ARG_OPTIONAL>>;
+};
+
+// WHO <channel>
+struct WhoArgs{
+	std::string_view	channel;
+
+	using Grammar = ::Grammar<Param<&WhoArgs::channel>>;
+};
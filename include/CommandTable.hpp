@@ -0,0 +1,68 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CommandTable.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/30 14:02:51 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/30 14:02:51 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include "Server.hpp"
+
+class Client;
+class Message;
+
+#define COMMAND_TABLE_SLOTS (64) // perfect hash slots, see CommandTable::slot()
+
+// what a client must have done before it can run the command
+#define COMMAND_BEFORE_PASS (1u << 0) // allowed before the right password
+#define COMMAND_BEFORE_REGISTRATION (1u << 1) // allowed before NICK/USER are done
+// the cost is per item of the first parameter(a comma list of targets)
+#define COMMAND_COST_PER_TARGET (1u << 2)
+
+/**
+ * @brief Everything the server needs to know about one command: what the
+ * client must have done first, the Server method that runs it, which parses
+ * the arguments with the command's grammar(Server::runCommand()), and what a
+ * run takes of the client's CLIENT_COMMAND_BUDGET.
+ */
+struct CommandDescriptor{
+	std::string_view	name;
+	COMMANDTYPE			type;
+	void				(Server::*execute)(Message& msg, Client& cli);
+	unsigned			flags; // COMMAND_*
+	unsigned			cost = 1; // a line with one target and one reply is 1
+};
+
+/**
+ * @brief The commands we know, looked up by their token with a perfect hash
+ * computed at compile time: a command goes to the slot of its length and three
+ * of its letters, no two commands share one(the build fails if they would). A
+ * lookup is a hash, one slot and one compare, and allocates nothing.
+ *
+ * Friend of Server, to take its private methods.
+ */
+class CommandTable{
+	public:
+		// the command named token(case-sensitive, as sent), nullptr if unknown
+		static const CommandDescriptor*	find(std::string_view token);
+		// what running msg takes of its client's command budget, 1 for an
+		// unknown command
+		static unsigned	cost(const Message& msg);
+
+	private:
+		static const CommandDescriptor					commands_[INVALID];
+		// index in commands_ + 1 of the command in each slot, 0 for none
+		static const std::array<uint8_t, COMMAND_TABLE_SLOTS>	slots_;
+
+		static constexpr size_t	slot(std::string_view token);
+		static constexpr std::array<uint8_t, COMMAND_TABLE_SLOTS>	buildSlots();
+};
@@ -0,0 +1,106 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Config.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/22 10:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/22 10:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#define MAX_WORKERS (64)
+#define LISTEN_BACKLOG (4096) // default, the kernel caps it at net.core.somaxconn
+#define MAX_BACKLOG (65535)
+#define MAX_TIMEOUT (86400) // seconds, for the liveness options
+#define MAX_ZEROCOPY_MIN (16 * 1024 * 1024) // bigger than any send queue
+#define MAX_BUSY_POLL (1000000) // microseconds
+#define MAX_NOTSENT_LOWAT (16 * 1024 * 1024)
+#define MAX_LISTENERS (16) // --listen, --tls-listen and --unix-listen entries
+#define UPGRADE_FD_OPTION "--upgrade-fd" // internal, given by a hot restart(SIGUSR2)
+
+/**
+ * @brief How a worker waits for socket events, see EventLoop.
+ *  POLL: poll(2) over every socket, the portable reference.
+ *  EPOLL: level triggered epoll.
+ *  EPOLL_ET: edge triggered epoll, every socket is registered once. The
+ *            default and the fallback.
+ *  URING: completion based loop on io_uring(multishot accept, provided-buffer
+ *         recv, vectored sends).
+ */
+enum class BACKEND {
+	POLL,
+	EPOLL,
+	EPOLL_ET,
+	URING
+};
+
+/**
+ * @brief One address the server listens on(--listen). Every worker gets its own
+ * socket for each of them, except a Unix socket: its file can be bound only
+ * once, worker 0 serves it.
+ */
+struct ListenAddress{
+	std::string	host; // numeric IPv4 or IPv6 address, "*" for every address of both families
+	int			port; // 0: the <port> argument, TLS_DEFAULT_PORT for TLS
+	bool		tls; // --tls-listen: the connections speak TLS
+	std::string	path; // --unix-listen: the socket file(host and port unused), empty for TCP
+
+	bool		isUnix() const;
+
+	std::string	toString() const;
+};
+
+/**
+ * @brief Optional runtime settings of the server. They are given on the command
+ * line after <port> and <password>, every setting has a default that keeps the
+ * original single loop behaviour.
+ *
+ * Usage:
+ *   ./ircserv <port> <password> [--workers N] [--backend poll|epoll|epoll-et|uring]
+ *             [--zerocopy BYTES] [--backlog N] [--registration-timeout SEC]
+ *             [--ping-interval SEC] [--pong-timeout SEC] [--listen ADDR[:PORT]]...
+ *             [--tls-listen ADDR[:PORT]]... [--tls-cert FILE] [--tls-key FILE]
+ *             [--ktls on|off] [--unix-listen PATH]... [--busy-poll USEC]
+ *             [--notsent-lowat BYTES] [--huge-pages on|off]
+ */
+struct ServerConfig{
+	int		n_workers; // number of event loop threads, each one with its own listening socket
+	BACKEND	backend;
+	size_t	zerocopy_min; // sends of at least this many bytes use MSG_ZEROCOPY, 0: never
+	int		backlog; // listen() queue of each listening socket, absorbs reconnect storms
+	// low latency mode: the loops spin this long before sleeping, 0: off
+	unsigned	busy_poll_usec;
+	// TCP_NOTSENT_LOWAT of the client sockets, 0: the kernel's default
+	unsigned	notsent_lowat;
+	// liveness, in seconds: a connection must register within
+	// registration_timeout; a client quiet for ping_interval gets a PING and is
+	// dropped if nothing comes back within pong_timeout
+	int		registration_timeout;
+	int		ping_interval;
+	int		pong_timeout;
+	// empty: <port> on every address(the Server fills it in)
+	std::vector<ListenAddress>	listeners;
+	// PEM certificate chain and private key of the TLS listeners, the key
+	// defaults to the certificate file
+	std::string	tls_cert;
+	std::string	tls_key;
+	bool		ktls; // let the kernel encrypt when it can
+	bool		huge_pages; // map the connection buffer slabs(SlabPool) in huge pages
+	// the command line we were started with, exec'd again by a hot restart
+	std::vector<std::string>	command_line;
+	// set in the process started by a hot restart: the Unix socket the old
+	// process hands its sockets and state over, -1 otherwise
+	int		handoff_fd;
+
+	ServerConfig();
+
+	static ServerConfig	parseOptions(int ac, char** av, int first);
+};
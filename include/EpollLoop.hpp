@@ -0,0 +1,64 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EpollLoop.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 11:02:29 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 11:02:29 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include "ReadyLoop.hpp"
+
+#define EPOLL_MAX_EVENTS (1024) // epoll_wait() batch size
+#define EPOLL_BUSY_POLL_BUDGET (64) // packets per busy poll, more needs CAP_NET_ADMIN
+
+// per epoll busy polling, Linux 6.9(linux/eventpoll.h, not in every libc yet)
+#ifndef EPIOCSPARAMS
+struct epoll_params{
+	uint32_t	busy_poll_usecs;
+	uint16_t	busy_poll_budget;
+	uint8_t		prefer_busy_poll;
+	uint8_t		pad;
+};
+# define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+/**
+ * @brief epoll backend(--backend epoll or epoll-et).
+ *
+ * Level-triggered: a client is registered for EPOLLIN, EPOLLOUT is added with
+ * EPOLL_CTL_MOD only while its send queue is not empty.
+ * Edge-triggered: every socket is registered once for EPOLLIN | EPOLLOUT and
+ * never modified again. The loop accepts until EAGAIN and reads until EAGAIN,
+ * the end of stream or the client's read budget ran out; in that case the client
+ * is on the ready list, so no edge is lost. A spurious EPOLLOUT on an empty
+ * queue costs nothing.
+ */
+class EpollLoop : public ReadyLoop{
+	public:
+		explicit EpollLoop(bool edge_triggered);
+		~EpollLoop();
+
+		const char*	getName() const override;
+		void		enableBusyPoll(unsigned usec) override;
+		void		runOnce(EventHandler& handler) override;
+
+	protected:
+		bool	watch(int fd, bool want_write, bool is_new) override;
+		void	unwatch(int fd) override;
+
+	private:
+		int								epoll_fd_;
+		bool							edge_triggered_;
+		std::vector<struct epoll_event>	events_; // epoll_wait() buffer
+		int								n_ready_; // events of the batch being dispatched
+};
@@ -0,0 +1,201 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EventLoop.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:05:12 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:05:12 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <deque>
+#include <cstdint>
+#include "Config.hpp"
+
+class Client;
+class TlsContext;
+struct sockaddr;
+
+#define ACCEPT_BUDGET (64) // connections accepted from one listening socket per turn
+#define LATENCY_SUB_BUCKETS (8) // LatencyHistogram buckets per power of two
+
+/**
+ * @brief What an EventLoop reports to its owner(the Server). Every call happens
+ * on the thread running the loop.
+ */
+class EventHandler{
+	public:
+		virtual ~EventHandler() = default;
+
+		// a connection was accepted(the socket is already non-blocking). Returns
+		// the client to watch, or nullptr when it was refused and closed
+		virtual std::shared_ptr<Client>	onAccept(int fd, const std::string& host) = 0;
+		// new data was appended to the receive buffer of the client. Returns
+		// true when complete lines are left(CLIENT_COMMAND_BUDGET), the loop calls
+		// again on a later turn
+		virtual bool	onData(Client& cli) = 0;
+		// the peer closed the connection or reading from it failed
+		virtual void	onDisconnect(Client& cli, const std::string& reason) = 0;
+		// writing the send queue of the client failed
+		virtual void	onWriteError(Client& cli) = 0;
+		// wake() was called
+		virtual void	onWake() = 0;
+		// the timer started with startTimer() expired n_ticks times since the
+		// last call
+		virtual void	onTick(uint64_t n_ticks) = 0;
+};
+
+/**
+ * @brief Log-linear histogram of durations in nanoseconds: every power of two
+ * is split in LATENCY_SUB_BUCKETS buckets, so a percentile is off by at most
+ * 1/LATENCY_SUB_BUCKETS whatever the scale, in a fixed 4KB.
+ */
+struct LatencyHistogram{
+	unsigned long long	counts[64 * LATENCY_SUB_BUCKETS] = {};
+	unsigned long long	n_samples = 0;
+
+	void		add(uint64_t ns);
+	void		merge(const LatencyHistogram& other);
+	// upper bound of the bucket holding the p-th fraction(0.5, 0.99) of the
+	// samples, 0 without samples
+	uint64_t	percentile(double p) const;
+};
+
+/**
+ * @brief Counters of one loop, only touched by its thread. replies_sent /
+ * send_calls tells how well the replies are coalesced.
+ */
+struct IoStats{
+	unsigned long long	send_calls = 0; // sendmsg() calls, or SENDMSG requests with io_uring
+	unsigned long long	replies_sent = 0; // replies completely written
+	unsigned long long	zerocopy_sends = 0; // sendmsg() calls with MSG_ZEROCOPY
+	unsigned long long	zerocopy_bytes = 0; // bytes they wrote
+	unsigned long long	zerocopy_copied = 0; // completions where the kernel copied anyway
+	unsigned long long	tls_handshakes = 0; // completed TLS handshakes
+	unsigned long long	tls_resumed = 0; // of which resumed a session(ticket)
+	unsigned long long	tls_ktls = 0; // of which the kernel took over the sending
+	unsigned long long	busy_poll_hits = 0; // waits that found events while spinning(--busy-poll)
+	unsigned long long	sleeps = 0; // waits that blocked
+	// relay latency: from the turn that read a line to the send call writing
+	// the oldest reply it produced, for every send call
+	LatencyHistogram	relay_latency;
+};
+
+/**
+ * @brief The I/O side of one worker: it watches the listening sockets and the
+ * clients, does the accept/recv/send itself and reports the results to an
+ * EventHandler. The Server is written once against this interface, the
+ * backend is picked at startup(--backend):
+ *  - PollLoop: poll(), the portable baseline;
+ *  - EpollLoop: epoll, level- or edge-triggered;
+ *  - UringLoop: io_uring, completion based.
+ *
+ * Fairness: a client gets at most CLIENT_READ_BUDGET bytes read and
+ * CLIENT_COMMAND_BUDGET worth of commands executed per turn, an expensive
+ * command(WHO, JOIN, PRIVMSG to many targets) counting for several. A client
+ * with input left goes on the ready list, which is served round robin on the
+ * next turns(without blocking in the wait), after the clients that have new
+ * events. A listening
+ * socket gets at most ACCEPT_BUDGET connections accepted per turn, so a
+ * reconnect storm is spread over several turns instead of holding up the
+ * established clients.
+ *
+ * Except wake(), a loop is only used from its own thread.
+ */
+class EventLoop{
+	public:
+		virtual ~EventLoop();
+
+		// throws std::runtime_error; io_uring falls back to epoll when the kernel
+		// refuses it
+		static std::unique_ptr<EventLoop>	create(BACKEND backend);
+
+		virtual const char*	getName() const = 0;
+		virtual void		addListener(int fd) = 0;
+		// a listener whose connections speak TLS. False when the backend
+		// can't do the handshakes
+		virtual bool		addTlsListener(int fd, TlsContext& tls);
+		virtual void		addClient(const std::shared_ptr<Client>& cli) = 0;
+		// stop watching the client, the caller closes the socket right after
+		virtual void		removeClient(Client& cli) = 0;
+		// the send queue of the client was empty and got a reply. The queue is
+		// written once per turn, before the next wait, with the replies of the
+		// whole turn in one vectored send
+		virtual void		startSend(Client& cli) = 0;
+		// send with MSG_ZEROCOPY when one sendmsg() writes at least min_bytes.
+		// False when the backend can't, it keeps copying
+		virtual bool		enableZerocopy(size_t min_bytes);
+		// spin on a zero timeout wait for usec before sleeping, and ask the
+		// kernel to busy-poll the sockets(when it can)
+		virtual void		enableBusyPoll(unsigned usec);
+		// TCP_NOTSENT_LOWAT of the accepted sockets, 0: the kernel's default
+		void				setNotsentLowat(unsigned bytes);
+		// wait for events(no timeout) and dispatch one batch of them. Returns
+		// early on a signal or a wake()
+		virtual void		runOnce(EventHandler& handler) = 0;
+		// before a hot restart, once runOnce() isn't called any more: end every
+		// request the kernel still holds(io_uring), so the sockets and the
+		// buffers can be handed over as they are. Nothing to do for the
+		// readiness backends
+		virtual void		quiesce(EventHandler& handler);
+
+		// make runOnce() return and call onWake(), from any thread
+		void				wake();
+		// call onTick() every interval_ms from now on
+		void				startTimer(unsigned interval_ms);
+		// give the client a turn without new input: lines handed over by a hot
+		// restart are waiting in its receive buffer
+		void				markReady(Client& cli);
+		const IoStats&		getStats() const;
+		// when the last wait returned, the receive time of what this turn reads
+		uint64_t			getTurnStart() const;
+		static uint64_t		nowNs(); // CLOCK_MONOTONIC
+
+	protected:
+		int		wake_fd_; // eventfd watched by every backend
+		int		timer_fd_; // timerfd watched by every backend, disarmed until startTimer()
+		IoStats	stats_;
+		// clients with input left from an earlier turn, oldest first
+		std::deque<std::shared_ptr<Client>>	ready_list_;
+		uint64_t	busy_poll_ns_; // --busy-poll window, 0: sleep right away
+		unsigned	notsent_lowat_; // --notsent-lowat
+		uint64_t	turn_start_;
+		// listeners left alone after accept ran out of fds or memory, until a
+		// client is removed or the next tick
+		std::vector<int>	paused_listeners_;
+		size_t		accept_failures_; // since the last accept that worked
+
+		EventLoop();
+		// true while the spin that started at deadline - busy_poll_ns_ goes on
+		// (0: starts it). Call it after each empty zero timeout wait
+		bool	keepSpinning(uint64_t& deadline);
+		// the wait is over, what comes next belongs to a new turn
+		void	startTurn(bool blocking, bool spun);
+		// TCP options of an accepted socket: no Nagle delay, busy-polled reads
+		// with --busy-poll, a short unsent queue with --notsent-lowat
+		void	tuneSocket(int fd, int family);
+		void	recordSend(const Client& cli);
+		void	clearWake();
+		uint64_t	clearTimer();
+		void	addToReadyList(Client& cli);
+		std::shared_ptr<Client>	popReadyList();
+		// the host name a client gets from its peer address(IPv4 or IPv6), or
+		// its credentials on a Unix socket
+		static std::string	formatHost(int fd, const struct sockaddr* addr);
+		// out of fds or memory: accepting again right away would fail the same
+		static bool	isAcceptResourceError(int err);
+		// one warning when accepting starts failing, one line when it works
+		// again, however many retries in between
+		void	noteAcceptFailure(int err);
+		void	noteAcceptSuccess();
+
+	private:
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+};
@@ -0,0 +1,72 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Handoff.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#define HANDOFF_MAGIC "ircserv-handoff-1" // changes with the layout of the state
+#define HANDOFF_FDS_PER_MSG (250) // SCM_RIGHTS carries at most 253 fds(SCM_MAX_FD)
+#define HANDOFF_TIMEOUT_MS (10000) // how long the old process waits for the new one
+#define HANDOFF_READY 'R' // new process: started, send the state
+#define HANDOFF_DONE 'D' // new process: everything adopted, the old one can go
+
+/**
+ * @brief Flat encoding of the IRC state for a hot restart. Integers are 8 bytes
+ * in host order(both ends run on the same machine), strings are length
+ * prefixed. StateReader reads the values back in the order they were put and
+ * throws std::runtime_error when the state is short.
+ */
+class StateWriter{
+	public:
+		void				putInt(int64_t n);
+		void				putString(const std::string& s);
+		const std::string&	data() const;
+
+	private:
+		std::string	data_;
+};
+
+class StateReader{
+	public:
+		explicit StateReader(const std::string& data);
+
+		int64_t		getInt();
+		std::string	getString();
+
+	private:
+		const std::string&	data_;
+		size_t				pos_;
+};
+
+/**
+ * @brief The Unix socket between the old and the new process of a hot restart.
+ * The state goes first(8 bytes length, 8 bytes fd count, the bytes), then the
+ * fds in batches of HANDOFF_FDS_PER_MSG, each batch attached to one byte. The
+ * calls block, throw std::runtime_error on an error or a closed socket.
+ */
+class Handoff{
+	public:
+		static void			sendByte(int sock, char c);
+		// -1 for timeout_ms: no timeout
+		static char			receiveByte(int sock, int timeout_ms);
+		static void			sendState(int sock, const std::string& state, const std::vector<int>& fds);
+		static std::string	receiveState(int sock, std::vector<int>& fds);
+
+	private:
+		Handoff() = delete;
+
+		static void	writeAll(int sock, const char* data, size_t len);
+		static void	readAll(int sock, char* data, size_t len);
+};
@@ -0,0 +1,87 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   IoUring.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/23 09:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/23 09:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <linux/io_uring.h>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+#define URING_ENTRIES (1024) // submission queue size of one ring
+#define URING_BUF_GROUP (0) // id of the provided buffer group used by recv
+#define URING_BUF_COUNT (64) // buffers in the group, power of 2. Bounds the read-ahead:
+// when the loop falls behind, recv runs out of buffers and TCP pushes back on the senders
+#define URING_BUF_SIZE (4096)
+#define URING_CQE_BATCH (32u) // completions handled before the queued sends are submitted
+
+/**
+ * @brief Thin wrapper around one io_uring instance, talking to the kernel with
+ * the raw syscalls(no liburing on the target machines).
+ *
+ * It only covers what the server needs: getting SQEs, submitting, walking the
+ * completion queue and one ring of provided buffers for multishot recv.
+ * The constructor throws std::runtime_error when the kernel can't give us a
+ * ring, the caller falls back to epoll.
+ */
+class IoUring{
+	public:
+		explicit IoUring(unsigned entries);
+		~IoUring();
+
+		io_uring_sqe*	getSqe();
+		int				submit();
+		int				submitAndWait(unsigned wait_nr);
+		int				submitAndPoll();
+		unsigned		cqReady() const;
+		io_uring_cqe*	peekCqe();
+		void			cqeSeen();
+
+		void			setupBufferRing(uint16_t group, unsigned count, unsigned size);
+		char*			getBuffer(uint16_t bid) const;
+		void			recycleBuffer(uint16_t bid);
+
+	private:
+		int				ring_fd_;
+		// submission queue, shared with the kernel
+		void*			sq_ptr_;
+		size_t			sq_size_;
+		unsigned*		sq_khead_;
+		unsigned*		sq_ktail_;
+		unsigned		sq_mask_;
+		unsigned		sq_entries_;
+		io_uring_sqe*	sqes_;
+		size_t			sqes_size_;
+		unsigned		sqe_head_; // first SQE not yet handed to the kernel
+		unsigned		sqe_tail_; // next free SQE
+		// completion queue, shared with the kernel
+		void*			cq_ptr_;
+		size_t			cq_size_;
+		unsigned*		cq_khead_;
+		unsigned*		cq_ktail_;
+		unsigned		cq_mask_;
+		io_uring_cqe*	cqes_;
+		// provided buffers
+		io_uring_buf_ring*	buf_ring_;
+		size_t			buf_ring_size_;
+		char*			buf_base_;
+		unsigned		buf_count_;
+		unsigned		buf_size_;
+		uint16_t		buf_tail_;
+
+		IoUring(const IoUring&) = delete;
+		IoUring& operator=(const IoUring&) = delete;
+
+		unsigned		flushSq();
+		int				enter(unsigned to_submit, unsigned wait_nr, unsigned flags);
+		void			release();
+};
@@ -16,6 +16,7 @@
 #include <chrono>
 #include <ctime>
 #include <iostream>
+#include <mutex>
 
 // Define colours
 #define RESET "\033[0;0m"
@@ -40,11 +41,15 @@ class Logger{
 
 		~Logger();
 		static void log(enum LEVEL level, std::string msg);
+		// lets a caller skip building a message that wouldn't be printed
+		static constexpr bool	enabled(enum LEVEL level){ return level >= LOG_LEVEL; }
 
 	private:
 		Logger() = delete;
 		Logger(const Logger&) = delete;
 		Logger& operator=(const Logger&) = delete;
 
+		static std::mutex	mutex_; // one line at a time from the worker threads
+
 		static void cleanMessage(std::string& msg);
 };
@@ -13,55 +13,89 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <unordered_set>
+#include <unordered_map>
 #include <vector>
 #include "Server.hpp"
 
 class Client;
+struct CommandDescriptor;
 
+#define MESSAGE_MAX_TOKENS (256) // parameters a line of 512 bytes(the IRC limit) can hold
+
+/**
+ * @brief Parameters of a Message: views into its line, in the order they came.
+ * The first MESSAGE_MAX_TOKENS are kept in the object itself, only a line
+ * longer than IRC allows can need more, which then comes from the heap.
+ */
+class ViewList{
+	public:
+		ViewList();
+
+		size_t				size() const;
+		bool				empty() const;
+		std::string_view	operator[](size_t i) const;
+		std::string_view	at(size_t i) const;
+		const std::string_view*	begin() const;
+		const std::string_view*	end() const;
+
+		void				push_back(std::string_view token);
+		// owned copies, for the code that keeps them
+		std::vector<std::string>	toStrings() const;
+
+	private:
+		// left uninitialised, a line only pays for the tokens it has
+		alignas(std::string_view) unsigned char	inline_[MESSAGE_MAX_TOKENS * sizeof(std::string_view)];
+		std::vector<std::string_view>	spill_;
+		std::string_view*	items_; // inline_, or spill_ once it is full
+		size_t				size_;
+
+		ViewList(const ViewList&) = delete;
+		ViewList& operator=(const ViewList&) = delete;
+};
+
+/**
+ * @brief One line of a client, parsed in place: the prefix, command, middle
+ * parameters and trailing part are views into the line, which must outlive the
+ * Message. Parsing allocates nothing for a line of up to 512 bytes.
+ *
+ * The middle parameters are kept whole, in the order they came: what they mean
+ * (a comma list of channels, a key...) is up to the grammar of the command, see
+ * CommandArgs.hpp.
+ */
 class Message{
 	public:
-		Message(std::string& message);
+		explicit Message(std::string_view message);
 		~Message();
 
 		bool					parseMessage();
-		const std::string& 		getWholeMessage() const;
+		std::string_view		getWholeMessage() const;
+		std::string_view		getPrefix() const;
 		int 					getNumberOfParameters() const;
-		const std::string&		getTrailing() const;
-		const std::vector<std::string>&	getParameters() const;
-		const std::vector<std::string>&	getUsers() const;
-		const std::vector<std::string>&	getChannels() const;
+		std::string_view		getTrailing() const;
+		const ViewList&			getParameters() const;
 		COMMANDTYPE 			getCommandType() const;
-		const std::string& 		getCommandString() const;
-		const std::vector<std::string>& getPasswords() const;
+		const CommandDescriptor*	getCommand() const; // nullptr for an unknown command
+		std::string_view		getCommandString() const;
 		bool getTrailingEmpty() const;
+		bool hasTrailing() const;
 
 		// for testing only
 		// void	printMsgInfo() const;
-		// void	printUserList() const;
 
 	private:
-		using CommandHandler = std::function<bool()>;
-		std::unordered_map<std::string, CommandHandler> command_handlers_;
-		void				initCommandHandlers();
-		bool				handleGeneric();
-		bool				handleCAP();
-		bool 				handlePASS();
-		bool				handleKICK();
-		bool				handleJOIN();
-		bool				handleMODE();
-		bool				handleNoParse();
-		bool 				validateParameters(const std::string& command);
-		std::string			whole_msg_;
+		std::string_view	nextWord(size_t& pos) const;
+		std::string_view	whole_msg_;
+		std::string_view	prefix_;//origin given before the command(":nick!user@host"), usually none
 		int					number_of_parameters_;
-		std::string			msg_trailing_;//everything found after :
-		std::vector<std::string>	parameters_;//All the parameters, except commandtype or trailing message
-		std::vector<std::string>	msg_users_;//parameters that should be users in the message
-		std::vector<std::string>	msg_channels_;//parameters that should be channels in the message
+		std::string_view	msg_trailing_;//everything found after :
+		ViewList			parameters_;//the middle parameters, except commandtype or trailing message
 		COMMANDTYPE			cmd_type_;//type of the command as defined in the server.hpp
-		std::string			cmd_string_;//string version of the given command
-		std::vector<std::string>	passwords_;//passwords for the JOIN command if it exists
+		const CommandDescriptor*	command_;//entry of the command in the CommandTable
+		std::string_view	cmd_string_;//string version of the given command
+		bool				has_trailing_;//a word starting with ':' was found
 		bool				msg_trailing_empty_;//set to true only if the msg_trailing_ was ":"
 };
 
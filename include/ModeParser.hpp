@@ -0,0 +1,111 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ModeParser.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/06/01 15:40:12 by jingwu            #+#    #+#             */
+/*   Updated: 2025/06/01 15:40:12 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "CommandArgs.hpp"
+
+// what a mode letter is, per table entry
+#define MODE_KNOWN (1u << 0)
+#define MODE_ARG_ON_SET (1u << 1) // +x takes an argument
+#define MODE_ARG_ON_UNSET (1u << 2) // -x takes an argument
+
+/**
+ * @brief One entry per byte of a mode string: the MODE_* flags of the letter,
+ * 0 for a letter we don't know.
+ */
+using ModeTable = std::array<uint8_t, 256>;
+
+/**
+ * @brief Built by the compiler: `plain` letters take no argument, `arg_on_set`
+ * ones take one when set(+k key), `arg_always` ones both ways(+o/-o nick).
+ */
+constexpr ModeTable	makeModeTable(std::string_view plain, std::string_view arg_on_set,
+	std::string_view arg_always){
+	ModeTable	table{};
+
+	for (char c : plain){
+		table[static_cast<unsigned char>(c)] = MODE_KNOWN;
+	}
+	for (char c : arg_on_set){
+		table[static_cast<unsigned char>(c)] = MODE_KNOWN | MODE_ARG_ON_SET;
+	}
+	for (char c : arg_always){
+		table[static_cast<unsigned char>(c)] = MODE_KNOWN | MODE_ARG_ON_SET | MODE_ARG_ON_UNSET;
+	}
+	return table;
+}
+
+inline constexpr ModeTable	USER_MODES = makeModeTable("iwroO", "", "");
+inline constexpr ModeTable	CHANNEL_MODES = makeModeTable("it", "kl", "o");
+
+/**
+ * @brief One letter of a mode string, with the sign in force and its argument
+ * (empty for a mode that takes none).
+ */
+struct ModeChange{
+	char				mode;
+	bool				adding;
+	std::string_view	arg;
+};
+
+enum MODESTATUS{
+	MODE_CHANGE, // a change to apply
+	MODE_UNKNOWN, // change.mode isn't in the table
+	MODE_MISSING_ARG, // change.mode needs an argument and none is left
+	MODE_END
+};
+
+/**
+ * @brief Walks a mode string once("+itk-l key"): signs switch the direction,
+ * every letter is looked up in the table and gets the next argument if it takes
+ * one. A letter without a sign before it is a '+'. Nothing is copied or
+ * allocated.
+ */
+class ModeParser{
+	public:
+		ModeParser(const ModeTable& table, std::string_view modes, const WordRange& args);
+
+		MODESTATUS	next(ModeChange& change);
+		size_t		getArgsUsed() const;
+
+	private:
+		const ModeTable&	table_;
+		std::string_view	modes_;
+		WordRange			args_;
+		size_t				pos_; // next byte of modes_
+		size_t				arg_; // next argument
+		bool				adding_;
+};
+
+/**
+ * @brief The changes that took effect, written as a MODE line wants them: one
+ * sign per run("+tl-k") and the arguments in the same order.
+ */
+class ModeDelta{
+	public:
+		ModeDelta();
+
+		void				add(const ModeChange& change);
+		bool				empty() const;
+		const std::string&	getModes() const;
+		const std::string&	getParams() const; // space separated
+
+	private:
+		std::string	modes_;
+		std::string	params_;
+		char		sign_; // of the last change added, 0 before the first
+};
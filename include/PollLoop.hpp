@@ -0,0 +1,39 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   PollLoop.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 11:40:03 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 11:40:03 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <poll.h>
+#include "ReadyLoop.hpp"
+
+/**
+ * @brief poll() backend(--backend poll): the whole fd set goes to the kernel on
+ * every wait, so the cost grows with the number of connections. Kept as the
+ * portable baseline the other backends are measured against.
+ */
+class PollLoop : public ReadyLoop{
+	public:
+		PollLoop();
+
+		const char*	getName() const override;
+		void		runOnce(EventHandler& handler) override;
+
+	protected:
+		bool	watch(int fd, bool want_write, bool is_new) override;
+		void	unwatch(int fd) override;
+
+	private:
+		std::vector<struct pollfd>		poll_fds_;
+		std::unordered_map<int, size_t>	index_; // fd -> position in poll_fds_
+};
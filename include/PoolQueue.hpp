@@ -0,0 +1,110 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   PoolQueue.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/29 15:20:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/29 15:20:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "SlabPool.hpp"
+
+#define POOL_QUEUE_MIN (8) // slots of the first chunk
+
+/**
+ * @brief FIFO of T in a ring of SlabPool memory, for the per-client queues.
+ * Unlike std::deque it owns nothing while empty: the chunk is taken with the
+ * first element and given back with the last one. The capacity is a power of
+ * two and doubles when full.
+ */
+template <typename T>
+class PoolQueue{
+	public:
+		PoolQueue() : capacity_(0), head_(0), size_(0){}
+		PoolQueue(const PoolQueue& other) : PoolQueue(){
+			*this = other;
+		}
+		PoolQueue&	operator=(const PoolQueue& other){
+			if (this != &other){
+				clear();
+				for (size_t i = 0; i < other.size(); i++){
+					push_back(other[i]);
+				}
+			}
+			return *this;
+		}
+		~PoolQueue(){
+			clear();
+		}
+
+		bool	empty() const{ return size_ == 0; }
+		size_t	size() const{ return size_; }
+		// pool memory held, 0 while empty
+		size_t	getBufferBytes() const{ return storage_.size(); }
+
+		T&			operator[](size_t i){ return slot(head_ + i); }
+		const T&	operator[](size_t i) const{ return slot(head_ + i); }
+		T&			front(){ return slot(head_); }
+		const T&	front() const{ return slot(head_); }
+		T&			back(){ return slot(head_ + size_ - 1); }
+		const T&	back() const{ return slot(head_ + size_ - 1); }
+
+		template <typename... Args>
+		void	emplace_back(Args&&... args){
+			if (size_ == capacity_){
+				grow();
+			}
+			new (&slot(head_ + size_)) T(std::forward<Args>(args)...);
+			size_++;
+		}
+		void	push_back(const T& value){
+			emplace_back(value);
+		}
+		void	pop_front(){
+			slot(head_).~T();
+			head_ = (head_ + 1) & (capacity_ - 1);
+			if (--size_ == 0){
+				storage_.reset();
+				capacity_ = 0;
+				head_ = 0;
+			}
+		}
+		void	clear(){
+			while (!empty()){
+				pop_front();
+			}
+		}
+
+	private:
+		PoolBuffer	storage_;
+		size_t		capacity_;
+		size_t		head_;
+		size_t		size_;
+
+		T&	slot(size_t i) const{
+			return reinterpret_cast<T*>(storage_.data())[i & (capacity_ - 1)];
+		}
+
+		void	grow(){
+			size_t		capacity = capacity_ == 0 ? POOL_QUEUE_MIN : capacity_ * 2;
+			PoolBuffer	bigger(capacity * sizeof(T));
+			T*			slots = reinterpret_cast<T*>(bigger.data());
+
+			for (size_t i = 0; i < size_; i++){
+				T&	old = slot(head_ + i);
+				new (&slots[i]) T(std::move(old));
+				old.~T();
+			}
+			storage_ = std::move(bigger);
+			capacity_ = capacity;
+			head_ = 0;
+		}
+};
@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ReadyLoop.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:31:47 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:31:47 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "EventLoop.hpp"
+
+/**
+ * @brief Common part of the readiness based backends(poll, epoll). The kernel
+ * only says a socket is ready, the loop then calls accept/recv/send itself:
+ *  - a listener is readable: accept up to ACCEPT_BUDGET pending connections
+ *    (accept4, already non-blocking). A listener with connections left waits
+ *    on accept_backlog_ for the next turn, like a client on the ready list.
+ *    Out of fds or memory(EMFILE, ENFILE, ENOBUFS, ENOMEM), the listener is
+ *    taken out of the interest set until a client is removed or the next
+ *    timer tick, then tried again from accept_backlog_;
+ *  - a client is readable: Client::receiveRawData(), then onData(), both
+ *    within the client's budget. Leftover input puts it on the ready list;
+ *    while complete lines wait there, the socket isn't read, TCP holds back
+ *    a flooding client instead of our memory;
+ *  - replies: the clients that got some during a turn are written at the start
+ *    of the next one, before the wait, with one sendmsg() over all their
+ *    queued replies. What the socket doesn't take waits for it to be
+ *    writable; write interest is only registered while the queue is not
+ *    empty;
+ *  - MSG_ZEROCOPY(enableZerocopy()): a sendmsg() of at least zerocopy_min_
+ *    bytes lets the kernel send from our buffers. The messages stay
+ *    referenced until their completion is read from the socket's error queue,
+ *    which the wait reports as an error(EPOLLERR/POLLERR) on the client;
+ *  - TLS(addTlsListener()): the handshake runs on the client's readiness
+ *    events, non-blocking, before the first read. Then the input is read
+ *    with SSL_read() and the queue is written in records of up to
+ *    TLS_RECORD_SIZE, or with the plain recv()/sendmsg() for a direction the
+ *    kernel took over(kTLS).
+ *
+ * The subclasses implement the interest set(watch()/unwatch()) and the wait.
+ */
+class ReadyLoop : public EventLoop{
+	public:
+		void	addListener(int fd) override;
+		bool	addTlsListener(int fd, TlsContext& tls) override;
+		void	addClient(const std::shared_ptr<Client>& cli) override;
+		void	removeClient(Client& cli) override;
+		void	startSend(Client& cli) override;
+		bool	enableZerocopy(size_t min_bytes) override;
+
+	protected:
+		std::vector<int>									listeners_;
+		std::unordered_map<int, TlsContext*>				tls_listeners_;
+		// listeners whose accept budget ran out, oldest first
+		std::vector<int>									accept_backlog_;
+		// clients whose send queue got its first reply since flushSends()
+		std::vector<std::shared_ptr<Client>>				send_ready_;
+		std::unordered_map<int, std::shared_ptr<Client>>	clients_; // the key is the client socket
+		size_t												zerocopy_min_; // 0: never MSG_ZEROCOPY
+		std::string											tls_record_; // plaintext of the record being written
+
+		ReadyLoop();
+
+		// add fd to the interest set(is_new), or change its write interest.
+		// False when the kernel refused it
+		virtual bool	watch(int fd, bool want_write, bool is_new) = 0;
+		virtual void	unwatch(int fd) = 0;
+
+		void	handleReady(EventHandler& handler, int fd, bool readable, bool writable,
+					bool error, bool hangup);
+		// serve the first n_listed clients of the ready list, those listed
+		// before this turn's wait
+		void	serveReadyList(EventHandler& handler, size_t n_listed);
+		// accept more on the first n_listed listeners of accept_backlog_
+		void	serveAcceptBacklog(EventHandler& handler, size_t n_listed);
+		// write the replies queued since the last call, before waiting
+		void	flushSends(EventHandler& handler);
+
+	private:
+		void	acceptClients(EventHandler& handler, int listen_fd);
+		void	pauseListener(int listen_fd);
+		void	resumeListeners();
+		void	readClient(EventHandler& handler, const std::shared_ptr<Client>& cli);
+		bool	writeClient(Client& cli);
+		bool	writeTlsClient(Client& cli);
+		void	continueHandshake(EventHandler& handler, const std::shared_ptr<Client>& cli);
+		bool	readZerocopyCompletions(Client& cli);
+		void	updateInterest(Client& cli);
+};
@@ -0,0 +1,80 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RecvBuffer.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/28 10:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/28 10:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <sys/uio.h> // for struct iovec
+#include "SlabPool.hpp"
+
+#define RECV_BUFFER_MIN (1024) // first allocation, and the least room offered to a read
+#define RECV_BUFFER_KEEP (16 * 1024) // largest size a drained buffer comes back with
+
+/**
+ * @brief Receive buffer of a client: a ring that the socket is read into with
+ * readv()(its free room is at most two spans), and that hands out the lines.
+ *
+ * The memory is a SlabPool chunk, held only while there is data: the chunk
+ * goes back to the pool as soon as the last line is taken out, an idle client
+ * holds none. The capacity is a power of two and doubles when a read finds the
+ * ring full; the next chunk is taken at the size the last one reached(up to
+ * RECV_BUFFER_KEEP), so a flooding client doesn't grow again on every read.
+ *
+ * A line is handed out as a view into the ring and taken out by moving the
+ * read position; only a line that wraps around the end is copied(into
+ * wrapped_). The ring is rewound once per read, in prepareRead(), and given
+ * back when nextLine() finds it empty, never while a view is alive.
+ *
+ * A line ends with LF, CRLF like the RFC wants or a bare LF like many clients
+ * send. The search(SSE2/AVX2 when the CPU has them) remembers how far it got,
+ * every byte is scanned once however many reads a line takes to arrive.
+ */
+class RecvBuffer{
+	public:
+		RecvBuffer();
+		RecvBuffer(const RecvBuffer& other);
+		RecvBuffer&	operator=(const RecvBuffer& other);
+
+		size_t		size() const;
+		bool		empty() const;
+
+		// writing side: offer free room to a read, then keep what it wrote
+		size_t		prepareRead(struct iovec iov[2], int& n_iov, size_t max);
+		void		commit(size_t n_bytes);
+		void		append(const char* data, size_t len);
+
+		// reading side. A view stays valid until the next call to nextLine(),
+		// prepareRead() or append()
+		bool		hasLine() const;
+		bool		nextLine(std::string_view& line);
+		std::string	contents() const;
+		size_t		getBufferBytes() const;
+
+	private:
+		PoolBuffer	buf_; // a power of two, nothing while empty
+		size_t		next_size_; // capacity to take the next chunk with
+		size_t		head_; // first byte not taken out yet
+		size_t		tail_; // end of the data; both grow, masked on access
+		// the first scanned_ bytes from head_ hold no LF; line_len_ is the length
+		// of the first line(terminator included) once found, 0 before
+		mutable size_t	scanned_;
+		mutable size_t	line_len_;
+		std::string	wrapped_; // the last line handed out, when it wrapped around
+
+		size_t		capacity() const;
+		size_t		room() const;
+		void		reserve(size_t n_bytes);
+		void		release();
+		void		copyOut(char* dst, size_t len) const;
+};
@@ -13,6 +13,8 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #define SERVER "irc.ircserv.com"
 #define SUPPORTUSERMODE "o"
@@ -170,6 +172,9 @@ inline std::string rplMode(const std::string& prefix,
 						   const std::string& channelName,
 	                       const std::string& modes, 
 						   const std::string& params){
+	if (params.empty()){
+		return prefix + " MODE " + channelName + " " + modes + CRLF;
+	}
 	return prefix + " MODE " + channelName + " " + modes + " " + params + CRLF;
 }
 
@@ -221,10 +226,15 @@ inline std::string rplResetNick(const std::string& prefix,
  * @param target: message receiveer, can be a user or a channel
  * @param message: message that sender input
  */
-inline std::string rplPrivMsg(const std::string& source, 
-							  const std::string& target,
-							  const std::string& message){
-	return ":" + source + " PRIVMSG " + target + " :" + message + CRLF;
+inline std::string rplPrivMsg(const std::string& source,
+							  std::string_view target,
+							  std::string_view message){
+	std::string	reply;
+	// the relay hot path: one allocation for the whole line
+	reply.reserve(source.size() + target.size() + message.size() + 14);
+	reply.append(":").append(source).append(" PRIVMSG ").append(target)
+		.append(" :").append(message).append(CRLF);
+	return reply;
 }
 
 /*...................................Error Replies.................................*/
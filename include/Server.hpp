@@ -15,30 +15,54 @@
 #include <string>
 #include <iostream>
 #include <unordered_map> //  don’t care about the order and want better performance
-#include <regex>
 #include <vector>
 #include <stdexcept>
 #include <netinet/in.h> // for struct sockaddr_in
-#include <sys/epoll.h>
 #include <signal.h>
 #include <cstring> //for memset
 #include <fcntl.h>  // for fcntl()
 #include <set> // for std::set
 #include <arpa/inet.h> // for inet_ntop
+#include <sys/un.h> // for sockaddr_un
+#include <sys/stat.h> // for lstat
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include "Config.hpp"
+#include "Worker.hpp"
+#include "EventLoop.hpp"
+#include "Tls.hpp"
+#include "SlabPool.hpp"
+#include "CharClass.hpp" // SPECIAL_CHARS_NAMES, SPECIAL_CHARS_PASSWD
 
 class Client;
 class Channel;
 class Message;
+struct PassArgs;
+struct NickArgs;
+struct UserArgs;
+struct PrivmsgArgs;
+struct JoinArgs;
+struct PartArgs;
+struct KickArgs;
+struct InviteArgs;
+struct TopicArgs;
+struct ModeArgs;
+struct QuitArgs;
+struct CapArgs;
+struct PingArgs;
+struct PongArgs;
+struct WhoisArgs;
+struct WhoArgs;
 
 
-#define SPECIAL_CHARS_NAMES "[]\\`_^{|}"
-#define SPECIAL_CHARS_PASSWD "!@#$%^&*()-_=+[]{}|;:'\",.<>?/\\~`"
 #define PASSWORD_RULE "Allow contain:\n1.Letters\n2.Digits\n3.Characters in\"!@#$%^&*()-_=+[]{}|;:'\",.<>?/\\~`\""
 #define TARGET_LIM_IN_ONE_CMD (4)
 #define SUPPORTCHANNELPREFIX "#+!&"
 #define	SERVER_CHANNEL_LIMIT (50)
 #define USER_CHANNEL_LIMIT (20)
 #define SERVER_USER_LIMIT (5000)
+#define TIMER_TICK_MS (1000) // one tick of the workers' timer wheels
 
 enum COMMANDTYPE{
 	PASS,
@@ -56,29 +80,53 @@ enum COMMANDTYPE{
 	PING,
 	WHOIS,
 	WHO,
+	PONG,
 	INVALID
 };
 
-class Server{
+// The EventHandler part is what the worker loops call back into
+class Server : private EventHandler{
 	public:
-		Server(std::string port, std::string password);
+		Server(std::string port, std::string password,
+			const ServerConfig& config = ServerConfig());
 		~Server();
 
 		void	startServer();
 		static int	responseToClient(Client& cli, const std::string& response);
+		static int	responseToClient(Client& cli, const SharedMessage& response);
 
 	private:
 		int					serv_port_;
 		std::string			serv_passwd_;
 		static Server*		server_;
-		int					serv_fd_;
-		int					epoll_fd_;
-		struct sockaddr_in	serv_addr_;
+		ServerConfig		config_;
 		int					n_channel_;
 		int					n_user_;
 
-		static constexpr int			MAX_EVENTS = 1024;
-		static volatile sig_atomic_t	keep_running_; // internal flag
+		// internal flag, set by the signal handler and read by every worker. A
+		// lock-free atomic is still safe to write from a signal handler.
+		static std::atomic<int>			keep_running_;
+		// SIGUSR2: worker 0 starts a hot restart at the end of its loop turn
+		static std::atomic<int>			upgrade_requested_;
+		// the loop the signal handler wakes(worker 0's), nullptr outside startServer()
+		static std::atomic<EventLoop*>	signal_loop_;
+		// Unix socket to the new process once it is ready, -1 otherwise. The
+		// workers then quiesce their loops and the state is handed over
+		std::atomic<int>				handoff_fd_;
+
+		// one event loop per worker thread; a client belongs to the worker that
+		// accepted it
+		std::vector<std::unique_ptr<Worker>>	workers_;
+		// certificate and session tickets of the TLS listeners, shared by the
+		// workers. nullptr without --tls-listen
+		std::unique_ptr<TlsContext>				tls_;
+		// socket files of the --unix-listen listeners, removed when we stop,
+		// unless a hot restart handed them over
+		std::vector<std::string>				unix_paths_;
+		static thread_local Worker*				current_worker_; // the worker running on this thread
+		// guards clients_, channels_, the counters and the IRC state of every
+		// Client/Channel. The socket side of a Client belongs to its worker.
+		std::mutex								state_mutex_;
 
 		// std::shared_ptr<T> is a smart pointer introduced in C++11 that manages the
 		// lifetime of a dynamically allocated object. It does so using reference
@@ -87,62 +135,87 @@ class Server{
 		// the object is automatically deleted.
 		std::unordered_map<int, std::shared_ptr<Client>>			clients_; // the key is client socket (client_fd)
 		std::unordered_map<std::string, std::shared_ptr<Channel>>	channels_; // string is the channel name
-		std::vector<struct epoll_event>								events_; // using for saving the clients' fds
-		static const std::set<COMMANDTYPE>							pre_registration_allowed_commands_;
-		static const std::set<COMMANDTYPE>							operator_commands_;
-
-		// this defines executeFunc is a pointer to a function inside the Message class
-		// that takes two reference arguments and returns void.
-		// Using in the server class
-		using executeFunc = void (Server::*)(Message& msg, Client& cli);
-		static const std::unordered_map<COMMANDTYPE, Server::executeFunc> execute_map_;
+		// the registered clients by casemapNick() of their nickname
+		std::unordered_map<std::string, std::shared_ptr<Client>>	nicks_;
 
+		// takes the command methods below as the handlers of its commands
+		friend class CommandTable;
 
 		Server() = delete;
 		Server(const Server&) = delete;
 		Server& operator=(const Server&) = delete;
 
 		void		setupSignalHandlers();
+		void		setupTls();
 		static void	signalHandler(int signum);
-		void		setupServSocket();
-		void		acceptNewClient();
-		void		processDataFromClient(int idx);
+		void		setupWorker(Worker& w, std::vector<int>& adopted);
+		int			setupServSocket(const ListenAddress& addr);
+		int			takeListener(std::vector<int>& adopted, const ListenAddress& addr);
+		void		runWorker(Worker& w);
+		void		stopWorkers();
+		std::shared_ptr<Client>	registerClient(Worker& w, int client_fd, const std::string& host);
+		bool		runClientCommands(std::shared_ptr<Client> client);
+		int			queueToClient(Client& cli, const SharedMessage& response, uint64_t since);
+		void		postToWorker(Client& cli, const SharedMessage& response, uint64_t since);
+		void		drainMailbox(Worker& w);
+		void		scheduleRemoval(Client& cli, const std::string& reason);
+		void		reapClients(Worker& w);
+
+		// EventHandler, called by the loop of current_worker_
+		std::shared_ptr<Client>	onAccept(int fd, const std::string& host) override;
+		bool		onData(Client& cli) override;
+		void		onDisconnect(Client& cli, const std::string& reason) override;
+		void		onWriteError(Client& cli) override;
+		void		onWake() override;
+		void		onTick(uint64_t n_ticks) override;
+		void		checkLiveness(Worker& w, Client& cli);
+
 		void		removeClient(Client& usr, std::string reason);
 		void		removeChannel(const std::string& channel_name);
 		void		executeCommand(Message& msg, Client& cli);
 		void		cleanServer();
 
+		// hot restart(Handoff.cpp)
+		void		startUpgrade();
+		void		handOver();
+		void		restoreState(int sock);
+
 		std::string 				getChannelsOfUser(Client& client);
 		std::shared_ptr<Channel>		getChannelByName(const std::string& channel_name) const;
 		std::shared_ptr<Client>			getUserByNick(const std::string& user_nick) const;
 		// Client* getClientByNick(const std::string& nick) const;
 
-		// commands
-		void		passCommand(Message& msg, Client& cli);
-		void		nickCommand(Message& msg, Client& cli);
-		void		userCommand(Message& msg, Client& cli);
-		void		privmsgCommand(Message& msg, Client& cli);
-		void		joinCommand(Message& msg, Client& cli);
-		void		partCommand(Message& msg, Client& cli);
-		void		quitCommand(Message& msg, Client& cli);
-		void		capCommand(Message& msg, Client& cli);
-		void		pingCommand(Message& msg, Client& cli);
-		void		whoisCommand(Message& msg, Client& cli);
-		void		whoCommand(Message& msg, Client& cli);
+		// commands, given the arguments their grammar parsed(CommandArgs.hpp)
+		template <typename Args, void (Server::*Handler)(const Args&, Client&)>
+		void		runCommand(Message& msg, Client& cli);
+		void		passCommand(const PassArgs& args, Client& cli);
+		void		nickCommand(const NickArgs& args, Client& cli);
+		void		userCommand(const UserArgs& args, Client& cli);
+		void		privmsgCommand(const PrivmsgArgs& args, Client& cli);
+		void		joinCommand(const JoinArgs& args, Client& cli);
+		void		partCommand(const PartArgs& args, Client& cli);
+		void		quitCommand(const QuitArgs& args, Client& cli);
+		void		capCommand(const CapArgs& args, Client& cli);
+		void		pingCommand(const PingArgs& args, Client& cli);
+		void		whoisCommand(const WhoisArgs& args, Client& cli);
+		void		whoCommand(const WhoArgs& args, Client& cli);
+		void		pongCommand(const PongArgs& args, Client& cli);
 		// Commands specific to channel operators:
-		void		kickUser(Message& msg, Client& cli);
-		void		inviteUser(Message& msg, Client& cli);
-		void		topic(Message& msg, Client& cli);
-		void		mode(Message& msg, Client& cli);
+		void		kickUser(const KickArgs& args, Client& cli);
+		void		inviteUser(const InviteArgs& args, Client& cli);
+		void		topic(const TopicArgs& args, Client& cli);
+		void		mode(const ModeArgs& args, Client& cli);
 
 		// command helper functions
 		bool		isPasswordMatch(const std::string& password);
 		void		attempRegisterClient(Client& cli);
 		bool		isNickInUse(const std::string& nick, const Client* requesting_client);
+		void		addNick(Client& cli);
+		void		removeNick(Client& cli);
 		bool		isExistedChannel(const std::string& channel_name);
-		bool		isValidModePassword(const std::string& password);
-		bool 		isPositiveInteger(const std::string& s);
-		bool		isChannelValid(const std::string& channel_name);
+		bool		isValidModePassword(std::string_view password);
+		bool 		isPositiveInteger(std::string_view s);
+		bool		isChannelValid(std::string_view channel_name);
 		std::string	trim(const std::string& str);
 
 		// for testing
@@ -155,6 +228,7 @@ class Server{
 #include "Message.hpp"
 #include "Channel.hpp"
 #include "Replies.hpp"
+#include "CommandTable.hpp"
 
 
 /**
@@ -0,0 +1,93 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   SlabPool.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/29 14:03:51 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/29 14:03:51 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#define SLAB_SIZE (2 * 1024 * 1024) // what is mapped at once, one huge page
+#define SLAB_MIN_SHIFT (7) // smallest chunk, 128 bytes
+#define SLAB_MAX_SHIFT (14) // largest chunk, 16KB; bigger buffers come from the heap
+#define SLAB_CLASSES (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_CACHE_CHUNKS (64) // free chunks of one size a thread keeps to itself
+
+/**
+ * @brief Global pool of the connection buffers(receive rings, send queues).
+ *
+ * Chunks come in fixed sizes, the powers of two from 128 bytes to 16KB, each
+ * size carved out of its own 2MB slabs(mmap). A slab is never unmapped: a
+ * freed chunk goes back to a free list and is handed to the next client that
+ * needs one, so the memory of the idle connections is shared by the busy ones.
+ *
+ * Every thread keeps up to SLAB_CACHE_CHUNKS free chunks per size, a worker
+ * only takes the global lock to exchange half of that. Larger requests are
+ * plain heap allocations.
+ *
+ * setHugePages(true) asks for the slabs in huge pages(MAP_HUGETLB), or when
+ * none are reserved, for transparent huge pages(MADV_HUGEPAGE).
+ */
+class SlabPool{
+	public:
+		static size_t	chunkSize(size_t n_bytes);
+		static void*	allocate(size_t n_bytes);
+		static void		release(void* chunk, size_t n_bytes);
+
+		static void		setHugePages(bool enabled);
+		static size_t	getReservedBytes();
+
+	private:
+		SlabPool() = delete;
+};
+
+/**
+ * @brief A chunk of the pool holding n_bytes, given back when it goes away.
+ * Move-only. An empty one owns nothing.
+ */
+class PoolBuffer{
+	public:
+		PoolBuffer() : data_(nullptr), size_(0){}
+		explicit PoolBuffer(size_t n_bytes) : size_(SlabPool::chunkSize(n_bytes)){
+			data_ = static_cast<char*>(SlabPool::allocate(size_));
+		}
+		PoolBuffer(PoolBuffer&& other) noexcept : data_(other.data_), size_(other.size_){
+			other.data_ = nullptr;
+			other.size_ = 0;
+		}
+		PoolBuffer&	operator=(PoolBuffer&& other) noexcept{
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			return *this;
+		}
+		~PoolBuffer(){
+			reset();
+		}
+
+		char*	data() const{ return data_; }
+		size_t	size() const{ return size_; } // what the chunk holds, n_bytes rounded up
+
+		void	reset(){
+			if (data_ != nullptr){
+				SlabPool::release(data_, size_);
+				data_ = nullptr;
+				size_ = 0;
+			}
+		}
+
+	private:
+		char*	data_;
+		size_t	size_;
+
+		PoolBuffer(const PoolBuffer&) = delete;
+		PoolBuffer&	operator=(const PoolBuffer&) = delete;
+};
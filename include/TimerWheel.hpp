@@ -0,0 +1,66 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TimerWheel.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/26 09:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/26 09:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Client;
+
+#define TIMER_WHEEL_BITS (6)
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS) // slots per level
+#define TIMER_WHEEL_LEVELS (3) // 64^3 ticks ahead, ~3 days at one tick a second
+
+/**
+ * @brief One pending timer. It lives inside its owner(Client), the wheel only
+ * links it into a slot list, so scheduling and cancelling allocate nothing.
+ */
+struct TimerNode{
+	TimerNode*	prev = nullptr; // nullptr while the timer isn't scheduled
+	TimerNode*	next = nullptr;
+	uint64_t	expires = 0; // tick it fires at
+	Client*		client = nullptr; // owner, given back when it fires
+};
+
+/**
+ * @brief Hierarchical timer wheel. Level 0 has one slot per tick for the next
+ * 64 ticks, every level above covers 64 times the range of the one below with
+ * slots as wide. A timer is put in the lowest level whose range reaches its
+ * expiry; each time a level 0 round is done, the next slot of level 1 is spread
+ * over level 0(and so on up), so a timer moves at most TIMER_WHEEL_LEVELS times
+ * before it fires. Scheduling, cancelling and firing are O(1) per timer.
+ *
+ * Used by one worker thread, nothing is locked.
+ */
+class TimerWheel{
+	public:
+		TimerWheel();
+
+		uint64_t	now() const;
+		// (re)schedule node to fire in `ticks` ticks(at least the next one)
+		void		schedule(TimerNode& node, uint64_t ticks);
+		void		cancel(TimerNode& node);
+		// move time forward by n_ticks, the timers due are unlinked and appended
+		// to expired
+		void		advance(uint64_t n_ticks, std::vector<TimerNode*>& expired);
+
+	private:
+		TimerNode	slots_[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // list heads
+		uint64_t	now_;
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		void	link(TimerNode& node);
+		void	cascade(int level);
+};
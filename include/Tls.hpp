@@ -0,0 +1,95 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Tls.hpp                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 15:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 15:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+
+#define TLS_DEFAULT_PORT (6697) // --tls-listen address without a port
+#define TLS_RECORD_SIZE (16384) // max plaintext of one TLS record
+
+/**
+ * @brief The server's certificate and TLS settings(--tls-cert, --tls-key), one
+ * SSL_CTX shared by every worker. Sharing it also shares the session ticket
+ * keys: a client reconnecting with a ticket resumes without the certificate
+ * exchange and key agreement, whichever worker accepts it. With kTLS
+ * (--ktls on) OpenSSL hands the record encryption to the kernel after the
+ * handshake when the kernel supports it.
+ *
+ * The constructor throws std::runtime_error when the files can't be loaded.
+ */
+class TlsContext{
+	public:
+		TlsContext(const std::string& cert_file, const std::string& key_file, bool ktls);
+		~TlsContext();
+
+		SSL_CTX*	get() const;
+
+	private:
+		SSL_CTX*	ctx_;
+
+		TlsContext(const TlsContext&) = delete;
+		TlsContext& operator=(const TlsContext&) = delete;
+};
+
+/**
+ * @brief Result of TlsSession::handshake().
+ *  DONE: the connection is established;
+ *  WANT_IO: wait until the socket is readable(or writable, wantsWrite());
+ *  FAILED: the peer isn't speaking TLS, or the handshake broke.
+ */
+enum class TLS_STATUS {
+	DONE,
+	WANT_IO,
+	FAILED
+};
+
+/**
+ * @brief The TLS side of one client socket, server role, non-blocking. read()
+ * and write() behave like recv()/send(): -1 with errno EAGAIN when the socket
+ * can't go on, EIO for a TLS error.
+ *
+ * When the kernel took over a direction(kTLS), the loop uses plain recv() or
+ * sendmsg() on the socket for it: the records are built and opened in the
+ * kernel, and a broadcast reply goes out through the same vectored send as on
+ * a plain connection.
+ */
+class TlsSession{
+	public:
+		TlsSession(TlsContext& ctx, int fd);
+		~TlsSession();
+
+		TLS_STATUS	handshake();
+		bool		isEstablished() const;
+		// the last call stopped because the socket was full
+		bool		wantsWrite() const;
+		bool		isResumed() const;
+		bool		isKtlsSend() const;
+		bool		isKtlsRecv() const;
+
+		ssize_t		read(char* buf, size_t len);
+		ssize_t		write(const char* buf, size_t len);
+
+	private:
+		SSL*	ssl_;
+		bool	established_;
+		bool	wants_write_;
+
+		ssize_t	result(int ret);
+
+		TlsSession(const TlsSession&) = delete;
+		TlsSession& operator=(const TlsSession&) = delete;
+};
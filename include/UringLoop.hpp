@@ -0,0 +1,81 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   UringLoop.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 13:16:55 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 13:16:55 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "EventLoop.hpp"
+#include "IoUring.hpp"
+
+/**
+ * @brief io_uring backend(--backend uring).
+ *
+ * Instead of waiting for readiness and then calling accept/recv/send, the loop
+ * keeps requests queued in the kernel and handles their completions:
+ *  - one multishot accept per listening socket gives every new connection;
+ *  - one multishot recv per client, the kernel picks a buffer from the provided
+ *    buffer ring and hands it over with the data. It is cancelled while the
+ *    client has lines waiting on the ready list;
+ *  - the replies queued during a turn are submitted before the next wait, one
+ *    sendmsg over all of a client's queue and only one in flight per client,
+ *    so they leave in order;
+ *  - a multishot poll on wake_fd_ and one on timer_fd_.
+ * Submitting and waiting is a single io_uring_enter() per loop turn.
+ *
+ * quiesce() cancels the accepts, the recvs and the sends still waiting for
+ * the socket(they complete with -ECANCELED, nothing written) and collects
+ * every completion, so a hot restart finds the data in the Client buffers.
+ *
+ * The constructor throws when the kernel can't give us a ring.
+ */
+class UringLoop : public EventLoop{
+	public:
+		UringLoop();
+
+		const char*	getName() const override;
+		void		addListener(int fd) override;
+		void		addClient(const std::shared_ptr<Client>& cli) override;
+		void		removeClient(Client& cli) override;
+		void		startSend(Client& cli) override;
+		void		runOnce(EventHandler& handler) override;
+		void		quiesce(EventHandler& handler) override;
+
+	private:
+		// clients with a reply queued and no sendmsg in flight
+		std::vector<std::shared_ptr<Client>>					send_ready_;
+		// clients referenced by io_uring requests, kept alive until the last
+		// completion even after they were removed
+		std::unordered_map<Client*, std::shared_ptr<Client>>	clients_;
+		// removed during this turn, released once their requests are done
+		std::vector<std::shared_ptr<Client>>					closing_;
+		std::vector<int>										listeners_;
+		int														n_accepts_; // multishot accepts in flight
+		bool													quiescing_; // quiesce(): nothing is armed again
+		// declared last: destroyed first, the kernel drops the requests before
+		// the clients they point to are freed
+		IoUring													ring_;
+
+		void	armAccept(int listen_fd);
+		void	resumeAccepts();
+		void	armWake();
+		void	armTimer();
+		void	armRecv(Client& cli);
+		void	cancelRecv(Client& cli);
+		bool	cancel(uint64_t target);
+		void	handleCompletions(EventHandler& handler, unsigned n_cqes);
+		void	submitSends();
+		void	handleAccept(EventHandler& handler, int listen_fd, int res, unsigned flags);
+		void	handleRecv(EventHandler& handler, Client& cli, int res, unsigned flags);
+		void	handleSend(EventHandler& handler, Client& cli, int res);
+		void	releaseIfIdle(Client& cli);
+};
@@ -0,0 +1,67 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Worker.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/22 11:03:18 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/22 11:03:18 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "EventLoop.hpp"
+#include "TimerWheel.hpp"
+
+class Client;
+using SharedMessage = std::shared_ptr<const std::string>;
+
+/**
+ * @brief A reply posted to the worker owning its client, with the time the line
+ * behind it was read(the relay latency goes on in the mailbox).
+ */
+struct MailboxEntry{
+	std::shared_ptr<Client>	cli;
+	SharedMessage			response;
+	uint64_t				since;
+};
+
+/**
+ * @brief State of one event loop thread(a shard).
+ *
+ * Every worker has its own listening socket for each address the server
+ * listens on(--listen), bound with SO_REUSEPORT, so the kernel spreads new
+ * connections over the workers. A client
+ * stays on the worker that accepted it: only that thread reads from, writes to
+ * and closes its socket.
+ *
+ * The IRC state(clients_, channels_ of the Server) is shared and protected by
+ * Server::state_mutex_. A reply for a client that lives on another worker is
+ * not written by the sender: it is put in the owner's mailbox and the owner's
+ * loop is woken(EventLoop::wake()).
+ */
+struct Worker{
+	int								id;
+	std::vector<int>				listen_fds; // our listening sockets, one per address
+	std::unique_ptr<EventLoop>		loop; // I/O backend, does the socket work of our clients
+	std::thread						thread; // not started for worker 0, it runs in the main thread
+	TimerWheel						timers; // liveness of our clients, one tick a second
+
+	// clients to drop at the end of the loop iteration
+	std::vector<std::pair<std::shared_ptr<Client>, std::string>>	pending_removals;
+
+	// replies for our clients produced on other workers
+	std::mutex						mailbox_mutex;
+	std::vector<MailboxEntry>		mailbox;
+
+	Worker(int worker_id) : id(worker_id){}
+	Worker(const Worker&) = delete;
+	Worker& operator=(const Worker&) = delete;
+};
@@ -55,6 +55,10 @@ bool    Channel::getLimitMode() const{
     return channel_user_limit_;
 }
 
+size_t  Channel::getUserLimit() const{
+    return user_limit_;
+}
+
 size_t  Channel::channelSize(){
     return users_.size();
 }
@@ -194,15 +198,17 @@ bool    Channel::isThereOperatorInChannel(){
 
 /**
  * @brief Sends a message to all users in the channel except the target user.
+ * The message is copied once, every member's send queue shares that copy.
  *
  * @param target The user to exclude from receiving the message.
  * @param msg The message to send to the other users in the channel.
  */
 void    Channel::notifyChannelUsers(Client& target, const std::string& msg){
+    SharedMessage shared = std::make_shared<const std::string>(msg);
     for (auto user : users_){
         if (user == &target) // do not notify target
             continue ;
-        Server::responseToClient(*user, msg);
+        Server::responseToClient(*user, shared);
     }
 }
 
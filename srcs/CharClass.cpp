@@ -0,0 +1,85 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CharClass.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/06/02 10:21:47 by jingwu            #+#    #+#             */
+/*   Updated: 2025/06/02 10:21:47 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CharClass.hpp"
+#if defined(__x86_64__)
+# include <immintrin.h>
+#endif
+
+namespace {
+
+using FindNotIn = size_t (*)(const char* data, size_t len, const CharSet& set);
+
+size_t	findNotInScalar(const char* data, size_t len, const CharSet& set){
+	for (size_t i = 0; i < len; i++){
+		if (!set.contains(data[i])){
+			return i;
+		}
+	}
+	return std::string_view::npos;
+}
+
+#if defined(__x86_64__)
+// pshufb looks up 16 nibbles at once: lo[low nibble] & hi[high nibble] is 0 for
+// the ASCII bytes out of the set, and for every byte from 0x80 up(hi[8..15] is
+// 0), which set.high then takes back or not
+__attribute__((target("ssse3")))
+size_t	findNotInSsse3(const char* data, size_t len, const CharSet& set){
+	const __m128i	lo = _mm_load_si128(reinterpret_cast<const __m128i*>(set.lo));
+	const __m128i	hi = _mm_load_si128(reinterpret_cast<const __m128i*>(set.hi));
+	const __m128i	nibble = _mm_set1_epi8(0x0F);
+	const __m128i	zero = _mm_setzero_si128();
+	size_t			i = 0;
+
+	for (; i + 16 <= len; i += 16){
+		__m128i	chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i	lo_bits = _mm_shuffle_epi8(lo, _mm_and_si128(chunk, nibble));
+		__m128i	hi_bits = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble));
+		int		out = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo_bits, hi_bits), zero));
+		if (set.high){
+			out &= ~_mm_movemask_epi8(chunk);
+		}
+		if (out != 0){
+			return i + __builtin_ctz(out);
+		}
+	}
+	size_t	rest = findNotInScalar(data + i, len - i, set);
+	return rest == std::string_view::npos ? rest : i + rest;
+}
+#endif
+
+FindNotIn	pickFindNotIn(){
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3")){
+		return findNotInSsse3;
+	}
+#endif
+	return findNotInScalar;
+}
+
+const FindNotIn	find_not_in = pickFindNotIn();
+
+} // namespace
+
+size_t	findFirstNotIn(std::string_view s, const CharSet& set){
+	return find_not_in(s.data(), s.size(), set);
+}
+
+std::string	casemapNick(std::string_view nick){
+	std::string	key(nick.size(), '\0');
+
+	for (size_t i = 0; i < nick.size(); i++){
+		key[i] = RFC1459_LOWER[static_cast<unsigned char>(nick[i])];
+	}
+	return key;
+}
@@ -11,11 +11,25 @@
 /* ************************************************************************** */
 
 #include "Client.hpp"
-
-Client::Client() : socket_fd_(0), isRegistered_(0), n_usr_channel_(0){}
+#include "Tls.hpp"
+#include <algorithm>
+
+Client::Client() : socket_fd_(0), isRegistered_(0), n_usr_channel_(0),
+send_offset_(0), send_queue_bytes_(0), write_armed_(false), isDisconnected_(false),
+input_closed_(false), worker_id_(0), ready_listed_(false), command_credit_(0), send_inflight_(false),
+recv_armed_(false), io_pending_(0), zerocopy_(false), zerocopy_next_id_(0),
+last_active_(0), awaiting_pong_(false){
+	std::memset(&send_msg_, 0, sizeof(send_msg_));
+	timer_.client = this;
+}
 
 Client::Client(int fd, std::string host) : socket_fd_(fd), hostname_(host),
-isRegistered_(0), n_usr_channel_(0){
+isRegistered_(0), n_usr_channel_(0), send_offset_(0), send_queue_bytes_(0),
+write_armed_(false), isDisconnected_(false), input_closed_(false), worker_id_(0),
+ready_listed_(false), command_credit_(0), send_inflight_(false), recv_armed_(false), io_pending_(0),
+zerocopy_(false), zerocopy_next_id_(0), last_active_(0), awaiting_pong_(false){
+	std::memset(&send_msg_, 0, sizeof(send_msg_));
+	timer_.client = this;
 }
 
 Client&	Client::operator=(const Client& other){
@@ -30,6 +44,25 @@ Client&	Client::operator=(const Client& other){
         raw_data_ = other.raw_data_;
         isRegistered_ = other.isRegistered_;
         n_usr_channel_ = other.n_usr_channel_;
+        send_queue_ = other.send_queue_;
+        send_offset_ = other.send_offset_;
+        send_queue_bytes_ = other.send_queue_bytes_;
+        send_stamps_ = other.send_stamps_;
+        write_armed_ = other.write_armed_;
+        isDisconnected_ = other.isDisconnected_.load();
+        input_closed_ = other.input_closed_;
+        worker_id_ = other.worker_id_;
+        ready_listed_ = other.ready_listed_;
+        command_credit_ = other.command_credit_;
+        send_inflight_ = other.send_inflight_;
+        recv_armed_ = other.recv_armed_;
+        io_pending_ = other.io_pending_;
+        zerocopy_ = other.zerocopy_;
+        zerocopy_next_id_ = other.zerocopy_next_id_;
+        zerocopy_pending_ = other.zerocopy_pending_;
+        // timer_ stays ours: its wheel links belong to this object
+        last_active_ = other.last_active_;
+        awaiting_pong_ = other.awaiting_pong_;
 	}
 	return *this;
 }
@@ -65,10 +98,18 @@ const std::string&	Client::getUserMode() const{
     return user_mode_;
 }
 
+const std::string&	Client::getServername() const{
+    return servername_;
+}
+
 int	Client::getUserNChannel() const{
     return n_usr_channel_;
 }
 
+int	Client::getWorkerId() const{
+    return worker_id_;
+}
+
 /**
  * @brief Used when the server responding to a command issued by client.
  * For example:
@@ -118,76 +159,396 @@ void	Client::increaseUserNchannel(){
     n_usr_channel_++;
 }
 
+void	Client::setUserNChannel(int n){
+    n_usr_channel_ = n;
+}
+
+void	Client::setWorkerId(int id){
+    worker_id_ = id;
+}
+
+TimerNode&	Client::getTimer(){
+	return timer_;
+}
+
+uint64_t	Client::getLastActive() const{
+	return last_active_;
+}
+
+/**
+ * @brief The client sent something at tick now: it is alive, whatever it sent
+ * also answers a pending PING.
+ */
+void	Client::touch(uint64_t now){
+	last_active_ = now;
+	awaiting_pong_ = false;
+}
+
+bool	Client::isAwaitingPong() const{
+	return awaiting_pong_;
+}
+
+void	Client::setAwaitingPong(bool awaiting){
+	awaiting_pong_ = awaiting;
+}
 
 /**
  * @brief Receive the raw data from socket, filling/saving into receive buffer.
+ * At most budget bytes are read, so one flooding client can't hold the loop.
+ *
+ * Reads until EAGAIN(or the end of stream), even after a read shorter than
+ * asked: with edge-triggered epoll the FIN often comes in the same wakeup as
+ * the last data, and stopping at the short read would leave the close unseen,
+ * no new event comes for it.
  *
  * @return
- *  True, read successful;
- *  False, some error;
+ *  DRAINED, everything available was read;
+ *  BUDGET, budget bytes were read, the socket may have more;
+ *  CLOSED, connection closed or some error;
  *
  */
-bool	Client::receiveRawData(){
-	char buffer[BUFFER_SIZE + 1];
+RECV_STATUS	Client::receiveRawData(size_t budget){
+	struct iovec	iov[2];
+	int				n_iov;
     ssize_t bytes_read;
-
-    std::memset(buffer, 0, sizeof(buffer));
-    while (true) {
-        bytes_read = recv(socket_fd_, buffer, BUFFER_SIZE, 0);
+    size_t total = 0;
+
+    while (total < budget) {
+        // straight into the free room of the ring, no copy on our side
+        size_t want = raw_data_.prepareRead(iov, n_iov, budget - total);
+        if (tls_ && !tls_->isKtlsRecv()) {
+            want = iov[0].iov_len;
+            bytes_read = tls_->read(static_cast<char*>(iov[0].iov_base), want);
+        } else {
+            bytes_read = readv(socket_fd_, iov, n_iov);
+        }
 
         if (bytes_read > 0) {
-            std::cout << "Received data:" << buffer << std::endl;
-            raw_data_.append(buffer, bytes_read);
+            raw_data_.commit(bytes_read);
+            total += bytes_read;
         } else if (bytes_read == 0) {
             // Connection closed
-            return false;
+            return RECV_STATUS::CLOSED;
         } else {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 // All data read
-                break;
+                return RECV_STATUS::DRAINED;
             } else {
                 // Other errors
                 perror("recv");
-                return false;
+                return RECV_STATUS::CLOSED;
             }
         }
     }
-    return true;
+    return RECV_STATUS::BUDGET;
+}
+
+void	Client::startTls(TlsContext& ctx){
+	tls_ = std::make_unique<TlsSession>(ctx, socket_fd_);
+}
+
+TlsSession*	Client::getTls() const{
+	return tls_.get();
+}
+
+bool	Client::wantsWrite() const{
+	return hasPendingOutput() || (tls_ && tls_->wantsWrite());
+}
+
+/**
+ * @brief Save data that was already received for us(io_uring recv completion)
+ * into the receive buffer.
+ */
+void	Client::appendRawData(const char* data, size_t len){
+	raw_data_.append(data, len);
 }
 
 /**
- * @brief Gets the next CRLF separated(IRC rule) message from the receive raw data
- * and stores it into passed paramenter buffer.
+ * @brief Gets the next line(IRC rule is CRLF, a bare LF is taken too) from the
+ * receive raw data, its terminator included.
  *
  * @param
- * buffer to store the message in
+ * line, set to a view into the receive buffer, valid until the next call or
+ * the next read
  *
  * @return
  * true: if successfully get the message
- * false: raw data is empty.
+ * false: no whole line is waiting.
  */
-bool	Client::getNextMessage(std::string& buffer){
-	// Find the position of CRLF ("\r\n") in raw_data_
-    size_t crlf_pos = raw_data_.find("\r\n");
-
-    if (crlf_pos == std::string::npos) {
-        // No complete message yet
-        return false;
-    }
-
-    // Extract the message (including CRLF)
-    buffer = raw_data_.substr(0, crlf_pos + 2);
+bool	Client::getNextMessage(std::string_view& line){
+	return raw_data_.nextLine(line);
+}
 
-    // Remove the processed message from raw_data_
-    raw_data_.erase(0, crlf_pos + 2);
+/**
+ * @brief What was received and not executed yet, complete lines and the start
+ * of the next one. Handed over as it is by a hot restart.
+ */
+std::string	Client::getRawData() const{
+	return raw_data_.contents();
+}
 
-    return true;
+/**
+ * @brief A whole line is waiting in the receive buffer.
+ */
+bool	Client::hasCompleteMessage() const{
+	return raw_data_.hasLine();
 }
 
 bool	Client::isRegistered(){
 	return isRegistered_;
 }
 
+/**
+ * @brief Append a reply to the outbound queue. Nothing is written to the socket
+ * here, the loop writes the queue once per turn and when the socket is
+ * writable again.
+ *
+ * @return
+ *  True, the reply is queued;
+ *  False, the queue would grow over CLIENT_SENDQ_LIMIT, the reply is dropped and
+ *  the client should be disconnected.
+ *
+ * @param since: when the line that produced the reply was read(EventLoop::nowNs()),
+ * 0 when unknown. The replies of one turn share it, it is kept once per run
+ */
+bool	Client::queueResponse(const SharedMessage& response, uint64_t since){
+	if (response->empty()){
+		return true;
+	}
+	if (send_queue_bytes_ + response->size() > CLIENT_SENDQ_LIMIT){
+		return false;
+	}
+	if (send_stamps_.empty() || send_stamps_.back().second != since){
+		send_stamps_.emplace_back(0, since);
+	}
+	send_stamps_.back().first++;
+	send_queue_.push_back(response);
+	send_queue_bytes_ += response->size();
+	return true;
+}
+
+/**
+ * @brief Drop n_bytes written to the socket from the front of the queue. A
+ * partially written reply stays at the front, send_offset_ remembers how much
+ * of it is already gone.
+ *
+ * @return the number of replies completely written
+ */
+size_t	Client::consumeSent(size_t n_bytes){
+	size_t	n_replies = 0;
+	send_queue_bytes_ -= n_bytes;
+	while (n_bytes > 0){
+		size_t	left = send_queue_.front()->size() - send_offset_;
+		if (n_bytes < left){
+			send_offset_ += n_bytes;
+			break;
+		}
+		n_bytes -= left;
+		send_queue_.pop_front();
+		send_offset_ = 0;
+		if (--send_stamps_.front().first == 0){
+			send_stamps_.pop_front();
+		}
+		n_replies++;
+	}
+	if (send_queue_.empty()){
+		// drained, the queues gave their chunks back already
+		send_iov_.reset();
+	}
+	return n_replies;
+}
+
+bool	Client::hasPendingOutput() const{
+	return !send_queue_.empty();
+}
+
+/**
+ * @brief When the line behind the oldest unsent reply was read, 0 when unknown.
+ */
+uint64_t	Client::getQueuedSince() const{
+	return send_stamps_.empty() ? 0 : send_stamps_.front().second;
+}
+
+size_t	Client::getSendQueueBytes() const{
+	return send_queue_bytes_;
+}
+
+/**
+ * @brief The bytes of the queue not written yet, in one string(hot restart).
+ */
+std::string	Client::getPendingOutput() const{
+	std::string	output;
+	output.reserve(send_queue_bytes_);
+	for (size_t i = 0; i < send_queue_.size(); i++){
+		output.append(*send_queue_[i], i == 0 ? send_offset_ : 0, std::string::npos);
+	}
+	return output;
+}
+
+bool	Client::isWriteArmed() const{
+	return write_armed_;
+}
+
+void	Client::setWriteArmed(bool armed){
+	write_armed_ = armed;
+}
+
+void	Client::markDisconnected(){
+	isDisconnected_ = true;
+}
+
+bool	Client::isDisconnected() const{
+	return isDisconnected_;
+}
+
+void	Client::markInputClosed(){
+	input_closed_ = true;
+}
+
+bool	Client::isInputClosed() const{
+	return input_closed_;
+}
+
+bool	Client::isReadyListed() const{
+	return ready_listed_;
+}
+
+void	Client::setReadyListed(bool listed){
+	ready_listed_ = listed;
+}
+
+int	Client::getCommandCredit() const{
+	return command_credit_;
+}
+
+void	Client::setCommandCredit(int credit){
+	command_credit_ = credit;
+}
+
+/**
+ * @brief Point the client's msghdr at the first CLIENT_SEND_IOV queued replies
+ * (the front one from send_offset_), so one sendmsg writes them all. With
+ * io_uring the queue must not lose these entries before the sendmsg completes:
+ * consumeSent() only drops what was written, and the queue holds a reference
+ * to every message.
+ *
+ * @return the msghdr to submit, nullptr when there is nothing to send
+ */
+struct msghdr*	Client::prepareSendMsg(){
+	size_t	n_iov = std::min<size_t>(send_queue_.size(), CLIENT_SEND_IOV);
+	if (n_iov == 0){
+		return nullptr;
+	}
+	if (send_iov_.size() < n_iov * sizeof(struct iovec)){
+		send_iov_ = PoolBuffer(n_iov * sizeof(struct iovec));
+	}
+	struct iovec*	iov = reinterpret_cast<struct iovec*>(send_iov_.data());
+	for (size_t i = 0; i < n_iov; i++){
+		size_t	offset = i == 0 ? send_offset_ : 0;
+		iov[i].iov_base = const_cast<char*>(send_queue_[i]->data() + offset);
+		iov[i].iov_len = send_queue_[i]->size() - offset;
+	}
+	std::memset(&send_msg_, 0, sizeof(send_msg_));
+	send_msg_.msg_iov = iov;
+	send_msg_.msg_iovlen = n_iov;
+	return &send_msg_;
+}
+
+bool	Client::isSendInflight() const{
+	return send_inflight_;
+}
+
+void	Client::setSendInflight(bool inflight){
+	send_inflight_ = inflight;
+}
+
+bool	Client::isRecvArmed() const{
+	return recv_armed_;
+}
+
+void	Client::setRecvArmed(bool armed){
+	recv_armed_ = armed;
+}
+
+int	Client::getIoPending() const{
+	return io_pending_;
+}
+
+void	Client::increaseIoPending(){
+	io_pending_++;
+}
+
+void	Client::decreaseIoPending(){
+	io_pending_--;
+}
+
+bool	Client::isZerocopy() const{
+	return zerocopy_;
+}
+
+void	Client::setZerocopy(bool enabled){
+	zerocopy_ = enabled;
+}
+
+/**
+ * @brief A MSG_ZEROCOPY sendmsg() took n_bytes from the front of the queue. Call
+ * before consumeSent(): the messages they come from are referenced until
+ * releaseZerocopy() gets this send's id. The kernel numbers the successful
+ * MSG_ZEROCOPY sends of a socket 0, 1, 2...
+ */
+void	Client::holdForZerocopy(size_t n_bytes){
+	ZerocopySend	send;
+	send.id = zerocopy_next_id_++;
+	size_t	offset = send_offset_;
+	for (size_t i = 0; i < send_queue_.size() && n_bytes > 0; i++){
+		send.messages.push_back(send_queue_[i]);
+		size_t	used = std::min(n_bytes, send_queue_[i]->size() - offset);
+		n_bytes -= used;
+		offset = 0;
+	}
+	zerocopy_pending_.push_back(std::move(send));
+}
+
+/**
+ * @brief The kernel completed the sends first_id..last_id(a completion can cover
+ * a range, the ids wrap around), drop their references.
+ *
+ * @return the number of sends released
+ */
+size_t	Client::releaseZerocopy(uint32_t first_id, uint32_t last_id){
+	size_t	n_released = 0;
+	uint32_t	span = last_id - first_id;
+	for (auto it = zerocopy_pending_.begin(); it != zerocopy_pending_.end();){
+		if (it->id - first_id <= span){
+			it = zerocopy_pending_.erase(it);
+			n_released++;
+		} else {
+			++it;
+		}
+	}
+	if (zerocopy_pending_.empty()){
+		std::vector<ZerocopySend>().swap(zerocopy_pending_);
+	}
+	return n_released;
+}
+
+bool	Client::hasZerocopyPending() const{
+	return !zerocopy_pending_.empty();
+}
+
+/**
+ * @brief Memory held by the buffers of the connection, beside the Client
+ * itself. 0 for an idle client: every buffer is given back once it drains.
+ */
+size_t	Client::getBufferBytes() const{
+	return raw_data_.getBufferBytes() + send_queue_.getBufferBytes()
+		+ send_stamps_.getBufferBytes() + send_iov_.size()
+		+ zerocopy_pending_.capacity() * sizeof(ZerocopySend);
+}
+
 #if 0
 // for testing only
 void	Client::printInfo() const{
@@ -203,6 +564,6 @@ void	Client::printInfo() const{
 }
 
 void    Client::printRawData() const{
-    std::cout << "rawdata:" << raw_data_ << std::endl;
+    std::cout << "rawdata:" << raw_data_.contents() << std::endl;
 }
 #endif
@@ -0,0 +1,117 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CommandArgs.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/31 10:17:05 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/31 10:17:05 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CommandArgs.hpp"
+#include <stdexcept>
+#include <string>
+
+CommaList::iterator::iterator(std::string_view rest) : item_(), rest_(rest){
+	skip();
+}
+
+/**
+ * @brief Move item_ to the next non-empty item of rest_, or leave both empty at
+ * the end.
+ */
+void	CommaList::iterator::skip(){
+	item_ = std::string_view();
+	while (item_.empty() && !rest_.empty()){
+		size_t	comma = rest_.find(',');
+		item_ = rest_.substr(0, comma);
+		rest_.remove_prefix(comma == std::string_view::npos ? rest_.size() : comma + 1);
+	}
+	// a trailing empty piece still points into the word, end() doesn't
+	if (item_.empty()){
+		item_ = std::string_view();
+	}
+}
+
+std::string_view	CommaList::iterator::operator*() const{
+	return item_;
+}
+
+CommaList::iterator&	CommaList::iterator::operator++(){
+	skip();
+	return *this;
+}
+
+bool	CommaList::iterator::operator!=(const iterator& other) const{
+	return item_.data() != other.item_.data() || item_.size() != other.item_.size();
+}
+
+CommaList::CommaList() : word_(), size_(0){
+}
+
+CommaList::CommaList(std::string_view word) : word_(word), size_(0){
+	for (auto it = begin(); it != end(); ++it){
+		size_++;
+	}
+}
+
+CommaList::iterator	CommaList::begin() const{
+	return iterator(word_);
+}
+
+CommaList::iterator	CommaList::end() const{
+	return iterator(std::string_view());
+}
+
+size_t	CommaList::size() const{
+	return size_;
+}
+
+bool	CommaList::empty() const{
+	return size_ == 0;
+}
+
+std::string_view	CommaList::at(size_t i) const{
+	if (i >= size_){
+		throw std::out_of_range("CommaList::at: " + std::to_string(i) + " >= "
+			+ std::to_string(size_));
+	}
+	auto	it = begin();
+	for (; i > 0; i--){
+		++it;
+	}
+	return *it;
+}
+
+std::string_view	CommaList::word() const{
+	return word_;
+}
+
+WordRange::WordRange() : first_(nullptr), last_(nullptr){
+}
+
+WordRange::WordRange(const std::string_view* first, const std::string_view* last) :
+	first_(first), last_(last){
+}
+
+const std::string_view*	WordRange::begin() const{
+	return first_;
+}
+
+const std::string_view*	WordRange::end() const{
+	return last_;
+}
+
+size_t	WordRange::size() const{
+	return last_ - first_;
+}
+
+bool	WordRange::empty() const{
+	return first_ == last_;
+}
+
+std::string_view	WordRange::operator[](size_t i) const{
+	return first_[i];
+}
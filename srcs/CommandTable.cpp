@@ -0,0 +1,126 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   CommandTable.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/30 14:02:51 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/30 14:02:51 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "CommandTable.hpp"
+#include "CommandArgs.hpp"
+#include <algorithm> // for std::count
+
+/**
+ * @brief Parse the arguments of msg with the grammar of Args and run the
+ * handler with them. Missing required arguments are answered with
+ * ERR_NEEDMOREPARAMS and the handler isn't called.
+ */
+template <typename Args, void (Server::*Handler)(const Args&, Client&)>
+void	Server::runCommand(Message& msg, Client& cli){
+	Args	args;
+
+	if (!Args::Grammar::parse(msg, args)){
+		responseToClient(cli, needMoreParams(std::string(msg.getCommandString())));
+		Logger::log(Logger::WARNING, "Need more parameters");
+		return;
+	}
+	(this->*Handler)(args, cli);
+}
+
+/**
+ * One entry per COMMANDTYPE, in that order. Being a channel operator is not a
+ * flag: KICK, INVITE and MODE need it only for some channels or modes, so their
+ * handlers check it for the channel they act on.
+ */
+constexpr CommandDescriptor	CommandTable::commands_[INVALID] = {
+	{"PASS", PASS, &Server::runCommand<PassArgs, &Server::passCommand>,
+		COMMAND_BEFORE_PASS | COMMAND_BEFORE_REGISTRATION},
+	{"NICK", NICK, &Server::runCommand<NickArgs, &Server::nickCommand>,
+		COMMAND_BEFORE_REGISTRATION},
+	{"USER", USER, &Server::runCommand<UserArgs, &Server::userCommand>,
+		COMMAND_BEFORE_REGISTRATION},
+	{"PRIVMSG", PRIVMSG, &Server::runCommand<PrivmsgArgs, &Server::privmsgCommand>,
+		COMMAND_COST_PER_TARGET, 1},
+	// the JOIN broadcast, the topic and the NAMES list, per channel
+	{"JOIN", JOIN, &Server::runCommand<JoinArgs, &Server::joinCommand>,
+		COMMAND_COST_PER_TARGET, 4},
+	{"PART", PART, &Server::runCommand<PartArgs, &Server::partCommand>, 0},
+	{"KICK", KICK, &Server::runCommand<KickArgs, &Server::kickUser>, 0},
+	{"INVITE", INVITE, &Server::runCommand<InviteArgs, &Server::inviteUser>, 0},
+	{"TOPIC", TOPIC, &Server::runCommand<TopicArgs, &Server::topic>, 0},
+	{"MODE", MODE, &Server::runCommand<ModeArgs, &Server::mode>, 0},
+	{"QUIT", QUIT, &Server::runCommand<QuitArgs, &Server::quitCommand>,
+		COMMAND_BEFORE_REGISTRATION},
+	{"CAP", CAP, &Server::runCommand<CapArgs, &Server::capCommand>,
+		COMMAND_BEFORE_PASS | COMMAND_BEFORE_REGISTRATION},
+	{"PING", PING, &Server::runCommand<PingArgs, &Server::pingCommand>,
+		COMMAND_BEFORE_PASS | COMMAND_BEFORE_REGISTRATION},
+	{"WHOIS", WHOIS, &Server::runCommand<WhoisArgs, &Server::whoisCommand>,
+		COMMAND_BEFORE_PASS | COMMAND_BEFORE_REGISTRATION},
+	// a reply per channel member
+	{"WHO", WHO, &Server::runCommand<WhoArgs, &Server::whoCommand>,
+		COMMAND_BEFORE_REGISTRATION, 8},
+	{"PONG", PONG, &Server::runCommand<PongArgs, &Server::pongCommand>,
+		COMMAND_BEFORE_REGISTRATION}
+};
+
+/**
+ * @brief Length, first, second and last letter, mixed so that our 16 commands
+ * land in 16 different slots.
+ */
+constexpr size_t	CommandTable::slot(std::string_view token){
+	size_t	len = token.size();
+	return (len + static_cast<unsigned char>(token[0])
+		+ static_cast<unsigned char>(token[len > 1])
+		+ 3 * static_cast<unsigned char>(token[len - 1])) % COMMAND_TABLE_SLOTS;
+}
+
+/**
+ * @brief Evaluated by the compiler: a command out of place in commands_ or two
+ * commands in one slot make it throw, which isn't a constant expression, so the
+ * build stops here.
+ */
+constexpr std::array<uint8_t, COMMAND_TABLE_SLOTS>	CommandTable::buildSlots(){
+	std::array<uint8_t, COMMAND_TABLE_SLOTS>	slots{};
+
+	for (size_t i = 0; i < INVALID; i++){
+		if (commands_[i].type != static_cast<COMMANDTYPE>(i)){
+			throw "commands_ must follow the order of COMMANDTYPE";
+		}
+		size_t	s = slot(commands_[i].name);
+		if (slots[s] != 0){
+			throw "two commands hash to the same slot, change CommandTable::slot()";
+		}
+		slots[s] = static_cast<uint8_t>(i + 1);
+	}
+	return slots;
+}
+
+constexpr std::array<uint8_t, COMMAND_TABLE_SLOTS>	CommandTable::slots_ = buildSlots();
+
+const CommandDescriptor*	CommandTable::find(std::string_view token){
+	if (token.empty()){
+		return nullptr;
+	}
+	uint8_t	index = slots_[slot(token)];
+	if (index == 0 || commands_[index - 1].name != token){
+		return nullptr;
+	}
+	return &commands_[index - 1];
+}
+
+unsigned	CommandTable::cost(const Message& msg){
+	const CommandDescriptor*	command = msg.getCommand();
+	if (command == nullptr){
+		return 1;
+	}
+	if (!(command->flags & COMMAND_COST_PER_TARGET) || msg.getParameters().empty()){
+		return command->cost;
+	}
+	std::string_view	targets = msg.getParameters()[0];
+	return command->cost * static_cast<unsigned>(1 + std::count(targets.begin(), targets.end(), ','));
+}
@@ -1,4 +1,7 @@
 #include "Server.hpp"
+#include "CommandArgs.hpp"
+#include "ModeParser.hpp"
+#include <charconv>
 
 // Here will implements all the related commands functions
 
@@ -6,26 +9,21 @@
 /**
  * @brief PASS is used to set a 'connection password'
  *
- * @param msg: the command full message object
+ * @param args: the password, parsed by the grammar of PASS
  * @param cli: the command operator
  *
  * Numeric repiles:
  *  ERR_NEEDMOREPARAMS(461)     ERR_ALREADYREGISTRED(462)
  */
-void	Server::passCommand(Message& msg, Client& cli){
+void	Server::passCommand(const PassArgs& args, Client& cli){
 	std::string	nick = cli.getNick().empty() ? "*" : cli.getNick();
-	if (msg.getParameters().empty()){
-		responseToClient(cli, needMoreParams("PASS"));
-		Logger::log(Logger::WARNING, "no password is provided");
-		return;
-	} else if (cli.isRegistered()){
+	// a missing password is answered by the grammar(ERR_NEEDMOREPARAMS)
+	if (cli.isRegistered()){
 		responseToClient(cli, alreadyRegistred(nick));
 		Logger::log(Logger::WARNING, "no password is provided");
 		return ;
 	}
-	// vector.at() is safer than vector.at[0] to access the element.
-	// at() will do the bounds checking
-	std::string	password = msg.getParameters().at(0);
+	std::string	password(args.password);
 	if (isPasswordMatch(password) == false){
 		Logger::log(Logger::WARNING, "Password doesn't match");
 		responseToClient(cli, passwdMismatch(nick));
@@ -57,6 +55,7 @@ void	Server::attempRegisterClient(Client& cli){
 		return;
 	}
 	cli.setRegistrationStatus(true);
+	addNick(cli);
 	responseToClient(cli, rplWelcome(nick, cli.getPrefix()));
 	responseToClient(cli,rplYourHost(nick));
 	responseToClient(cli,rplCreated(nick));
@@ -64,7 +63,8 @@ void	Server::attempRegisterClient(Client& cli){
 }
 
 /**
- * @brief Checking if the passed nick is in use
+ * @brief Checking if the passed nick is in use by another registered client.
+ * Nicknames differing only in case(RFC 1459 casemapping) are the same.
  *
  * @param nick The nickname to be checked
  *
@@ -73,12 +73,27 @@ void	Server::attempRegisterClient(Client& cli){
  * - `false`: The nickname is available
  */
 bool Server::isNickInUse(const std::string& nick, const Client* requesting_client){
-	for (auto& [fd, user] : clients_){
-		if (user->getNick() == nick && user->isRegistered() && user.get() != requesting_client){
-			return true;
-		}
+	auto	it = nicks_.find(casemapNick(nick));
+	return it != nicks_.end() && it->second.get() != requesting_client;
+}
+
+/**
+ * @brief Index a registered client under its nickname. Called on registration
+ * and, after removeNick(), when a registered client changes its nick.
+ */
+void	Server::addNick(Client& cli){
+	nicks_[casemapNick(cli.getNick())] = cli.shared_from_this();
+}
+
+/**
+ * @brief Take the client out of the nickname index, if it is the one indexed
+ * under its nick(an unregistered client can carry a nick in use).
+ */
+void	Server::removeNick(Client& cli){
+	auto	it = nicks_.find(casemapNick(cli.getNick()));
+	if (it != nicks_.end() && it->second.get() == &cli){
+		nicks_.erase(it);
 	}
-	return false;
 }
 
 /**
@@ -88,16 +103,15 @@ bool Server::isNickInUse(const std::string& nick, const Client* requesting_clien
  * special    =  %x5B-60 / %x7B-7D
  *                 ; "[", "]", "\", "`", "_", "^", "{", "|", "}"
  */
-void	Server::nickCommand(Message& msg, Client& cli){
-	std::vector<std::string>	params = msg.getParameters();
+void	Server::nickCommand(const NickArgs& args, Client& cli){
 	std::string	usr_nick = cli.getNick().empty() ? "*" : cli.getNick();
 	// 1. should contain at least one parameter
-	if (params.size() == 0){
+	if (args.nick.empty()){
 		responseToClient(cli, nonNickNameGiven(usr_nick));
 		Logger::log(Logger::WARNING, "no nickname is given");
 		return;
 	}
-	const std::string& nick = params.at(0);
+	std::string	nick(args.nick);
 	// 2. nickname length checking (between 1~9 characters)
 	if (nick.size() > 20 || nick.size() < 1){
 		responseToClient(cli, erroneusNickName(usr_nick));
@@ -111,26 +125,24 @@ void	Server::nickCommand(Message& msg, Client& cli){
 		return;
 	}
 	// 4. first letter checking, should be just letter or special character
-	if (!isalpha(static_cast<unsigned char>(nick.at(0)))
-			&& std::string(SPECIAL_CHARS_NAMES).find(nick.at(0)) == std::string::npos){
+	if (!NICK_FIRST_CHARS.contains(nick[0])){
 		responseToClient(cli, erroneusNickName(usr_nick));
 		Logger::log(Logger::WARNING, "nickname's first letter is invalid");
 		return;
 	}
 	// 5. checking invalid characters in the rest nickname
-	for (auto c : nick){
-		if (!isalnum(static_cast<unsigned char>(c))
-			&& std::string(SPECIAL_CHARS_NAMES).find(c) == std::string::npos){
-			responseToClient(cli, erroneusNickName(usr_nick));
-			Logger::log(Logger::WARNING, "nickname contains invalid characters");
-			return;
-		}
+	if (!allIn(nick, NICK_CHARS)){
+		responseToClient(cli, erroneusNickName(usr_nick));
+		Logger::log(Logger::WARNING, "nickname contains invalid characters");
+		return;
 	}
 	const std::string&	old_prefix = cli.getPrefix();
+	removeNick(cli);
 	cli.setNick(nick);
 	if (cli.isRegistered() == false){ // first time registeration
 		attempRegisterClient(cli);
 	} else{ // reset nickname
+		addNick(cli);
 		responseToClient(cli, rplResetNick(old_prefix, nick));
 		Logger::log(Logger::INFO, "Send reset nick notification to userself");
 		// notice channels users who are joined the same channel with the user
@@ -154,48 +166,32 @@ void	Server::nickCommand(Message& msg, Client& cli){
  *  The <realname> may contain space characters.
  *
  */
-void	Server::userCommand(Message& msg, Client& cli){
-	std::vector<std::string>	params = msg.getParameters();
-
-	if (params.size() < 3 || msg.getTrailing().empty()){
-		responseToClient(cli, needMoreParams("USER"));
-		Logger::log(Logger::WARNING, "Need more parameters");
+void	Server::userCommand(const UserArgs& args, Client& cli){
+	// usernames take the characters of a nickname, realnames spaces as well
+	if (!allIn(args.username, NICK_CHARS)){
+		responseToClient(cli, erroneusNickName(""));
+		Logger::log(Logger::WARNING, "username is invalid");
 		return;
 	}
-	const std::string& username = params.at(0);
-	const std::string& realname = msg.getTrailing();
-
-	for (auto c : username){
-		if (!isalnum(static_cast<unsigned char>(c))
-			&& std::string(SPECIAL_CHARS_NAMES).find(c) == std::string::npos){
-			responseToClient(cli, erroneusNickName(""));
-			Logger::log(Logger::WARNING, "username is invalid");
-			return;
-		}
-	}
-
-	for (auto c : realname){
-		if (!isalnum(static_cast<unsigned char>(c))
-			&& std::string(SPECIAL_CHARS_NAMES).find(c) == std::string::npos &&
-			c != ' '){
-			responseToClient(cli, erroneusNickName(""));
-			Logger::log(Logger::WARNING, "Realname is invalid");
-			return;
-		}
+	if (!allIn(args.realname, REALNAME_CHARS)){
+		responseToClient(cli, erroneusNickName(""));
+		Logger::log(Logger::WARNING, "Realname is invalid");
+		return;
 	}
-	cli.setUsername(username);
-	cli.setRealname(realname);
-	cli.setHostname(params.at(1));
-	cli.setServername(params.at(2));
+	cli.setUsername(std::string(args.username));
+	cli.setRealname(std::string(args.realname));
+	// the host stays the one seen on accept(address or peer credentials), a
+	// client doesn't get to choose it
+	cli.setServername(std::string(args.servername));
 	if (cli.isRegistered() == false){
 		attempRegisterClient(cli);
 	}
 }
 
-void Server::quitCommand(Message& msg, Client& cli){
+void Server::quitCommand(const QuitArgs& args, Client& cli){
 	std::string reason = "Client quit";
-	if (!msg.getParameters().empty()){
-		reason = msg.getParameters()[0];
+	if (!args.reason.empty()){
+		reason = args.reason;
 	}
 	removeClient(cli, reason);
 }
@@ -221,24 +217,17 @@ void Server::quitCommand(Message& msg, Client& cli){
  *   - ERR_NOTONCHANNEL (442) – If the user is not a member of the channel
  *   - ERR_TOOMANYTARGETS (407) – If too many channels are specified in one command
  *
- * @param msg  The parsed Message object containing the list of channels and optional message.
+ * @param args The channels to leave and the optional parting message.
  * @param cli  The client issuing the PART command.
  */
-void	Server::partCommand(Message& msg, Client& cli){
-	std::vector<std::string> channel_list = msg.getChannels();
-	std::vector<std::string> target_list = msg.getUsers();
-
-	if (channel_list.size() == 0 || (target_list.size() > 0)){
-		responseToClient(cli, needMoreParams("PART"));
-		return;
-	} else if (channel_list.size() > TARGET_LIM_IN_ONE_CMD){
+void	Server::partCommand(const PartArgs& args, Client& cli){
+	if (args.channels.size() > TARGET_LIM_IN_ONE_CMD){
 		responseToClient(cli, tooManyTargets(cli.getNick()));
 		return;
 	}
 
-	bool	is_operator;
-	for(const auto& channel_name : channel_list){
-		is_operator = false;
+	for(std::string_view name : args.channels){
+		std::string	channel_name(name);
 		std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 		if (!channel_ptr) {
 			responseToClient(cli, errNoSuchChannel(cli.getNick(), channel_name));
@@ -248,10 +237,7 @@ void	Server::partCommand(Message& msg, Client& cli){
 			responseToClient(cli, notOnChannel(cli.getNick(), channel_name));
 			continue;
 		}
-		if (channel_ptr->isChannelOperator(cli)){
-			is_operator = true;
-		}
-		std::string message = rplPart(cli.getPrefix(), channel_name, msg.getTrailing());
+		std::string message = rplPart(cli.getPrefix(), channel_name, std::string(args.message));
 		channel_ptr->notifyChannelUsers(cli, message);
 		responseToClient(cli, message);
 		channel_ptr->removeUser(cli);
@@ -291,64 +277,66 @@ void	Server::partCommand(Message& msg, Client& cli){
  *   - Sends the KICK message directly to the kicked user (target)
  *   - Removes the target user from the channel
  *
- * @param msg   The parsed Message object containing the KICK command with channel(s), target(s), and optional comment.
+ * @param args  The channel(s), target(s) and optional comment of the KICK command.
  * @param user  The client issuing the KICK command.
  */
-void	Server::kickUser(Message& msg, Client& user){
-	std::vector<std::string> channel_list = msg.getChannels();
-	std::vector<std::string> target_list = msg.getUsers();
+void	Server::kickUser(const KickArgs& args, Client& user){
+	const CommaList&	channel_list = args.channels;
+	const CommaList&	target_list = args.nicks;
 	size_t	n_channel = channel_list.size();
 	size_t 	n_target = target_list.size();
+	std::string	reason(args.reason);
 
-	if (channel_list.size() == 0 || target_list.size() == 0){
-		responseToClient(user, needMoreParams("KICK"));
-		return;
-	} else if (channel_list.size() > TARGET_LIM_IN_ONE_CMD){
+	if (channel_list.size() > TARGET_LIM_IN_ONE_CMD){
 		responseToClient(user, tooManyTargets(user.getNick()));
 		return;
 	}
 
 	if (n_channel == 1 && n_target > 0){
-		std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_list.at(0));
+		std::string	channel_name(channel_list.at(0));
+		std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 		if (!channel_ptr) {
-			responseToClient(user, errNoSuchChannel(user.getNick(), channel_list.at(0)));
+			responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
 			return ;
 		}
 		if (!channel_ptr->isChannelUser(user)){
-			responseToClient(user, notOnChannel(user.getNick(), channel_list.at(0)));
+			responseToClient(user, notOnChannel(user.getNick(), channel_name));
 			return;
 		}
 		if (!channel_ptr->isChannelOperator(user)){
-			responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_list.at(0)));
+			responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_name));
 			return ;
 		}
-		for(const auto& target_nick : target_list){
+		for(std::string_view nick : target_list){
+			std::string	target_nick(nick);
 			std::shared_ptr<Client> target_ptr = getUserByNick(target_nick);
 			if (!target_ptr) {
 				responseToClient(user, errNoSuchNick(user.getNick(), target_nick));
 				continue ;
 			}
-			if (!channel_ptr->isChannelUser(*getUserByNick(target_nick))){
-				responseToClient(user, userNotInChannel(user.getNick(), target_nick, channel_list.at(0)));
+			if (!channel_ptr->isChannelUser(*target_ptr)){
+				responseToClient(user, userNotInChannel(user.getNick(), target_nick, channel_name));
 				continue;
 			}
-			if (target_nick == user.getNick()){
+			if (target_ptr.get() == &user){
 				responseToClient(user, noticeToUser(user.getNick(), "You cannot kick yourself from a channel."));
 				continue;
 			}
 
-			std::string message = rplKick(user.getNick(), target_nick, channel_list.at(0), msg.getTrailing());
-    		channel_ptr->notifyChannelUsers(*getUserByNick(target_nick), message);
-    		responseToClient(*getUserByNick(target_nick), message);
+			std::string message = rplKick(user.getNick(), target_nick, channel_name, reason);
+    		channel_ptr->notifyChannelUsers(*target_ptr, message);
+    		responseToClient(*target_ptr, message);
 
-    		Logger::log(Logger::INFO, "User " + target_nick + " was kicked from channel " + channel_list.at(0) + " by " + user.getNick());
-    		channel_ptr->removeUser(*getUserByNick(target_nick));
+    		Logger::log(Logger::INFO, "User " + target_nick + " was kicked from channel " + channel_name + " by " + user.getNick());
+    		channel_ptr->removeUser(*target_ptr);
 		}
 	} else if (n_target == 1 && n_channel > 0){
-		for(const auto& channel_name : channel_list){
+		std::string	target_nick(target_list.at(0));
+		for(std::string_view name : channel_list){
+			std::string	channel_name(name);
 			std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 			if (!channel_ptr) {
-				responseToClient(user, errNoSuchChannel(user.getNick(), channel_list.at(0)));
+				responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
 				continue ;
 			}
 			if (!channel_ptr->isChannelUser(user)){
@@ -359,35 +347,37 @@ void	Server::kickUser(Message& msg, Client& user){
 				responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_name));
 				continue;
 			}
-			std::shared_ptr<Client> target_ptr = getUserByNick(target_list.at(0));
+			std::shared_ptr<Client> target_ptr = getUserByNick(target_nick);
 			if (!target_ptr) {
-				responseToClient(user, errNoSuchNick(user.getNick(), target_list.at(0)));
+				responseToClient(user, errNoSuchNick(user.getNick(), target_nick));
 				continue ;
 			}
-			if (!channel_ptr->isChannelUser(*getUserByNick(target_list.at(0)))){
-				responseToClient(user, userNotInChannel(user.getNick(), target_list.at(0), channel_name));
+			if (!channel_ptr->isChannelUser(*target_ptr)){
+				responseToClient(user, userNotInChannel(user.getNick(), target_nick, channel_name));
 				continue;
 			}
-			if (target_list.at(0) == user.getNick()){
+			if (target_ptr.get() == &user){
 				responseToClient(user, canNotSendToChan(user.getNick(), "You cannot kick yourself from a channel."));
 				continue;
 			}
 
-			std::string message = rplKick(user.getNick(), target_list.at(0), channel_name, msg.getTrailing());
-			channel_ptr->notifyChannelUsers(*getUserByNick(target_list.at(0)), message);
-			responseToClient(*getUserByNick(target_list.at(0)), message);
+			std::string message = rplKick(user.getNick(), target_nick, channel_name, reason);
+			channel_ptr->notifyChannelUsers(*target_ptr, message);
+			responseToClient(*target_ptr, message);
 
-			Logger::log(Logger::INFO, "User " + target_list.at(0) + " was kicked from channel " + channel_name + " by " + user.getNick());
-    		channel_ptr->removeUser(*getUserByNick(target_list.at(0)));
+			Logger::log(Logger::INFO, "User " + target_nick + " was kicked from channel " + channel_name + " by " + user.getNick());
+    		channel_ptr->removeUser(*target_ptr);
 		}
 	} else if (n_channel == n_target) {
-		for (size_t i = 0; i < n_channel; ++i) {
-			const std::string& channel_name = channel_list[i];
-			const std::string& target_nick = target_list[i];
+		CommaList::iterator	target_it = target_list.begin();
+		for (std::string_view name : channel_list) {
+			std::string	channel_name(name);
+			std::string	target_nick(*target_it);
+			++target_it;
 			std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 
 			if (!channel_ptr) {
-				responseToClient(user, errNoSuchChannel(user.getNick(), channel_list.at(0)));
+				responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
 				return ;
 			}
 			if (!channel_ptr->isChannelUser(user)) {
@@ -400,19 +390,19 @@ void	Server::kickUser(Message& msg, Client& user){
 			}
 			std::shared_ptr<Client> target_ptr = getUserByNick(target_nick);
 			if (!target_ptr){
-				responseToClient(user, errNoSuchNick(user.getNick(), target_list.at(0)));
+				responseToClient(user, errNoSuchNick(user.getNick(), target_nick));
 				continue;
 			}
 			if (!channel_ptr->isChannelUser(*target_ptr)) {
 				responseToClient(user, userNotInChannel(user.getNick(), target_nick, channel_name));
 				continue;
 			}
-			if (target_nick == user.getNick()){
+			if (target_ptr.get() == &user){
 				responseToClient(user, canNotSendToChan(user.getNick(), "You cannot kick yourself from a channel."));
 				continue;
 			}
 
-			std::string message = rplKick(user.getNick(), target_nick, channel_name, msg.getTrailing());
+			std::string message = rplKick(user.getNick(), target_nick, channel_name, reason);
 			channel_ptr->notifyChannelUsers(*target_ptr, message);
 			responseToClient(*target_ptr, message);
 
@@ -447,57 +437,58 @@ void	Server::kickUser(Message& msg, Client& user){
  *   - Sends the INVITE command message to the invited user
  *   - Marks the target user as invited in the channel's state
  *
- * @param msg   The parsed Message object containing the INVITE command with channel(s) and target(s).
+ * @param args  The target(s) and channel(s) of the INVITE command.
  * @param user  The client issuing the INVITE command.
  */
-void    Server::inviteUser(Message& msg, Client& user){
-	std::vector<std::string> channel_list = msg.getChannels();
-	std::vector<std::string> target_list = msg.getUsers();
+void    Server::inviteUser(const InviteArgs& args, Client& user){
+	const CommaList&	channel_list = args.channels;
+	const CommaList&	target_list = args.nicks;
 	size_t	n_channel = channel_list.size();
 	size_t 	n_target = target_list.size();
 
-	if (channel_list.size() == 0 || target_list.size() == 0){
-		responseToClient(user, needMoreParams("INVITE"));
-		return;
-	} else if (channel_list.size() > TARGET_LIM_IN_ONE_CMD){
+	if (channel_list.size() > TARGET_LIM_IN_ONE_CMD){
 		responseToClient(user, tooManyTargets(user.getNick()));
 		return;
 	}
 
 	if (n_channel == 1 && n_target > 0){
-		std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_list.at(0));
+		std::string	channel_name(channel_list.at(0));
+		std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 		if (!channel_ptr) {
-			responseToClient(user, errNoSuchChannel(user.getNick(), channel_list.at(0)));
+			responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
 			return ;
 		}
 		if (!channel_ptr->isChannelUser(user)){
-			responseToClient(user, notOnChannel(user.getNick(), channel_list.at(0)));
+			responseToClient(user, notOnChannel(user.getNick(), channel_name));
 			return;
 		}
 		if (channel_ptr->getInviteMode() && !channel_ptr->isChannelOperator(user)){
-			responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_list.at(0)));
+			responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_name));
 			return ;
 		}
-		for(const auto& target_nick : target_list){
+		for(std::string_view nick : target_list){
+			std::string	target_nick(nick);
 			std::shared_ptr<Client> target_ptr = getUserByNick(target_nick);
 			if (!target_ptr) {
 				responseToClient(user, errNoSuchNick(user.getNick(), target_nick));
 				continue ;
 			}
-			if (channel_ptr->isChannelUser(*getUserByNick(target_nick))){
-				responseToClient(user, userOnChannel(user.getNick(), target_nick, channel_list.at(0)));
+			if (channel_ptr->isChannelUser(*target_ptr)){
+				responseToClient(user, userOnChannel(user.getNick(), target_nick, channel_name));
 				continue;
 			}
-			channel_ptr->insertUser(getUserByNick(target_nick), USERTYPE::INVITE);
-			responseToClient(user, Inviting(user.getNick(), channel_list.at(0), target_nick));
-			std::string inviteMessage = ":" + user.getNick() + " INVITE " + target_nick + " " + channel_list.at(0) + "\r\n";
-    		responseToClient(*getUserByNick(target_nick), inviteMessage);
+			channel_ptr->insertUser(target_ptr, USERTYPE::INVITE);
+			responseToClient(user, Inviting(user.getNick(), channel_name, target_nick));
+			std::string inviteMessage = ":" + user.getNick() + " INVITE " + target_nick + " " + channel_name + "\r\n";
+    		responseToClient(*target_ptr, inviteMessage);
 		}
 	}  else if (n_target == 1 && n_channel > 0){
-		for(const auto& channel_name : channel_list){
+		std::string	target_nick(target_list.at(0));
+		for(std::string_view name : channel_list){
+			std::string	channel_name(name);
 			std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 			if (!channel_ptr) {
-				responseToClient(user, errNoSuchChannel(user.getNick(), channel_list.at(0)));
+				responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
 				continue ;
 			}
 			if (!channel_ptr->isChannelUser(user)){
@@ -508,15 +499,15 @@ void    Server::inviteUser(Message& msg, Client& user){
 				responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_name));
 				continue;
 			}
-			std::shared_ptr<Client> target_ptr = getUserByNick(target_list.at(0));
+			std::shared_ptr<Client> target_ptr = getUserByNick(target_nick);
 			if (!target_ptr) {
-				responseToClient(user, errNoSuchNick(user.getNick(), target_list.at(0)));
+				responseToClient(user, errNoSuchNick(user.getNick(), target_nick));
 				return ;
 			}
 			channel_ptr->insertUser(target_ptr, USERTYPE::INVITE);
 			responseToClient(user, Inviting(user.getNick(), channel_name, target_ptr->getNick()));
 			std::string inviteMessage = ":" + user.getNick() + " INVITE " + target_ptr->getNick() + " " + channel_name + "\r\n";
-    		responseToClient(*getUserByNick(target_ptr->getNick()), inviteMessage);
+    		responseToClient(*target_ptr, inviteMessage);
 		}
 	} else {
 		responseToClient(user,InviteSyntaxErr(user.getNick()));
@@ -545,62 +536,52 @@ void    Server::inviteUser(Message& msg, Client& user){
  *   - Notifies all users in the channel of the topic change.
  *   - Responds to the user with the updated topic message.
  *
- * @param msg   The parsed Message object containing the TOPIC command and parameters.
+ * @param args  The channel and, if given, the new topic.
  * @param user  The client issuing the TOPIC command.
  */
-void	Server::topic(Message& msg, Client& user){
-	std::vector<std::string> channel_list = msg.getChannels();
-	std::vector<std::string> target_list = msg.getUsers();
-	size_t	n_channel = channel_list.size();
-
-	if (channel_list.size() == 0 || target_list.size() != 0){
-		responseToClient(user, needMoreParams("TOPIC"));
-		return;
-	}
-	if (n_channel > 1){
-		responseToClient(user,InviteSyntaxErr(user.getNick()));
-		return ;
-	}
+void	Server::topic(const TopicArgs& args, Client& user){
+	std::string	channel_name(args.channel);
 
-	std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_list.at(0));
+	std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 	if (!channel_ptr) {
-		responseToClient(user, errNoSuchChannel(user.getNick(), channel_list.at(0)));
+		responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
 		return ;
 	}
     if (!channel_ptr->isChannelUser(user)){
-        Server::responseToClient(user, notOnChannel(user.getNick(), channel_list.at(0)));
+        Server::responseToClient(user, notOnChannel(user.getNick(), channel_name));
         return ;
     }
 
 	// No trailing parameter present AND there was no explicit ':' → just display topic (or no topic)
-	if (msg.getTrailing().empty() && msg.getTrailingEmpty() == false){
+	if (!args.topic){
 		if (channel_ptr->getTopic().empty())
-			responseToClient(user, NoTopic(user.getNick(), channel_list.at(0)));
+			responseToClient(user, NoTopic(user.getNick(), channel_name));
 		else
-			responseToClient(user, Topic(user.getNick(), channel_list.at(0), channel_ptr->getTopic()));
+			responseToClient(user, Topic(user.getNick(), channel_name, channel_ptr->getTopic()));
 		return ;
 	}
 	if (channel_ptr->getTopicMode() && !channel_ptr->isChannelOperator(user)){
-		responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_list.at(0)));
+		responseToClient(user, ChanoPrivsNeeded(user.getNick(), channel_name));
 		return ;
 	}
 
-    if (msg.getTrailingEmpty() == true) {
+    if (args.topic->empty()) {
 		channel_ptr->addNewTopic("");
-    	Logger::log(Logger::INFO, "User " + user.getNick() + " cleared topic in channel " + channel_list.at(0));
+    	Logger::log(Logger::INFO, "User " + user.getNick() + " cleared topic in channel " + channel_name);
 
-   		std::string message = Topic(user.getNick(), channel_list.at(0), "");
+   		std::string message = Topic(user.getNick(), channel_name, "");
     	channel_ptr->notifyChannelUsers(user, message);
     	responseToClient(user, message);
         return;
     }
 
-	channel_ptr->addNewTopic(msg.getTrailing());
-	std::string message = Topic(user.getNick(), channel_list.at(0), msg.getTrailing());
+	std::string	new_topic(*args.topic);
+	channel_ptr->addNewTopic(new_topic);
+	std::string message = Topic(user.getNick(), channel_name, new_topic);
 	channel_ptr->notifyChannelUsers(user, message);
 	responseToClient(user, message);
 
-    Logger::log(Logger::INFO, "User " + user.getNick() + " set new topic in channel " + channel_list.at(0) + ": " + msg.getTrailing());
+    Logger::log(Logger::INFO, "User " + user.getNick() + " set new topic in channel " + channel_name + ": " + new_topic);
 }
 
 /**
@@ -631,50 +612,61 @@ void	Server::topic(Message& msg, Client& user){
  *   - Notifies all users in the channel of the mode changes.
  *   - Returns error replies for invalid flags, missing parameters, or permission issues.
  *
- * @param msg   The parsed Message object containing the MODE command and parameters.
+ * @param args  The target, mode flags and mode arguments of the MODE command.
  * @param user  The client issuing the MODE command.
  */
 // MODE #ch +i al
 //  MODE alic +i
 //  MODE +i
 //  MODE #a
-void	Server::mode(Message& msg, Client& user){
+void	Server::mode(const ModeArgs& args, Client& user){
 
-	std::vector<std::string> params_list = msg.getParameters();
-	std::vector<std::string> target_list = msg.getUsers();
-	std::vector<std::string> channel_list = msg.getChannels();
-
-	if (!target_list.empty() && params_list.at(0) == target_list.at(0)){
-		if (user.getNick() != target_list.at(0)){
+	// a target that isn't a channel is a nick: user modes
+	if (args.target[0] != '#'){
+		if (user.getNick() != args.target){
 			responseToClient(user, usersDontMatch(user.getNick())); // ERR_USERSDONTMATCH
 			return;
 		}
-		if (params_list.size() == 1){
+		if (args.modes.empty()){
 			responseToClient(user, rplUserModeIs(user.getNick(), user.getUserMode()));
 			return ;
 		}
-		const std::string mode = params_list.at(1);
-		// Validate: must start with + or - followed by valid mode chars
-		std::regex mode_regex("^([+-][iworO]*)+$");
-		if (!std::regex_match(mode, mode_regex)){
+		// Validate: must start with + or - followed by valid mode chars, all
+		// of them before anything is applied
+		ModeChange	change;
+		MODESTATUS	status;
+		ModeParser	check(USER_MODES, args.modes, WordRange());
+		while ((status = check.next(change)) == MODE_CHANGE){
+		}
+		if ((args.modes[0] != '+' && args.modes[0] != '-') || status != MODE_END){
 			responseToClient(user, umodeUnknownFlag(user.getNick())); // ERR_UMODEUNKNOWNFLAG
 			return;
 		}
+		// the modes we have, then the changes on top, in the table's order
+		bool		set[256] = {};
+		ModeParser	current(USER_MODES, user.getUserMode(), WordRange());
+		while (current.next(change) == MODE_CHANGE){
+			set[static_cast<unsigned char>(change.mode)] = change.adding;
+		}
+		ModeParser	request(USER_MODES, args.modes, WordRange());
+		while (request.next(change) == MODE_CHANGE){
+			set[static_cast<unsigned char>(change.mode)] = change.adding;
+		}
+		std::string	mode;
+		for (int c = 0; c < 256; c++){
+			if (set[c]){
+				mode += static_cast<char>(c);
+			}
+		}
+		if (!mode.empty()){
+			mode.insert(mode.begin(), '+');
+		}
 		user.setUserMode(mode);
 		responseToClient(user, rplUserModeIs(user.getNick(), mode)); // RPL_UMODEIS
 		return;
 	}
 
-	if (channel_list.empty()){
-		responseToClient(user, needMoreParams("MODE"));
-		return;
-	}
-	if (channel_list.size() > 1){
-		responseToClient(user, tooManyTargets(user.getNick()));
-		return;
-	}
-
-	std::string	channel_name = channel_list.at(0);//params_list.at(0);
+	std::string	channel_name(args.target);
 	std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
 	if (!channel_ptr){
         responseToClient(user, errNoSuchChannel(user.getNick(), channel_name));
@@ -685,20 +677,12 @@ void	Server::mode(Message& msg, Client& user){
         return;
     }
 
-	std::string	mode_flags = "";
-	if (params_list.size() > 1)
-		mode_flags = params_list.at(1);
-
-	std::vector<std::string> args;
-	if (params_list.size() > 2)
-    	args.assign(params_list.begin() + 2, params_list.end());
-
 	// response to ban list
-	if (mode_flags == "b"){
+	if (args.modes == "b"){
 		responseToClient(user, rplEndOfBanList(user.getNick(), channel_name));
         return;
 	}
-	if (mode_flags.empty()){ // display only active modes
+	if (args.modes.empty()){ // display only active modes
         std::string status = "";
         if (channel_ptr->getInviteMode()) status += "i";
         if (channel_ptr->getTopicMode()) status += "t";
@@ -716,69 +700,76 @@ void	Server::mode(Message& msg, Client& user){
         return;
     }
 
-	bool adding = true;
-	size_t arg_index = 0;
-	std::string update_modes;
-
-	for (size_t i = 0; i < mode_flags.size(); ++i){
-		char c = mode_flags[i];
+	// one pass over the flags, each change is applied as it comes and kept for
+	// the MODE line only if it changed something
+	ModeParser	parser(CHANNEL_MODES, args.modes, args.args);
+	ModeChange	change;
+	ModeDelta	applied;
+	MODESTATUS	status;
 
-		if (c == '+'){
-			adding = true;
+	while ((status = parser.next(change)) != MODE_END){
+		if (status == MODE_UNKNOWN){
+			responseToClient(user, unknownMode(user.getNick(), std::string(1, change.mode), channel_name));
+			continue ;
 		}
-		else if (c == '-'){
-			adding = false;
+		if (status == MODE_MISSING_ARG){
+			responseToClient(user, needMoreParams("MODE"));
+			break;
 		}
-		else if (c == 'i'){
-			adding ? channel_ptr->setInviteOnly() : channel_ptr->unsetInviteOnly();
-			update_modes += (adding ? "+i" : "-i");
+		if (change.mode == 'i'){
+			if (change.adding == channel_ptr->getInviteMode()){
+				continue;
+			}
+			change.adding ? channel_ptr->setInviteOnly() : channel_ptr->unsetInviteOnly();
 		}
-		else if (c == 't'){
-			adding ? channel_ptr->setTopicRestrictions() : channel_ptr->unsetTopicRestrictions();
-			update_modes += (adding ? "+t" : "-t");
+		else if (change.mode == 't'){
+			if (change.adding == channel_ptr->getTopicMode()){
+				continue;
+			}
+			change.adding ? channel_ptr->setTopicRestrictions() : channel_ptr->unsetTopicRestrictions();
 		}
-		else if (c == 'k'){
-			if (adding){
-				if (arg_index >= args.size()){
-					responseToClient(user, needMoreParams("MODE"));
-					return;
-				}
-				if (!isValidModePassword(args[arg_index])){
-					responseToClient(user, InvalidModeParamErr(user.getNick(), channel_name, 'k', args[arg_index++], "Invalid channel key"));
+		else if (change.mode == 'k'){
+			if (change.adding){
+				if (!isValidModePassword(change.arg)){
+					responseToClient(user, InvalidModeParamErr(user.getNick(), channel_name, 'k', std::string(change.arg), "Invalid channel key"));
 					continue ;
 				}
-				channel_ptr->addNewPassword(args[arg_index++]);
+				std::string	key(change.arg);
+				if (channel_ptr->getPasswdMode() && channel_ptr->getPassword() == key){
+					continue;
+				}
+				channel_ptr->addNewPassword(key);
 				channel_ptr->setPassword();
-				update_modes += "+k";
 			} else{
+				if (!channel_ptr->getPasswdMode()){
+					continue;
+				}
 				channel_ptr->unsetPassword();
-				update_modes += "-k";
 			}
 		}
-		else if (c == 'l'){
-			if (adding){
-				if (arg_index >= args.size()){
-					responseToClient(user, needMoreParams("MODE"));
-					return;
-				}
-				if (!isPositiveInteger(args[arg_index])){
-    				responseToClient(user, InvalidModeParamErr(user.getNick(), channel_name, 'l', args[arg_index++], "Limit must be a positive integer"));
+		else if (change.mode == 'l'){
+			if (change.adding){
+				int	limit = 0;
+				std::from_chars_result	res = std::from_chars(change.arg.data(),
+					change.arg.data() + change.arg.size(), limit);
+				if (!isPositiveInteger(change.arg) || res.ec != std::errc()){
+    				responseToClient(user, InvalidModeParamErr(user.getNick(), channel_name, 'l', std::string(change.arg), "Limit must be a positive integer"));
             		continue;
         		}
-				channel_ptr->addLimit(std::stoi(args[arg_index++]));
+				if (channel_ptr->getLimitMode() && channel_ptr->getUserLimit() == static_cast<size_t>(limit)){
+					continue;
+				}
+				channel_ptr->addLimit(limit);
 				channel_ptr->setLimit();
-				update_modes += "+l";
 			} else {
+				if (!channel_ptr->getLimitMode()){
+					continue;
+				}
 				channel_ptr->unsetLimit();
-				update_modes += "-l";
 			}
 		}
-		else if (c == 'o'){
-			if (arg_index >= args.size()){
-				responseToClient(user, needMoreParams("MODE"));
-				return;
-			}
-			std::string nick = args[arg_index++];
+		else if (change.mode == 'o'){
+			std::string nick(change.arg);
 			std::shared_ptr<Client> target_ptr = getUserByNick(nick);
 			if (!target_ptr){
 				responseToClient(user, errNoSuchNick(user.getNick(), nick));
@@ -788,28 +779,22 @@ void	Server::mode(Message& msg, Client& user){
 				responseToClient(user, userNotInChannel(user.getNick(), nick, channel_name));
 				continue;
 			}
-			if (adding){
+			if (change.adding == channel_ptr->isChannelOperator(*target_ptr)){
+				continue;
+			}
+			if (change.adding){
 				channel_ptr->addNewOperator(*target_ptr);
-				update_modes += "+o";
 			} else {
 				channel_ptr->removeOperator(*target_ptr);
-				update_modes += "-o";
 			}
 		}
-		else{
-			responseToClient(user, unknownMode(user.getNick(), std::string(1, c), channel_name));
-			continue ;
-		}
+		applied.add(change);
 	}
-	// Notify all users in the channel about the mode change
-	if (arg_index > args.size())
-		arg_index = args.size();
-	std::vector<std::string> params(args.begin(), args.begin() + arg_index);
-	std::string	params_str;
-	for (const std::string& arg : params){
-		params_str += " " + arg;
+	// Notify all users in the channel about the mode changes that took effect
+	if (applied.empty()){
+		return;
 	}
-	std::string message = rplMode(user.getPrefix(), channel_name, update_modes, params_str);
+	std::string message = rplMode(user.getPrefix(), channel_name, applied.getModes(), applied.getParams());
 	channel_ptr->notifyChannelUsers(user, message);
 	responseToClient(user, message);
 }
@@ -839,23 +824,25 @@ void	Server::mode(Message& msg, Client& user){
 // consistency (unless you're intentionally simplifying).
 
 // checking if channel reaches the server/user limit logic
-void	Server::joinCommand(Message& msg, Client& cli){
+void	Server::joinCommand(const JoinArgs& args, Client& cli){
 	const std::string&	nick = cli.getNick();
-	std::vector<std::string>	channels = msg.getChannels();
-	std::vector<std::string>	passwds = msg.getPasswords();
-	size_t	index = 0;
+	// the n-th key is for the n-th channel
+	CommaList::iterator	key = args.keys.begin();
+	CommaList::iterator	no_key = args.keys.end();
 
 	// checking if the arguments number is valid
-	if (channels.size() == 0){
-		responseToClient(cli, needMoreParams("JOIN"));
-		return;
-	} if (channels.size() > TARGET_LIM_IN_ONE_CMD){
+	if (args.channels.size() > TARGET_LIM_IN_ONE_CMD){
 		responseToClient(cli, tooManyTargets(nick));
 		Logger::log(Logger::ERROR, "too many target");
 		return;
 	}
-	size_t passwds_index = 0;
-	for (const auto& chan_name : channels){
+	for (std::string_view name : args.channels){
+		std::string			chan_name(name);
+		std::string_view	chan_key;
+		if (key != no_key){
+			chan_key = *key;
+			++key;
+		}
 		std::shared_ptr<Channel> channel = getChannelByName(chan_name);
 		if (channel == nullptr){
 			// Checking if server has reached its maximum channel
@@ -882,8 +869,8 @@ void	Server::joinCommand(Message& msg, Client& cli){
 			channels_[chan_name] = channel;
 			n_channel_++;
 			cli.increaseUserNchannel();
-			if (passwds_index < passwds.size()){
-				const std::string& passwd = passwds[passwds_index++];
+			if (!chan_key.empty()){
+				std::string	passwd(chan_key);
 				if (!isValidModePassword(passwd)){
 					responseToClient(cli, InvalidModeParamErr(nick, chan_name, 'k', passwd, "Invalid channel key"));
 					Logger::log(Logger::WARNING, "Invalid channel key");
@@ -917,12 +904,12 @@ void	Server::joinCommand(Message& msg, Client& cli){
 			}
 			// If the channel needs a password, but the client doesn't provide it
 			if (channel->getPasswdMode() == true){
-				if (passwds.size() == 0){
+				if (chan_key.empty()){
 					responseToClient(cli, badChannelKey(nick,chan_name));
 					Logger::log(Logger::WARNING, "No channel key is provided");
 					continue;
 				}
-				if (channel->getPassword() != passwds.at(index++)){
+				if (channel->getPassword() != chan_key){
 					responseToClient(cli, badChannelKey(nick,chan_name));
 					Logger::log(Logger::WARNING, "Channel key doesn't mattach");
 					continue;
@@ -964,26 +951,20 @@ void	Server::joinCommand(Message& msg, Client& cli){
 	}
 }
 
-bool	Server::isChannelValid(const std::string& channel_name){
-	char	first_char = channel_name[0];
-	if (std::string(SUPPORTCHANNELPREFIX).find(first_char) == std::string::npos){ // doesn't find
+bool	Server::isChannelValid(std::string_view channel_name){
+	if (channel_name.empty()
+		|| std::string_view(SUPPORTCHANNELPREFIX).find(channel_name[0]) == std::string_view::npos){
 		return false;
 	}
 	// if the channel starts with '!', the size of the channel name should be 6;
 	// channelid only contains uppercase letters and digits
-	if (first_char == '!'){
-		if (channel_name.size() != 6
-			|| channel_name.substr(1,5).find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789")){
+	if (channel_name[0] == '!'){
+		if (channel_name.size() != 6 || !allIn(channel_name.substr(1), CHANNEL_ID_CHARS)){
 			return false;
 		}
 	}
 	// channel name can't contain: NUL, BEL, \r, \n, space, comma, and :
-	for (const char& c : channel_name){
-		if (c == 0 || c == 7 || c == 13 || c == 10 || c == 32 || c == 44 || c == 58){
-			return false;
-		}
-	}
-	return true;
+	return allIn(channel_name, CHANNEL_CHARS);
 }
 
 
@@ -1000,44 +981,37 @@ bool	Server::isExistedChannel(const std::string& channel_name){
  * @brief Send a message to a user or a channel if they exist.
  * Can be used to message multiple users and/or channels at the same time
  */
-void Server::privmsgCommand(Message& msg, Client& cli){
-    std::vector<std::string> channels = msg.getChannels();
-    std::vector<std::string> users = msg.getUsers();
-	std::vector<std::string> params_list = msg.getParameters();
-	const std::string& message = msg.getTrailing();
-
-    if (channels.empty() && users.empty()){
-		responseToClient(cli, needMoreParams("PRIVMSG"));
-		Logger::log(Logger::ERROR, "No user/channel in the arguments");
-		return;
-	}
-    if (msg.getTrailingEmpty() == true /*|| message == "\r\n"*/){
+void Server::privmsgCommand(const PrivmsgArgs& args, Client& cli){
+    if (!args.text || args.text->empty()){
 		responseToClient(cli, "No text to send\r\n");
 		Logger::log(Logger::ERROR, "there is no message to be sent");
 		return;
 	}
-    //if (channels.size() + users.size() > TARGET_LIM_IN_ONE_CMD){
-	if (params_list.size() > TARGET_LIM_IN_ONE_CMD) {
+	if (args.targets.size() > TARGET_LIM_IN_ONE_CMD) {
 		responseToClient(cli, tooManyTargets(cli.getNick()));
 		Logger::log(Logger::ERROR, "too many target");
 		return;
 	}
-    for (const auto& channel_name : channels){
-        std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
-        if (!channel_ptr) {
-            responseToClient(cli, errNoSuchChannel(cli.getNick(), channel_name));
-			Logger::log(Logger::ERROR, "No such channel");
-            continue;
-        }
-        if (!channel_ptr->isChannelUser(cli)){
-            responseToClient(cli, notOnChannel(cli.getNick(), channel_name));
-			Logger::log(Logger::ERROR, "User isn't on the channel");
+	std::string_view message = *args.text;
+    for (std::string_view target : args.targets){
+        if (target[0] == '#'){
+            std::string channel_name(target);
+            std::shared_ptr<Channel> channel_ptr = getChannelByName(channel_name);
+            if (!channel_ptr) {
+                responseToClient(cli, errNoSuchChannel(cli.getNick(), channel_name));
+                Logger::log(Logger::ERROR, "No such channel");
+                continue;
+            }
+            if (!channel_ptr->isChannelUser(cli)){
+                responseToClient(cli, notOnChannel(cli.getNick(), channel_name));
+                Logger::log(Logger::ERROR, "User isn't on the channel");
+                continue;
+            }
+            channel_ptr->notifyChannelUsers(cli, rplPrivMsg(cli.getNick(), channel_name, message));
+            Logger::log(Logger::INFO, "send message to channel users");
             continue;
         }
-		channel_ptr->notifyChannelUsers(cli, rplPrivMsg(cli.getNick(), channel_name, message));
-		Logger::log(Logger::INFO, "send message to channel users");
-    }
-    for (const auto& target_nick : users){
+        std::string target_nick(target);
         std::shared_ptr<Client> target_client = getUserByNick(target_nick);
         if (!target_client){
             responseToClient(cli, errNoSuchNick(cli.getNick(), target_nick));
@@ -1065,15 +1039,14 @@ std::string Server::trim(const std::string& str){
  * This is done automatically on startup by irssi, so we only handle the responses irssi
  * expects to hear in order to set up a successful connection.
  */
-void Server::capCommand(Message& msg, Client& cli){
-	std::vector<std::string> parameters = msg.getParameters();
-	std::string subcmd = parameters.empty() ? "" : parameters[0];
+void Server::capCommand(const CapArgs& args, Client& cli){
+	std::string subcmd(args.subcommand);
 
 	if (subcmd == "LS"){
 		std::string response = "CAP * LS :multi-prefix\r\n";
 		responseToClient(cli, response);
 	} else if (subcmd == "REQ"){
-		std::string requested_caps = trim(msg.getTrailing());
+		std::string requested_caps = trim(std::string(args.capabilities));
 		if (!requested_caps.empty()){
 			std::string response = "CAP * ACK :" + requested_caps + "\r\n";
 			responseToClient(cli, response);
@@ -1087,50 +1060,50 @@ void Server::capCommand(Message& msg, Client& cli){
 	}
 }
 
-bool Server::isValidModePassword(const std::string& key){
-    if (key.empty() || key.length() > 23){
-        return false;
-    }
-    for (unsigned char ch : key){
-        // Allow if in the specified ASCII ranges
-        if ((ch >= 0x01 && ch <= 0x05) || (ch >= 0x07 && ch <= 0x08) || ch == 0x0C ||
-            (ch >= 0x0E && ch <= 0x1F) || (ch >= 0x21 && ch <= 0x7F)){
-            continue;
-        } else{
-            return false;
-        }
-    }
-    return true;
+bool Server::isValidModePassword(std::string_view key){
+    // 1-23 bytes out of 0x01-05, 0x07-08, 0x0C, 0x0E-1F, 0x21-7F
+    return !key.empty() && key.length() <= 23 && allIn(key, KEY_CHARS);
 }
 
-bool Server::isPositiveInteger(const std::string& s){
-    return !s.empty() && std::all_of(s.begin(), s.end(), ::isdigit);
+bool Server::isPositiveInteger(std::string_view s){
+    return !s.empty() && allIn(s, DIGIT_CHARS);
 }
 
 /**
  * @brief Used by irssi to make sure the connection to the server still exists.
  * Responds to PING commmand with a PONG reply
  */
-void Server::pingCommand(Message& msg, Client& cli){
-	if (msg.getParameters().empty()){
+void Server::pingCommand(const PingArgs& args, Client& cli){
+	if (args.origin.empty()){
 		responseToClient(cli, noOrigin(cli.getNick()));
 		return;
 	}
-	const std::string& origin = msg.getParameters().at(0);
-	responseToClient(cli, "PONG :" + origin + "\r\n");
+	std::string_view	origin = args.origin;
+	std::string			pong;
+	pong.reserve(origin.size() + 8);
+	pong.append("PONG :").append(origin).append("\r\n");
+	responseToClient(cli, pong);
+}
+
+/**
+ * @brief Answer to our PING(see Server::checkLiveness()). Nothing to do here:
+ * every line the client sends already marks it alive.
+ */
+void Server::pongCommand(const PongArgs& args, Client& cli){
+	(void)args;
+	(void)cli;
 }
 
 /**
  * @brief Used by irssi when multiple users try to connect with the same information.
  * Confirms whether the user information is the exact same or not
  */
-void Server::whoisCommand(Message& msg, Client& cli){
-	std::vector<std::string> params = msg.getParameters();
-	if (params.empty()){
+void Server::whoisCommand(const WhoisArgs& args, Client& cli){
+	if (args.nick.empty()){
 		responseToClient(cli, nonNickNameGiven(cli.getNick()));
 		return;
 	}
-	std::string targetNick = params[0];
+	std::string targetNick(args.nick);
 	std::shared_ptr<Client> target = getUserByNick(targetNick);
 	if (!target){
 		responseToClient(cli, errNoSuchNick(cli.getNick(), targetNick));
@@ -1153,13 +1126,8 @@ void Server::whoisCommand(Message& msg, Client& cli){
  * Here status is always "H", hopcount is "0", and voiced is ignored, since these
  * functionalities were not required to be supported in this project
  */
-void Server::whoCommand(Message& msg, Client& cli){
-    std::vector<std::string> params = msg.getParameters();
-    if (params.empty()){
-        responseToClient(cli, needMoreParams("WHO"));
-        return;
-    }
-    std::string target = params[0];
+void Server::whoCommand(const WhoArgs& args, Client& cli){
+    std::string target(args.channel);
     std::shared_ptr<Channel> channel = getChannelByName(target);
     if (!channel){
         responseToClient(cli, errNoSuchChannel(cli.getNick(), target));
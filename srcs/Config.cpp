@@ -0,0 +1,188 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Config.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/22 10:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/22 10:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Config.hpp"
+#include <arpa/inet.h> // for inet_pton
+#include <sys/un.h> // for sockaddr_un
+
+ServerConfig::ServerConfig() : n_workers(1), backend(BACKEND::EPOLL_ET), zerocopy_min(0),
+	backlog(LISTEN_BACKLOG), busy_poll_usec(0), notsent_lowat(0), registration_timeout(30),
+	ping_interval(120), pong_timeout(60), ktls(true), huge_pages(false), handoff_fd(-1){
+}
+
+/**
+ * @brief Read a strictly positive integer option value, throw on anything else.
+ */
+static int	parsePositive(const std::string& option, const std::string& value, int max){
+	if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos
+		|| value.size() > 9){
+		throw std::invalid_argument("Error: " + option + " expects a positive number");
+	}
+	int	n = std::stoi(value);
+	if (n < 1 || n > max){
+		throw std::invalid_argument("Error: " + option + " should be 1~" + std::to_string(max));
+	}
+	return n;
+}
+
+bool	ListenAddress::isUnix() const{
+	return !path.empty();
+}
+
+std::string	ListenAddress::toString() const{
+	if (isUnix()){
+		return "unix:" + path;
+	}
+	std::string	port_str = std::to_string(port);
+	if (host.find(':') != std::string::npos){
+		return "[" + host + "]:" + port_str;
+	}
+	return host + ":" + port_str;
+}
+
+/**
+ * @brief Read a --listen value: "ADDR:PORT", "[IPV6]:PORT", "*:PORT", or the
+ * same without ":PORT" for the <port> argument. ADDR is numeric, the server
+ * doesn't resolve names.
+ */
+static ListenAddress	parseListenAddress(const std::string& value, bool tls){
+	ListenAddress	addr;
+	addr.tls = tls;
+	std::string		port;
+	size_t			host_end;
+	if (!value.empty() && value[0] == '['){
+		host_end = value.find(']');
+		if (host_end == std::string::npos){
+			throw std::invalid_argument("Error: --listen: missing ']' in " + value);
+		}
+		addr.host = value.substr(1, host_end - 1);
+		host_end++;
+	} else {
+		host_end = value.find(':');
+		if (host_end != std::string::npos && value.find(':', host_end + 1) != std::string::npos){
+			throw std::invalid_argument("Error: --listen: an IPv6 address goes in brackets, "
+				"[" + value + "]");
+		}
+		addr.host = value.substr(0, host_end);
+	}
+	if (host_end < value.size()){
+		if (value[host_end] != ':'){
+			throw std::invalid_argument("Error: --listen: bad address " + value
+				+ ", an IPv6 address goes in brackets");
+		}
+		port = value.substr(host_end + 1);
+	}
+	unsigned char	buf[sizeof(struct in6_addr)];
+	int				family = addr.host.find(':') == std::string::npos ? AF_INET : AF_INET6;
+	if (addr.host != "*" && inet_pton(family, addr.host.c_str(), buf) != 1){
+		throw std::invalid_argument("Error: --listen: " + addr.host + " is not a numeric address");
+	}
+	addr.port = port.empty() ? 0 : parsePositive("--listen port", port, 65535);
+	return addr;
+}
+
+/**
+ * @brief Read a --unix-listen value, the path of the socket file. It has to fit
+ * in sockaddr_un, the kernel doesn't take longer ones.
+ */
+static ListenAddress	parseUnixPath(const std::string& value){
+	if (value.empty() || value.size() >= sizeof(sockaddr_un::sun_path)){
+		throw std::invalid_argument("Error: --unix-listen: the path should be 1~"
+			+ std::to_string(sizeof(sockaddr_un::sun_path) - 1) + " characters");
+	}
+	ListenAddress	addr;
+	addr.port = 0;
+	addr.tls = false;
+	addr.path = value;
+	return addr;
+}
+
+/**
+ * @brief Parse the options found after <port> and <password>. The whole command
+ * line is kept for a hot restart, except the internal --upgrade-fd.
+ *
+ * @param first: index in av of the first option
+ *
+ * @return the config, or throw std::invalid_argument for an unknown option or a
+ * bad value
+ */
+ServerConfig	ServerConfig::parseOptions(int ac, char** av, int first){
+	ServerConfig	config;
+
+	config.command_line.assign(av, av + first);
+	for (int i = first; i < ac; i++){
+		std::string	option = av[i];
+		if (i + 1 >= ac){
+			throw std::invalid_argument("Error: missing value for " + option);
+		}
+		std::string	value = av[++i];
+		if (option != UPGRADE_FD_OPTION){
+			config.command_line.push_back(option);
+			config.command_line.push_back(value);
+		}
+		if (option == "--workers"){
+			config.n_workers = parsePositive(option, value, MAX_WORKERS);
+		} else if (option == "--backend"){
+			if (value == "poll"){
+				config.backend = BACKEND::POLL;
+			} else if (value == "epoll"){
+				config.backend = BACKEND::EPOLL;
+			} else if (value == "epoll-et"){
+				config.backend = BACKEND::EPOLL_ET;
+			} else if (value == "uring"){
+				config.backend = BACKEND::URING;
+			} else {
+				throw std::invalid_argument("Error: --backend should be poll, epoll, epoll-et or uring");
+			}
+		} else if (option == "--backlog"){
+			config.backlog = parsePositive(option, value, MAX_BACKLOG);
+		} else if (option == "--busy-poll"){
+			config.busy_poll_usec = parsePositive(option, value, MAX_BUSY_POLL);
+		} else if (option == "--notsent-lowat"){
+			config.notsent_lowat = parsePositive(option, value, MAX_NOTSENT_LOWAT);
+		} else if (option == "--registration-timeout"){
+			config.registration_timeout = parsePositive(option, value, MAX_TIMEOUT);
+		} else if (option == "--ping-interval"){
+			config.ping_interval = parsePositive(option, value, MAX_TIMEOUT);
+		} else if (option == "--pong-timeout"){
+			config.pong_timeout = parsePositive(option, value, MAX_TIMEOUT);
+		} else if (option == "--zerocopy"){
+			config.zerocopy_min = parsePositive(option, value, MAX_ZEROCOPY_MIN);
+		} else if (option == "--listen" || option == "--tls-listen" || option == "--unix-listen"){
+			if (config.listeners.size() >= MAX_LISTENERS){
+				throw std::invalid_argument("Error: at most " + std::to_string(MAX_LISTENERS)
+					+ " listening addresses");
+			}
+			config.listeners.push_back(option == "--unix-listen" ? parseUnixPath(value)
+				: parseListenAddress(value, option == "--tls-listen"));
+		} else if (option == "--tls-cert"){
+			config.tls_cert = value;
+		} else if (option == "--tls-key"){
+			config.tls_key = value;
+		} else if (option == "--ktls"){
+			if (value != "on" && value != "off"){
+				throw std::invalid_argument("Error: --ktls should be on or off");
+			}
+			config.ktls = value == "on";
+		} else if (option == "--huge-pages"){
+			if (value != "on" && value != "off"){
+				throw std::invalid_argument("Error: --huge-pages should be on or off");
+			}
+			config.huge_pages = value == "on";
+		} else if (option == UPGRADE_FD_OPTION){
+			config.handoff_fd = parsePositive(option, value, 999999999);
+		} else {
+			throw std::invalid_argument("Error: unknown option " + option);
+		}
+	}
+	return config;
+}
@@ -0,0 +1,125 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EpollLoop.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 11:02:29 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 11:02:29 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "EpollLoop.hpp"
+#include "Logger.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+EpollLoop::EpollLoop(bool edge_triggered) : edge_triggered_(edge_triggered),
+	events_(EPOLL_MAX_EVENTS), n_ready_(0){
+	epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd_ == -1){
+		throw std::runtime_error("Error: epoll_create1 failed");
+	}
+	if (!watch(wake_fd_, false, true) || !watch(timer_fd_, false, true)){
+		close(epoll_fd_);
+		throw std::runtime_error("Error: epoll_ctl ADD wake_fd/timer_fd failed");
+	}
+}
+
+EpollLoop::~EpollLoop(){
+	close(epoll_fd_);
+}
+
+/**
+ * @brief Besides our spinning, ask the kernel to busy-poll the NIC queues of
+ * the sockets in this epoll inside epoll_wait()(EPIOCSPARAMS). A kernel
+ * without it, or a loopback/NIC without NAPI, leaves it to the spinning.
+ */
+void	EpollLoop::enableBusyPoll(unsigned usec){
+	ReadyLoop::enableBusyPoll(usec);
+	struct epoll_params	params{};
+	params.busy_poll_usecs = usec;
+	params.busy_poll_budget = EPOLL_BUSY_POLL_BUDGET;
+	params.prefer_busy_poll = 1;
+	if (ioctl(epoll_fd_, EPIOCSPARAMS, &params) == -1){
+		Logger::log(Logger::INFO, std::string("epoll busy poll parameters not supported: ")
+			+ strerror(errno));
+	}
+}
+
+const char*	EpollLoop::getName() const{
+	return edge_triggered_ ? "epoll-et" : "epoll";
+}
+
+void	EpollLoop::runOnce(EventHandler& handler){
+	// the return value of epoll_wait():
+	// > 0  Number of file descriptors that are ready for the requested I/O.
+	// =0   Timeout occurred — no file descriptors were ready
+	// < 0  Error occurred — check errno for the specific error cause.
+	// the replies of the previous turn go out before we sleep
+	flushSends(handler);
+	// with clients on the ready list or connections left to accept only collect
+	// what is there, don't block. With --busy-poll spin a while before blocking
+	size_t		n_listed = ready_list_.size();
+	size_t		n_backlog = accept_backlog_.size();
+	bool		blocking = !n_listed && !n_backlog;
+	bool		spinning;
+	uint64_t	spin_end = 0;
+	do {
+		spinning = blocking && keepSpinning(spin_end);
+		n_ready_ = epoll_wait(epoll_fd_, events_.data(), events_.size(),
+			blocking && !spinning ? -1 : 0);
+	} while (spinning && n_ready_ == 0);
+	startTurn(blocking, spinning);
+	if (n_ready_ < 0){
+		n_ready_ = 0;
+		if (errno == EINTR){
+			return; // the caller checks why
+		}
+		throw std::runtime_error("Error:" + std::string("epoll_wait: ") + strerror(errno));
+	}
+	for (int i = 0; i < n_ready_; i++){
+		int			fd = events_[i].data.fd;
+		uint32_t	evs = events_[i].events;
+		// the client was removed earlier in this batch
+		if (fd < 0){
+			continue;
+		}
+		handleReady(handler, fd, evs & EPOLLIN, evs & EPOLLOUT, evs & EPOLLERR,
+			evs & EPOLLHUP);
+	}
+	n_ready_ = 0;
+	serveReadyList(handler, n_listed);
+	serveAcceptBacklog(handler, n_backlog);
+}
+
+bool	EpollLoop::watch(int fd, bool want_write, bool is_new){
+	epoll_event	ev{};
+	ev.data.fd = fd;
+	if (edge_triggered_){
+		// registered once with everything
+		if (!is_new){
+			return true;
+		}
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	} else {
+		ev.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	}
+	return epoll_ctl(epoll_fd_, is_new ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+/**
+ * @brief Drop fd from the interest set and from the rest of the current batch.
+ * The fd number can be reused by accept() before the batch is done.
+ */
+void	EpollLoop::unwatch(int fd){
+	epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+	for (int i = 0; i < n_ready_; i++){
+		if (events_[i].data.fd == fd){
+			events_[i].data.fd = -1;
+		}
+	}
+}
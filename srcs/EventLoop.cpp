@@ -0,0 +1,330 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EventLoop.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:05:12 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:05:12 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "EventLoop.hpp"
+#include "PollLoop.hpp"
+#include "EpollLoop.hpp"
+#include "UringLoop.hpp"
+#include "Logger.hpp"
+#include "Client.hpp"
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <arpa/inet.h> // for inet_ntop
+#include <sys/socket.h> // for SO_PEERCRED
+#include <netinet/in.h>
+#include <netinet/tcp.h> // for TCP_NODELAY, TCP_NOTSENT_LOWAT
+#include <unistd.h>
+#include <cerrno>
+#include <stdexcept>
+#include <ctime>
+
+void	LatencyHistogram::add(uint64_t ns){
+	size_t	bucket = ns;
+	if (ns >= LATENCY_SUB_BUCKETS){
+		// 3 bits under the highest one pick the sub-bucket(LATENCY_SUB_BUCKETS 8)
+		int	msb = 63 - __builtin_clzll(ns);
+		bucket = msb * LATENCY_SUB_BUCKETS + ((ns >> (msb - 3)) & (LATENCY_SUB_BUCKETS - 1));
+	}
+	counts[bucket]++;
+	n_samples++;
+}
+
+void	LatencyHistogram::merge(const LatencyHistogram& other){
+	for (size_t i = 0; i < 64 * LATENCY_SUB_BUCKETS; i++){
+		counts[i] += other.counts[i];
+	}
+	n_samples += other.n_samples;
+}
+
+uint64_t	LatencyHistogram::percentile(double p) const{
+	unsigned long long	rank = p * n_samples;
+	unsigned long long	seen = 0;
+	for (size_t i = 0; i < 64 * LATENCY_SUB_BUCKETS; i++){
+		seen += counts[i];
+		if (counts[i] && seen > rank){
+			if (i < LATENCY_SUB_BUCKETS){
+				return i;
+			}
+			size_t	msb = i / LATENCY_SUB_BUCKETS;
+			size_t	sub = i % LATENCY_SUB_BUCKETS;
+			return ((LATENCY_SUB_BUCKETS + sub + 1) << (msb - 3)) - 1;
+		}
+	}
+	return 0;
+}
+
+EventLoop::EventLoop() : busy_poll_ns_(0), notsent_lowat_(0), turn_start_(0),
+	accept_failures_(0){
+	wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd_ == -1){
+		throw std::runtime_error("Error: eventfd failed");
+	}
+	timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd_ == -1){
+		close(wake_fd_);
+		throw std::runtime_error("Error: timerfd_create failed");
+	}
+}
+
+EventLoop::~EventLoop(){
+	close(wake_fd_);
+	close(timer_fd_);
+}
+
+std::unique_ptr<EventLoop>	EventLoop::create(BACKEND backend){
+	switch (backend){
+		case BACKEND::POLL:
+			return std::make_unique<PollLoop>();
+		case BACKEND::EPOLL:
+			return std::make_unique<EpollLoop>(false);
+		case BACKEND::URING:
+			try {
+				return std::make_unique<UringLoop>();
+			} catch (std::exception& e){
+				Logger::log(Logger::WARNING, std::string(e.what()) + ", falling back to epoll-et");
+			}
+			break;
+		case BACKEND::EPOLL_ET:
+			break;
+	}
+	return std::make_unique<EpollLoop>(true);
+}
+
+void	EventLoop::wake(){
+	uint64_t	one = 1;
+	if (write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN){
+		Logger::log(Logger::WARNING, "Failed to wake an event loop");
+	}
+}
+
+/**
+ * @brief Arm the timerfd to expire every interval_ms. A loop that falls behind
+ * gets the missed expirations counted in one onTick(), none is lost.
+ */
+void	EventLoop::startTimer(unsigned interval_ms){
+	struct itimerspec	spec{};
+	spec.it_interval.tv_sec = interval_ms / 1000;
+	spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+	spec.it_value = spec.it_interval;
+	if (timerfd_settime(timer_fd_, 0, &spec, nullptr) == -1){
+		throw std::runtime_error("Error: timerfd_settime failed");
+	}
+}
+
+bool	EventLoop::addTlsListener(int fd, TlsContext& tls){
+	(void)fd;
+	(void)tls;
+	return false;
+}
+
+bool	EventLoop::enableZerocopy(size_t min_bytes){
+	(void)min_bytes;
+	return false;
+}
+
+void	EventLoop::enableBusyPoll(unsigned usec){
+	busy_poll_ns_ = usec * 1000ULL;
+}
+
+void	EventLoop::setNotsentLowat(unsigned bytes){
+	notsent_lowat_ = bytes;
+}
+
+void	EventLoop::quiesce(EventHandler& handler){
+	(void)handler;
+}
+
+const IoStats&	EventLoop::getStats() const{
+	return stats_;
+}
+
+uint64_t	EventLoop::getTurnStart() const{
+	return turn_start_;
+}
+
+uint64_t	EventLoop::nowNs(){
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Busy polling(--busy-poll): instead of sleeping in the wait as soon as
+ * nothing is ready, the loop keeps asking with a zero timeout for
+ * busy_poll_ns_. An event arriving meanwhile is handled without the wakeup of
+ * a sleeping thread(scheduler latency, a CPU leaving its idle state), at the
+ * cost of a core spinning.
+ */
+bool	EventLoop::keepSpinning(uint64_t& deadline){
+	if (busy_poll_ns_ == 0){
+		return false;
+	}
+	uint64_t	now = nowNs();
+	if (deadline == 0){
+		deadline = now + busy_poll_ns_;
+	}
+	return now < deadline;
+}
+
+/**
+ * @brief The wait returned: stamp the turn and count how the wait ended.
+ *
+ * @param blocking: the wait could have slept(nothing was left from the last turn)
+ * @param spun: and it found the events while spinning
+ */
+void	EventLoop::startTurn(bool blocking, bool spun){
+	turn_start_ = nowNs();
+	if (blocking){
+		if (spun){
+			stats_.busy_poll_hits++;
+		} else {
+			stats_.sleeps++;
+		}
+	}
+}
+
+void	EventLoop::tuneSocket(int fd, int family){
+	if (family != AF_INET && family != AF_INET6){
+		return;
+	}
+	// the loop already writes a turn's replies in one call, Nagle would only
+	// hold back the last segment
+	int	one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	// what the kernel can't send yet stays in our queue, the writability
+	// events come while the kernel still has data in flight
+	if (notsent_lowat_ > 0){
+		setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &notsent_lowat_, sizeof(notsent_lowat_));
+	}
+	// a NIC driver with NAPI is polled on recv() instead of waiting for its
+	// interrupt. Raising it may need CAP_NET_ADMIN, it stays off then
+	if (busy_poll_ns_ > 0){
+		int	usec = busy_poll_ns_ / 1000;
+		setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec));
+	}
+}
+
+/**
+ * @brief A send call of the client wrote data: sample the relay latency of the
+ * oldest reply it had queued.
+ */
+void	EventLoop::recordSend(const Client& cli){
+	if (uint64_t since = cli.getQueuedSince()){
+		stats_.relay_latency.add(nowNs() - since);
+	}
+}
+
+/**
+ * @brief The numeric address of a peer. An IPv4 client of a dual-stack listener
+ * shows up as ::ffff:a.b.c.d, it is given its plain IPv4 address. An IPv6
+ * address starting with ':' gets a leading '0'(like other servers do): in the
+ * WHO/WHOIS replies a parameter starting with ':' would swallow the rest of
+ * the line.
+ *
+ * A Unix socket peer has no address: its host is made of the uid and pid the
+ * kernel recorded when it connected(SO_PEERCRED), "uid1000.pid4242.unix", so
+ * a local bot can't pass for another user's.
+ */
+std::string	EventLoop::formatHost(int fd, const struct sockaddr* addr){
+	char	host[INET6_ADDRSTRLEN] = "0.0.0.0";
+	if (addr->sa_family == AF_UNIX){
+		struct ucred	cred;
+		socklen_t		len = sizeof(cred);
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1){
+			return "unknown.unix";
+		}
+		return "uid" + std::to_string(cred.uid) + ".pid" + std::to_string(cred.pid) + ".unix";
+	}
+	if (addr->sa_family == AF_INET){
+		inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(addr)->sin_addr, host, sizeof(host));
+	} else if (addr->sa_family == AF_INET6){
+		const in6_addr&	addr6 = reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr;
+		if (IN6_IS_ADDR_V4MAPPED(&addr6)){
+			inet_ntop(AF_INET, &addr6.s6_addr[12], host, sizeof(host));
+		} else {
+			inet_ntop(AF_INET6, &addr6, host, sizeof(host));
+			if (host[0] == ':'){
+				return "0" + std::string(host);
+			}
+		}
+	}
+	return host;
+}
+
+bool	EventLoop::isAcceptResourceError(int err){
+	return err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM;
+}
+
+void	EventLoop::noteAcceptFailure(int err){
+	if (accept_failures_++ == 0){
+		Logger::log(Logger::WARNING, "accept failed: " + std::string(strerror(err))
+			+ ", not accepting until a connection is closed");
+	}
+}
+
+void	EventLoop::noteAcceptSuccess(){
+	if (accept_failures_ > 0){
+		Logger::log(Logger::INFO, "accepting again, after " + std::to_string(accept_failures_)
+			+ " failed tries");
+		accept_failures_ = 0;
+	}
+}
+
+/**
+ * @brief Reset the eventfd, all the wake() calls so far are handled by the
+ * coming onWake().
+ */
+void	EventLoop::clearWake(){
+	uint64_t	n_wakeups;
+	if (read(wake_fd_, &n_wakeups, sizeof(n_wakeups)) < 0 && errno != EAGAIN){
+		Logger::log(Logger::WARNING, "Failed to read the wake eventfd");
+	}
+}
+
+/**
+ * @brief Reset the timerfd.
+ *
+ * @return the expirations since the last call, 0 for a spurious wakeup
+ */
+uint64_t	EventLoop::clearTimer(){
+	uint64_t	n_ticks = 0;
+	if (read(timer_fd_, &n_ticks, sizeof(n_ticks)) < 0){
+		return 0;
+	}
+	return n_ticks;
+}
+
+void	EventLoop::addToReadyList(Client& cli){
+	if (cli.isReadyListed() || cli.isDisconnected()){
+		return;
+	}
+	cli.setReadyListed(true);
+	ready_list_.push_back(cli.shared_from_this());
+}
+
+void	EventLoop::markReady(Client& cli){
+	addToReadyList(cli);
+}
+
+/**
+ * @brief Take the oldest client of the ready list, nullptr when it was removed
+ * meanwhile.
+ */
+std::shared_ptr<Client>	EventLoop::popReadyList(){
+	std::shared_ptr<Client>	cli = std::move(ready_list_.front());
+	ready_list_.pop_front();
+	cli->setReadyListed(false);
+	if (cli->isDisconnected()){
+		return nullptr;
+	}
+	return cli;
+}
@@ -0,0 +1,472 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Handoff.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Handoff.hpp"
+#include "Server.hpp"
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+void	StateWriter::putInt(int64_t n){
+	data_.append(reinterpret_cast<const char*>(&n), sizeof(n));
+}
+
+void	StateWriter::putString(const std::string& s){
+	putInt(s.size());
+	data_.append(s);
+}
+
+const std::string&	StateWriter::data() const{
+	return data_;
+}
+
+StateReader::StateReader(const std::string& data) : data_(data), pos_(0){
+}
+
+int64_t	StateReader::getInt(){
+	int64_t	n;
+	if (data_.size() - pos_ < sizeof(n)){
+		throw std::runtime_error("Error: handoff state is truncated");
+	}
+	std::memcpy(&n, data_.data() + pos_, sizeof(n));
+	pos_ += sizeof(n);
+	return n;
+}
+
+std::string	StateReader::getString(){
+	int64_t	len = getInt();
+	if (len < 0 || static_cast<uint64_t>(len) > data_.size() - pos_){
+		throw std::runtime_error("Error: handoff state is truncated");
+	}
+	std::string	s = data_.substr(pos_, len);
+	pos_ += len;
+	return s;
+}
+
+void	Handoff::writeAll(int sock, const char* data, size_t len){
+	while (len > 0){
+		ssize_t	n = send(sock, data, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR){
+			continue;
+		}
+		if (n < 0){
+			throw std::runtime_error("Error: handoff send: " + std::string(strerror(errno)));
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+/**
+ * @brief Read exactly len bytes. Plain reads never run into the fd batches: the
+ * kernel stops a stream read at a byte carrying SCM_RIGHTS.
+ */
+void	Handoff::readAll(int sock, char* data, size_t len){
+	while (len > 0){
+		ssize_t	n = recv(sock, data, len, 0);
+		if (n < 0 && errno == EINTR){
+			continue;
+		}
+		if (n <= 0){
+			throw std::runtime_error("Error: handoff socket closed early");
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+void	Handoff::sendByte(int sock, char c){
+	writeAll(sock, &c, 1);
+}
+
+char	Handoff::receiveByte(int sock, int timeout_ms){
+	struct pollfd	pfd = {sock, POLLIN, 0};
+	int				ret;
+	while ((ret = poll(&pfd, 1, timeout_ms)) < 0 && errno == EINTR){
+	}
+	if (ret == 0){
+		throw std::runtime_error("Error: no answer over the handoff socket");
+	}
+	char	c;
+	readAll(sock, &c, 1);
+	return c;
+}
+
+void	Handoff::sendState(int sock, const std::string& state, const std::vector<int>& fds){
+	StateWriter	head;
+	head.putInt(state.size());
+	head.putInt(fds.size());
+	writeAll(sock, head.data().data(), head.data().size());
+	writeAll(sock, state.data(), state.size());
+	for (size_t first = 0; first < fds.size(); first += HANDOFF_FDS_PER_MSG){
+		size_t			n_fds = std::min(fds.size() - first, static_cast<size_t>(HANDOFF_FDS_PER_MSG));
+		char			byte = 0;
+		struct iovec	iov = {&byte, 1};
+		std::vector<char>	control(CMSG_SPACE(n_fds * sizeof(int)));
+		struct msghdr	msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.data();
+		msg.msg_controllen = control.size();
+		struct cmsghdr*	cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(n_fds * sizeof(int));
+		std::memcpy(CMSG_DATA(cmsg), fds.data() + first, n_fds * sizeof(int));
+		ssize_t	n;
+		while ((n = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR){
+		}
+		if (n != 1){
+			throw std::runtime_error("Error: handoff sendmsg: " + std::string(strerror(errno)));
+		}
+	}
+}
+
+/**
+ * @brief The fds arrive close-on-exec(MSG_CMSG_CLOEXEC), like the sockets we
+ * create ourselves.
+ */
+std::string	Handoff::receiveState(int sock, std::vector<int>& fds){
+	std::string	head(2 * sizeof(int64_t), '\0');
+	readAll(sock, &head[0], head.size());
+	StateReader	reader(head);
+	int64_t		state_len = reader.getInt();
+	int64_t		n_fds = reader.getInt();
+	std::string	state(state_len, '\0');
+	readAll(sock, &state[0], state.size());
+	while (static_cast<int64_t>(fds.size()) < n_fds){
+		char				byte;
+		struct iovec		iov = {&byte, 1};
+		std::vector<char>	control(CMSG_SPACE(HANDOFF_FDS_PER_MSG * sizeof(int)));
+		struct msghdr		msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.data();
+		msg.msg_controllen = control.size();
+		ssize_t	n;
+		while ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR){
+		}
+		if (n != 1 || (msg.msg_flags & MSG_CTRUNC)){
+			throw std::runtime_error("Error: handoff recvmsg failed");
+		}
+		for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+				size_t	n_got = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				size_t	at = fds.size();
+				fds.resize(at + n_got);
+				std::memcpy(fds.data() + at, CMSG_DATA(cmsg), n_got * sizeof(int));
+			}
+		}
+	}
+	return state;
+}
+
+/**
+ * @brief SIGUSR2: start the binary again(config_.command_line, so a new build
+ * at the same path is picked up) with the far end of a Unix socket as
+ * --upgrade-fd. Once the new process says it is ready, every worker leaves its
+ * loop and startServer() hands the state over. If it doesn't start, we keep
+ * serving.
+ */
+void	Server::startUpgrade(){
+	int	sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1){
+		Logger::log(Logger::ERROR, "Hot restart: socketpair: " + std::string(strerror(errno)));
+		return;
+	}
+	std::vector<std::string>	args = config_.command_line;
+	args.push_back(UPGRADE_FD_OPTION);
+	args.push_back(std::to_string(sv[1]));
+	std::vector<char*>	argv;
+	for (auto& arg : args){
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+	Logger::log(Logger::INFO, "Hot restart: starting " + args[0]);
+	pid_t	pid = fork();
+	if (pid == 0){
+		// the other workers keep running in the parent: only async-signal-safe
+		// calls until exec
+		fcntl(sv[1], F_SETFD, 0);
+		execvp(argv[0], argv.data());
+		_exit(127);
+	}
+	close(sv[1]);
+	try {
+		if (pid == -1){
+			throw std::runtime_error("fork: " + std::string(strerror(errno)));
+		}
+		if (Handoff::receiveByte(sv[0], HANDOFF_TIMEOUT_MS) != HANDOFF_READY){
+			throw std::runtime_error("unexpected answer from the new process");
+		}
+	} catch (std::exception& e){
+		Logger::log(Logger::ERROR, std::string("Hot restart aborted: ") + e.what());
+		close(sv[0]);
+		if (pid > 0){
+			kill(pid, SIGKILL);
+			waitpid(pid, nullptr, 0);
+		}
+		return;
+	}
+	handoff_fd_ = sv[0];
+	keep_running_ = 0;
+}
+
+/**
+ * @brief Every worker is stopped and quiesced: send the listening sockets, the
+ * client sockets and the IRC state to the new process, wait until it adopted
+ * them. TLS clients are dropped(with a QUIT to their channels), their session
+ * state lives in this process. Closing our copies afterwards(cleanServer())
+ * doesn't touch the connections.
+ *
+ * Layout: magic, the listening sockets(of every worker), the clients(fd index,
+ * identity, registration, unparsed input, unsent output), the channels(modes,
+ * members by client index), n_channel_.
+ */
+void	Server::handOver(){
+	int	sock = handoff_fd_;
+	handoff_fd_ = -1;
+	// a userspace TLS session can't leave the process, those clients reconnect
+	std::vector<std::shared_ptr<Client>>	tls_clients;
+	for (auto& [fd, cli] : clients_){
+		if (cli->getTls()){
+			tls_clients.push_back(cli);
+		}
+	}
+	for (auto& cli : tls_clients){
+		removeClient(*cli, "Server restarting");
+	}
+	// replies other workers posted after the owner left its loop
+	for (auto& w : workers_){
+		for (auto& [cli, response, since] : w->mailbox){
+			if (!cli->isDisconnected()){
+				cli->queueResponse(response, since);
+			}
+		}
+		w->mailbox.clear();
+	}
+	StateWriter						state;
+	std::vector<int>				fds;
+	std::unordered_map<Client*, int64_t>	index;
+
+	state.putString(HANDOFF_MAGIC);
+	for (auto& w : workers_){
+		fds.insert(fds.end(), w->listen_fds.begin(), w->listen_fds.end());
+	}
+	state.putInt(fds.size());
+	state.putInt(clients_.size());
+	for (auto& [fd, cli] : clients_){
+		int64_t	i = index.size();
+		index[cli.get()] = i;
+		fds.push_back(fd);
+		state.putString(cli->getHostname());
+		state.putString(cli->getNick());
+		state.putString(cli->getUsername());
+		state.putString(cli->getRealname());
+		state.putString(cli->getServername());
+		state.putString(cli->getPassword());
+		state.putString(cli->getUserMode());
+		state.putInt(cli->isRegistered());
+		state.putInt(cli->getUserNChannel());
+		state.putString(cli->getRawData());
+		state.putString(cli->getPendingOutput());
+	}
+	state.putInt(channels_.size());
+	for (auto& [name, channel] : channels_){
+		state.putString(name);
+		state.putString(channel->getPassword());
+		state.putString(channel->getTopic());
+		state.putInt(channel->getInviteMode());
+		state.putInt(channel->getTopicMode());
+		state.putInt(channel->getPasswdMode());
+		state.putInt(channel->getLimitMode());
+		state.putInt(channel->getUserLimit());
+		state.putInt(channel->getChannelUsers().size());
+		for (Client* member : channel->getChannelUsers()){
+			state.putInt(index.at(member));
+			state.putInt(channel->isChannelOperator(*member));
+		}
+		std::vector<int64_t>	invited;
+		for (auto& [cli, i] : index){
+			if (channel->isInvitedUser(*cli)){
+				invited.push_back(i);
+			}
+		}
+		state.putInt(invited.size());
+		for (int64_t i : invited){
+			state.putInt(i);
+		}
+	}
+	state.putInt(n_channel_);
+
+	try {
+		Handoff::sendState(sock, state.data(), fds);
+		if (Handoff::receiveByte(sock, HANDOFF_TIMEOUT_MS) != HANDOFF_DONE){
+			throw std::runtime_error("Error: unexpected answer from the new process");
+		}
+	} catch (...){
+		close(sock);
+		throw;
+	}
+	close(sock);
+	unix_paths_.clear(); // the new process listens on them now
+	Logger::log(Logger::INFO, "Hot restart: " + std::to_string(clients_.size())
+		+ " clients and " + std::to_string(channels_.size()) + " channels handed over");
+}
+
+/**
+ * @brief The new process of a hot restart: take the sockets and the state from
+ * the old one, before any worker runs. A client keeps its buffers and goes to
+ * the workers round robin; when it has complete lines waiting it gets a turn
+ * straight away. The liveness timers start over.
+ */
+void	Server::restoreState(int sock){
+	std::vector<int>	fds;
+	std::string			data;
+	try {
+		Handoff::sendByte(sock, HANDOFF_READY);
+		data = Handoff::receiveState(sock, fds);
+	} catch (...){
+		close(sock);
+		throw;
+	}
+	StateReader	state(data);
+	if (state.getString() != HANDOFF_MAGIC){
+		close(sock);
+		throw std::runtime_error("Error: the old process hands over an unknown state");
+	}
+	// every worker takes the listening sockets bound to its addresses, the
+	// addresses we don't listen on any more are closed
+	size_t				n_listeners = state.getInt();
+	std::vector<int>	adopted(fds.begin(), fds.begin() + std::min(n_listeners, fds.size()));
+	try {
+		for (auto& w : workers_){
+			setupWorker(*w, adopted);
+		}
+	} catch (...){
+		for (int fd : adopted){
+			close(fd);
+		}
+		close(sock);
+		throw;
+	}
+	for (int fd : adopted){
+		close(fd);
+	}
+
+	size_t					n_clients = state.getInt();
+	std::vector<Client*>	restored;
+	if (n_listeners + n_clients != fds.size()){
+		close(sock);
+		throw std::runtime_error("Error: handoff state and sockets don't match");
+	}
+	for (size_t i = 0; i < n_clients; i++){
+		int						fd = fds[n_listeners + i];
+		std::shared_ptr<Client>	client = std::make_shared<Client>(fd, state.getString());
+		client->setNick(state.getString());
+		client->setUsername(state.getString());
+		client->setRealname(state.getString());
+		client->setServername(state.getString());
+		client->setPassword(state.getString());
+		client->setUserMode(state.getString());
+		client->setRegistrationStatus(state.getInt());
+		client->setUserNChannel(state.getInt());
+		std::string	input = state.getString();
+		std::string	output = state.getString();
+		client->appendRawData(input.data(), input.size());
+
+		Worker&	w = *workers_[i % workers_.size()];
+		client->setWorkerId(w.id);
+		client->touch(w.timers.now());
+		w.timers.schedule(client->getTimer(), client->isRegistered()
+			? config_.ping_interval : config_.registration_timeout);
+		clients_[fd] = client;
+		if (client->isRegistered()){
+			addNick(*client);
+		}
+		n_user_++;
+		w.loop->addClient(client);
+		if (client->queueResponse(std::make_shared<const std::string>(output))
+			&& client->hasPendingOutput()){
+			w.loop->startSend(*client);
+		}
+		if (client->hasCompleteMessage()){
+			w.loop->markReady(*client);
+		}
+		restored.push_back(client.get());
+	}
+
+	size_t	n_channels = state.getInt();
+	for (size_t i = 0; i < n_channels; i++){
+		std::string	name = state.getString();
+		std::string	password = state.getString();
+		std::string	topic = state.getString();
+		bool		invite_only = state.getInt();
+		bool		topic_restricted = state.getInt();
+		bool		with_password = state.getInt();
+		bool		with_limit = state.getInt();
+		int			limit = state.getInt();
+		size_t		n_members = state.getInt();
+		std::shared_ptr<Channel>	channel;
+		for (size_t m = 0; m < n_members; m++){
+			Client&	member = *restored.at(state.getInt());
+			bool	is_operator = state.getInt();
+			if (!channel){
+				// the first member comes in as operator
+				channel = std::make_shared<Channel>(name, member);
+			} else {
+				channel->addNewUser(member);
+			}
+			if (is_operator){
+				channel->addNewOperator(member);
+			} else {
+				channel->removeOperator(member);
+			}
+		}
+		size_t	n_invited = state.getInt();
+		for (size_t m = 0; m < n_invited; m++){
+			Client&	invited = *restored.at(state.getInt());
+			if (channel){
+				channel->addNewInviteUser(invited);
+			}
+		}
+		if (!channel){
+			continue;
+		}
+		channel->addNewTopic(topic);
+		channel->addNewPassword(password);
+		channel->addLimit(limit);
+		if (invite_only){
+			channel->setInviteOnly();
+		}
+		if (topic_restricted){
+			channel->setTopicRestrictions();
+		}
+		if (with_password){
+			channel->setPassword();
+		}
+		if (with_limit){
+			channel->setLimit();
+		}
+		channels_[name] = channel;
+	}
+	n_channel_ = state.getInt();
+
+	Handoff::sendByte(sock, HANDOFF_DONE);
+	close(sock);
+	Logger::log(Logger::INFO, "Hot restart: took over " + std::to_string(clients_.size())
+		+ " clients and " + std::to_string(channels_.size()) + " channels");
+}
@@ -0,0 +1,242 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   IoUring.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/23 09:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/23 09:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "IoUring.hpp"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+/**
+ * @brief Create the ring and map the submission queue, the completion queue and
+ * the SQE array into our memory.
+ *
+ * The SQ index array is filled once with the identity mapping, so SQE number i
+ * always goes to slot i and submitting is just moving the tail.
+ */
+IoUring::IoUring(unsigned entries) : ring_fd_(-1), sq_ptr_(MAP_FAILED), sq_size_(0),
+	sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)), sqes_size_(0), sqe_head_(0), sqe_tail_(0),
+	cq_ptr_(MAP_FAILED), cq_size_(0), buf_ring_(nullptr), buf_ring_size_(0),
+	buf_base_(nullptr), buf_count_(0), buf_size_(0), buf_tail_(0){
+	io_uring_params	params;
+	std::memset(&params, 0, sizeof(params));
+	ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring_fd_ < 0){
+		throw std::runtime_error("io_uring_setup: " + std::string(strerror(errno)));
+	}
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)){
+		release();
+		throw std::runtime_error("io_uring: kernel is too old");
+	}
+	sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	// one mapping holds both rings(IORING_FEAT_SINGLE_MMAP)
+	if (cq_size_ > sq_size_){
+		sq_size_ = cq_size_;
+	}
+	sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ring_fd_, IORING_OFF_SQ_RING);
+	if (sq_ptr_ == MAP_FAILED){
+		release();
+		throw std::runtime_error("io_uring: mmap of the rings failed");
+	}
+	cq_ptr_ = sq_ptr_;
+	sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+	sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+	if (sqes_ == MAP_FAILED){
+		release();
+		throw std::runtime_error("io_uring: mmap of the SQEs failed");
+	}
+	char*	sq = static_cast<char*>(sq_ptr_);
+	sq_khead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	sq_ktail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	sq_entries_ = params.sq_entries;
+	unsigned*	sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	for (unsigned i = 0; i < sq_entries_; i++){
+		sq_array[i] = i;
+	}
+	sqe_head_ = sqe_tail_ = *sq_ktail_;
+
+	char*	cq = static_cast<char*>(cq_ptr_);
+	cq_khead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	cq_ktail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring(){
+	release();
+}
+
+void	IoUring::release(){
+	if (buf_ring_){
+		munmap(buf_ring_, buf_ring_size_);
+		buf_ring_ = nullptr;
+	}
+	delete[] buf_base_;
+	buf_base_ = nullptr;
+	if (sqes_ != MAP_FAILED){
+		munmap(sqes_, sqes_size_);
+		sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+	}
+	if (sq_ptr_ != MAP_FAILED){
+		munmap(sq_ptr_, sq_size_);
+		sq_ptr_ = MAP_FAILED;
+	}
+	if (ring_fd_ >= 0){
+		close(ring_fd_);
+		ring_fd_ = -1;
+	}
+}
+
+/**
+ * @brief Get a zeroed SQE. When the queue is full, the queued entries are
+ * submitted first to make room.
+ *
+ * @return the SQE, nullptr only if the kernel doesn't take anything.
+ */
+io_uring_sqe*	IoUring::getSqe(){
+	unsigned	head = __atomic_load_n(sq_khead_, __ATOMIC_ACQUIRE);
+	if (sqe_tail_ - head >= sq_entries_){
+		submit();
+		head = __atomic_load_n(sq_khead_, __ATOMIC_ACQUIRE);
+		if (sqe_tail_ - head >= sq_entries_){
+			return nullptr;
+		}
+	}
+	io_uring_sqe*	sqe = &sqes_[sqe_tail_ & sq_mask_];
+	std::memset(sqe, 0, sizeof(*sqe));
+	sqe_tail_++;
+	return sqe;
+}
+
+int	IoUring::enter(unsigned to_submit, unsigned wait_nr, unsigned flags){
+	int	ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, wait_nr, flags, nullptr, 0);
+	return ret < 0 ? -errno : ret;
+}
+
+int	IoUring::submit(){
+	return submitAndWait(0);
+}
+
+/**
+ * @brief Publish the new SQEs to the kernel and optionally wait for
+ * completions, all in one io_uring_enter().
+ *
+ * @return number of submitted SQEs, or -errno(-EINTR on a signal)
+ */
+int	IoUring::submitAndWait(unsigned wait_nr){
+	unsigned	to_submit = flushSq();
+	if (!to_submit && !wait_nr){
+		return 0;
+	}
+	return enter(to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+}
+
+/**
+ * @brief Like submitAndWait(0), but always enters the kernel to collect the
+ * completions: recv/accept completions are posted by task work that only runs
+ * when we enter, a loop that never waits would not see them.
+ */
+int	IoUring::submitAndPoll(){
+	return enter(flushSq(), 0, IORING_ENTER_GETEVENTS);
+}
+
+/**
+ * @brief Publish the SQEs got since the last call to the kernel.
+ *
+ * @return how many
+ */
+unsigned	IoUring::flushSq(){
+	unsigned	to_submit = sqe_tail_ - sqe_head_;
+	if (to_submit){
+		__atomic_store_n(sq_ktail_, sqe_tail_, __ATOMIC_RELEASE);
+		sqe_head_ = sqe_tail_;
+	}
+	return to_submit;
+}
+
+/**
+ * @brief Number of completions waiting in the queue.
+ */
+unsigned	IoUring::cqReady() const{
+	return __atomic_load_n(cq_ktail_, __ATOMIC_ACQUIRE) - *cq_khead_;
+}
+
+/**
+ * @brief Next completion, or nullptr when the queue is empty. The entry stays
+ * valid until cqeSeen().
+ */
+io_uring_cqe*	IoUring::peekCqe(){
+	unsigned	head = *cq_khead_;
+	if (head == __atomic_load_n(cq_ktail_, __ATOMIC_ACQUIRE)){
+		return nullptr;
+	}
+	return &cqes_[head & cq_mask_];
+}
+
+void	IoUring::cqeSeen(){
+	__atomic_store_n(cq_khead_, *cq_khead_ + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Register a ring of count buffers of size bytes as buffer group group.
+ * A recv with IOSQE_BUFFER_SELECT picks one of them when data arrives, so no
+ * memory is pinned for idle connections.
+ */
+void	IoUring::setupBufferRing(uint16_t group, unsigned count, unsigned size){
+	buf_ring_size_ = count * sizeof(io_uring_buf);
+	void*	ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring == MAP_FAILED){
+		throw std::runtime_error("io_uring: mmap of the buffer ring failed");
+	}
+	buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+	buf_ring_->tail = 0;
+	io_uring_buf_reg	reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+	reg.ring_entries = count;
+	reg.bgid = group;
+	if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0){
+		throw std::runtime_error("io_uring: provided buffer ring: " + std::string(strerror(errno)));
+	}
+	buf_count_ = count;
+	buf_size_ = size;
+	buf_base_ = new char[static_cast<size_t>(count) * size];
+	buf_tail_ = 0;
+	for (unsigned bid = 0; bid < count; bid++){
+		recycleBuffer(bid);
+	}
+}
+
+char*	IoUring::getBuffer(uint16_t bid) const{
+	return buf_base_ + static_cast<size_t>(bid) * buf_size_;
+}
+
+/**
+ * @brief Give a buffer back to the kernel once its data has been consumed.
+ */
+void	IoUring::recycleBuffer(uint16_t bid){
+	// the entries start at the ring base, the header's bufs[] member is not
+	// usable from C++(its flex array wrapper moves it 8 bytes further)
+	io_uring_buf*	buf = reinterpret_cast<io_uring_buf*>(buf_ring_) + (buf_tail_ & (buf_count_ - 1));
+	buf->addr = reinterpret_cast<uint64_t>(getBuffer(bid));
+	buf->len = buf_size_;
+	buf->bid = bid;
+	buf_tail_++;
+	__atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
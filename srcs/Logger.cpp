@@ -24,26 +24,35 @@ Logger::~Logger(){
 const std::chrono::system_clock::time_point Logger::start_time{
 	std::chrono::system_clock::now()};
 
+std::mutex	Logger::mutex_;
+
+/**
+ * The line is built first and written under mutex_, so the worker threads don't
+ * interleave their output.
+ */
 void Logger::log(enum LEVEL level, std::string msg){
 	if (level >= LOG_LEVEL){
 		auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(
 					std::chrono::system_clock::now() - start_time).count();
+		std::string	line;
 		if (level == DEBUG){
-			std::cout << GREEN << diff << " {DEBUG} ";
+			line = GREEN + std::to_string(diff) + " {DEBUG} ";
 		} else if (level == INFO){
-			std::cout << BLUE << diff << " {INFO} ";
+			line = BLUE + std::to_string(diff) + " {INFO} ";
 		} else if (level == WARNING){
-			std::cout << ORANGE << diff << " {WARNING} ";
+			line = ORANGE + std::to_string(diff) + " {WARNING} ";
 		} else if (level == ERROR){
-			std::cout << RED << diff << " {ERROR} ";
+			line = RED + std::to_string(diff) + " {ERROR} ";
 		}
 		cleanMessage(msg);
-		std::cout << msg << RESET << std::endl;
+		line += msg + RESET;
+		std::lock_guard<std::mutex>	lock(mutex_);
+		std::cout << line << std::endl;
 	}
 }
 
 void Logger::cleanMessage(std::string& msg){
-	while (msg.back() == '\n' || msg.back() == '\r'){
+	while (!msg.empty() && (msg.back() == '\n' || msg.back() == '\r')){
 		msg.pop_back();
 	}
 }
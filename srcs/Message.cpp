@@ -12,241 +12,183 @@
 
 #include "Message.hpp"
 #include "Logger.hpp"
+#include "CommandTable.hpp"
 #include <string>
-#include <sstream>
+#include <new>
+#include <stdexcept>
 
-Message::Message(std::string& message) :
-      whole_msg_(message),
-      number_of_parameters_(0),
-      msg_trailing_(""),
-      parameters_(),
-      msg_users_(),
-      msg_channels_(),
-      cmd_type_(INVALID),
-      cmd_string_(""),
-      passwords_(),
-      msg_trailing_empty_(false)
-{
-    initCommandHandlers();
+ViewList::ViewList() : items_(reinterpret_cast<std::string_view*>(inline_)), size_(0){
 }
 
-Message::~Message(){
+size_t	ViewList::size() const{
+	return size_;
 }
 
-void Message::initCommandHandlers(){
-    command_handlers_ = {
-        {"PASS",   [this](){ cmd_type_ = PASS; return handlePASS(); }},
-        {"NICK",   [this](){ cmd_type_ = NICK; return handleGeneric(); }},
-        {"TOPIC",  [this](){ cmd_type_ = TOPIC; return handleGeneric(); }},
-        {"USER",   [this](){ cmd_type_ = USER; return handleGeneric(); }},
-        {"PRIVMSG",[this](){ cmd_type_ = PRIVMSG; return handleGeneric(); }},
-        {"PART",   [this](){ cmd_type_ = PART; return handleGeneric(); }},
-        {"JOIN",   [this](){ cmd_type_ = JOIN; return handleJOIN(); }},
-        {"QUIT",   [this](){ cmd_type_ = QUIT; return handleGeneric(); }},
-        {"INVITE", [this](){ cmd_type_ = INVITE; return handleGeneric(); }},
-        {"MODE",   [this](){ cmd_type_ = MODE; return handleMODE(); }},
-        {"CAP",   [this](){ cmd_type_ = CAP; return handleCAP(); }},
-        {"PING",   [this](){ cmd_type_ = PING; return handleNoParse(); }},
-        {"WHOIS",   [this](){ cmd_type_ = WHOIS; return handleGeneric(); }},
-        {"WHO",   [this](){ cmd_type_ = WHO; return handleNoParse(); }},
-        {"KICK",   [this](){ cmd_type_ = KICK; return handleKICK(); }}
-    };
+bool	ViewList::empty() const{
+	return size_ == 0;
 }
 
-bool Message::handleNoParse(){
-    return true;
+std::string_view	ViewList::operator[](size_t i) const{
+	return items_[i];
 }
 
-bool Message::handlePASS(){
-    for (size_t i = 0; i < parameters_.size(); ++i){
-        if (parameters_[i][0] == '#') {
-            msg_channels_.push_back(parameters_[i]);
-        } else{
-            passwords_.push_back(parameters_[i]);
-        }
-    }
-    return true;
+/**
+ * @brief Like std::vector::at(), throws std::out_of_range past the end.
+ */
+std::string_view	ViewList::at(size_t i) const{
+	if (i >= size_){
+		throw std::out_of_range("ViewList::at: " + std::to_string(i) + " >= "
+			+ std::to_string(size_));
+	}
+	return items_[i];
 }
 
-bool Message::handleCAP(){
-    if (parameters_.empty()){
-        Logger::log(Logger::ERROR, "CAP command missing subcommand");
-        return false;
-    }
-    return true;
+const std::string_view*	ViewList::begin() const{
+	return items_;
 }
 
-bool Message::handleGeneric(){
-    for (size_t i = 0; i < parameters_.size(); ++i){
-        if (parameters_[i][0] == '#') {
-            msg_channels_.push_back(parameters_[i]);
-        } else{
-            msg_users_.push_back(parameters_[i]);
-        }
-    }
-    return true;
+const std::string_view*	ViewList::end() const{
+	return items_ + size_;
 }
 
-bool Message::handleJOIN(){
-    for (size_t i = 0; i < parameters_.size(); ++i){
-        if (parameters_[i][0] == '#') {
-            msg_channels_.push_back(parameters_[i]);
-        } else{
-            passwords_.push_back(parameters_[i]);
-        }
-    }
-    return true;
+void	ViewList::push_back(std::string_view token){
+	if (size_ < MESSAGE_MAX_TOKENS){
+		new (&items_[size_++]) std::string_view(token);
+		return;
+	}
+	if (spill_.empty()){
+		spill_.assign(items_, items_ + size_);
+	}
+	spill_.push_back(token);
+	items_ = spill_.data();
+	size_++;
 }
 
-bool Message::handleKICK(){
-    if (parameters_.size() < 2){
-        Logger::log(Logger::ERROR, "KICK should contain at least 2 parameters");
-	    return false;
-    }
-    if (parameters_[0][0] == '#'){
-        msg_channels_.push_back(parameters_[0]);
-    } else{
-        Logger::log(Logger::ERROR, "KICK first parameter should be a channel");
-	    return false;
-    }
-    if (parameters_[1][0] == '#'){
-        Logger::log(Logger::ERROR, "KICK second parameter should not be a channel");
-	    return false;
-    } else{
-        msg_users_.push_back(parameters_[1]);
-    }
-    for (size_t i = 2; i < parameters_.size(); ++i){
-        if (parameters_[i][0] == '#'){
-            msg_channels_.push_back(parameters_[i]);
-        } else{
-            msg_users_.push_back(parameters_[i]);
-        }
-    }
-    return true;
+std::vector<std::string>	ViewList::toStrings() const{
+	return std::vector<std::string>(begin(), end());
 }
 
-bool Message::handleMODE(){
-    if (parameters_.empty()){
-        Logger::log(Logger::ERROR, "MODE should contain parameters");
-        return false;
-    }
-    if (parameters_[0][0] == '#'){
-        msg_channels_.push_back(parameters_[0]);
-    } else{
-        msg_users_.push_back(parameters_[0]);
-    }
-    for (size_t i = 1; i < parameters_.size(); ++i){
-        if (parameters_[i][0] == '#') {
-            msg_channels_.push_back(parameters_[i]);
-        } else{
-            msg_users_.push_back(parameters_[i]);
-        }
-    }
-    return true;
+Message::Message(std::string_view message) :
+      whole_msg_(message),
+      prefix_(),
+      number_of_parameters_(0),
+      msg_trailing_(),
+      cmd_type_(INVALID),
+      command_(nullptr),
+      cmd_string_(),
+      has_trailing_(false),
+      msg_trailing_empty_(false)
+{
+}
+
+Message::~Message(){
 }
 
-bool Message::validateParameters(const std::string& command){
-    auto it = command_handlers_.find(command);
-    if (it != command_handlers_.end()){
-        return it->second();
+/**
+ * @brief The next word of the line from pos on, pos is left after it. Words are
+ * separated by whitespace(as isspace(): space, \t, \r, \n, \v, \f).
+ *
+ * @return the word, empty at the end of the line
+ */
+std::string_view Message::nextWord(size_t& pos) const{
+    static const char   whitespace[] = " \t\r\n\v\f";
+
+    pos = whole_msg_.find_first_not_of(whitespace, pos);
+    if (pos == std::string_view::npos){
+        pos = whole_msg_.size();
+        return std::string_view();
     }
-    Logger::log(Logger::ERROR, "Unknown command: " + command);
-    return false;
+    size_t  start = pos;
+    pos = whole_msg_.find_first_of(whitespace, start);
+    if (pos == std::string_view::npos){
+        pos = whole_msg_.size();
+    }
+    return whole_msg_.substr(start, pos - start);
 }
 
 /**
- * Transforms the entire message received into a istringstream and extracts
- * one by one all the parts of it separated by spaces, then further separates each
- * word by commas if any are found. The command is saved in thecmd_string_ and the
- * trailing message in msg_trailing, everything else is pushed to the parameters_ vector
- * and then validated separately for each command.
+ * Splits the line in place, every part is a view into it. An optional prefix
+ * (a first word starting with ':') is kept apart, the next word is the command,
+ * saved in cmd_string_ and looked up in the CommandTable. Each following word is
+ * pushed to the parameters_ list as it is, until a word starting with ':': from
+ * there the rest of the line, spaces included, is the trailing
+ * message(msg_trailing_).
+ *
+ * @return false for an unknown command
  */
 bool Message::parseMessage(){
-    std::istringstream input_stream(whole_msg_);
-    std::string command;
-    std::string     word;
+    size_t              pos = 0;
+    std::string_view    word = nextWord(pos);
 
-    input_stream >> command;
-    cmd_string_ = command;
-    while (input_stream >> word){
-        if (!word.empty() && word[0] == ':'){
-            std::string rest_of_line;
-            std::getline(input_stream, rest_of_line);
+    if (!word.empty() && word[0] == ':'){
+        prefix_ = word.substr(1);
+        word = nextWord(pos);
+    }
+    cmd_string_ = word;
+    while (!(word = nextWord(pos)).empty()){
+        if (word[0] == ':'){
+            msg_trailing_ = whole_msg_.substr(pos - word.size() + 1);
             // trim the end '\n' and '\r' out
-            while (rest_of_line.back() == '\n' || rest_of_line.back() == '\r'){
-                rest_of_line.pop_back();
-            }
-            if (!rest_of_line.empty()){
-            msg_trailing_ = word.substr(1) + rest_of_line;
-            }
-            else{
-            msg_trailing_ = word.substr(1);
-            if (msg_trailing_.empty()){
-                msg_trailing_empty_ = true;
-            }
+            while (!msg_trailing_.empty()
+                && (msg_trailing_.back() == '\n' || msg_trailing_.back() == '\r')){
+                msg_trailing_.remove_suffix(1);
             }
+            has_trailing_ = true;
+            msg_trailing_empty_ = msg_trailing_.empty();
             break;
         }
-        // trim the end '\n' and '\r' out
-        while (word.back() == '\n' || word.back() == '\r'){
-            word.pop_back();
-        }
-        std::stringstream string_stream(word);
-        std::string token;
-        while (std::getline(string_stream, token, ',')){
-            if (!token.empty()){
-                ++number_of_parameters_;
-                parameters_.push_back(token);
-            }
-        }
+        ++number_of_parameters_;
+        parameters_.push_back(word);
     }
-    if (validateParameters(command) == false){
-        Logger::log(Logger::ERROR, "Validation failed");
+    command_ = CommandTable::find(cmd_string_);
+    if (command_ == nullptr){
+        Logger::log(Logger::ERROR, "Unknown command: " + std::string(cmd_string_));
         return false;
     }
+    cmd_type_ = command_->type;
     return true;
 }
 
-const std::string& Message::getWholeMessage() const{
+std::string_view Message::getWholeMessage() const{
     return whole_msg_;
 }
 
+std::string_view Message::getPrefix() const{
+    return prefix_;
+}
+
 int Message::getNumberOfParameters() const{
     return number_of_parameters_;
 }
 
-const std::string& Message::getTrailing() const{
+std::string_view Message::getTrailing() const{
     return msg_trailing_;
 }
 
-const std::vector<std::string>& Message::getParameters() const{
+const ViewList& Message::getParameters() const{
     return parameters_;
 }
 
-const std::vector<std::string>& Message::getUsers() const{
-    return msg_users_;
-}
-
-const std::vector<std::string>& Message::getChannels() const{
-    return msg_channels_;
-}
-
 COMMANDTYPE Message::getCommandType() const{
     return cmd_type_;
 }
 
-const std::string& Message::getCommandString() const{
-    return cmd_string_;
+const CommandDescriptor* Message::getCommand() const{
+    return command_;
 }
 
-const std::vector<std::string>& Message::getPasswords() const{
-    return passwords_;
+std::string_view Message::getCommandString() const{
+    return cmd_string_;
 }
 
 bool Message::getTrailingEmpty() const{
     return msg_trailing_empty_;
 }
 
+bool Message::hasTrailing() const{
+    return has_trailing_;
+}
+
 /*
 // for testing only
 void	Message::printMsgInfo() const{
@@ -255,18 +197,5 @@ void	Message::printMsgInfo() const{
     // std::cout << "  msg_trailing=" << msg_trailing_ << std::endl;
     // std::cout << "  cmd_string_=" << cmd_string_ << std::endl;
     // std::cout << "  number_of_parameters_=" << std::to_string(number_of_parameters_) << std::endl;
-    // std::cout << "  number_of_user=" << msg_users_.size() << std::endl;
-    // std::cout << "  number_of_channel=" << msg_channels_.size() << std::endl;
-    // std::cout << "  number_of_password=" << passwords_.size() << std::endl;
-    // if (msg_users_.size() > 0){
-    //     printUserList();
-    // }
 }
-
-void	Message::printUserList() const{
-    std::cout<< "Users in a Message class:";
-    for (auto& name : msg_users_){
-        std::cout << name << ", ";
-    }
-    std::cout << std::endl;
-}*/
+*/
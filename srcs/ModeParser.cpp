@@ -0,0 +1,86 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ModeParser.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/06/01 15:40:12 by jingwu            #+#    #+#             */
+/*   Updated: 2025/06/01 15:40:12 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ModeParser.hpp"
+
+ModeParser::ModeParser(const ModeTable& table, std::string_view modes, const WordRange& args) :
+	table_(table), modes_(modes), args_(args), pos_(0), arg_(0), adding_(true){
+}
+
+/**
+ * @brief The next letter of the mode string.
+ *
+ * @return MODE_CHANGE with change filled in, MODE_UNKNOWN or MODE_MISSING_ARG
+ * with change.mode/adding set(the walk can go on after both), MODE_END at the
+ * end of the string
+ */
+MODESTATUS	ModeParser::next(ModeChange& change){
+	for (; pos_ < modes_.size(); pos_++){
+		char	c = modes_[pos_];
+		if (c == '+' || c == '-'){
+			adding_ = (c == '+');
+			continue;
+		}
+		pos_++;
+		change.mode = c;
+		change.adding = adding_;
+		change.arg = std::string_view();
+
+		uint8_t	flags = table_[static_cast<unsigned char>(c)];
+		if (!(flags & MODE_KNOWN)){
+			return MODE_UNKNOWN;
+		}
+		if (flags & (adding_ ? MODE_ARG_ON_SET : MODE_ARG_ON_UNSET)){
+			if (arg_ >= args_.size()){
+				return MODE_MISSING_ARG;
+			}
+			change.arg = args_[arg_++];
+		}
+		return MODE_CHANGE;
+	}
+	return MODE_END;
+}
+
+size_t	ModeParser::getArgsUsed() const{
+	return arg_;
+}
+
+ModeDelta::ModeDelta() : sign_(0){
+}
+
+void	ModeDelta::add(const ModeChange& change){
+	char	sign = change.adding ? '+' : '-';
+
+	if (sign != sign_){
+		modes_ += sign;
+		sign_ = sign;
+	}
+	modes_ += change.mode;
+	if (!change.arg.empty()){
+		if (!params_.empty()){
+			params_ += ' ';
+		}
+		params_.append(change.arg);
+	}
+}
+
+bool	ModeDelta::empty() const{
+	return modes_.empty();
+}
+
+const std::string&	ModeDelta::getModes() const{
+	return modes_;
+}
+
+const std::string&	ModeDelta::getParams() const{
+	return params_;
+}
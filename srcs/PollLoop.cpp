@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   PollLoop.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 11:40:03 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 11:40:03 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "PollLoop.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+PollLoop::PollLoop(){
+	watch(wake_fd_, false, true);
+	watch(timer_fd_, false, true);
+}
+
+const char*	PollLoop::getName() const{
+	return "poll";
+}
+
+/**
+ * @brief Wait and dispatch every fd with revents. A handler can add or remove
+ * fds meanwhile: a removed entry is replaced by the last one, which may then be
+ * skipped for this round; poll() is level-triggered, it comes back next time.
+ */
+void	PollLoop::runOnce(EventHandler& handler){
+	// the replies of the previous turn go out before we sleep
+	flushSends(handler);
+	// with clients on the ready list or connections left to accept only collect
+	// what is there, don't block. With --busy-poll spin a while before blocking
+	size_t		n_listed = ready_list_.size();
+	size_t		n_backlog = accept_backlog_.size();
+	bool		blocking = !n_listed && !n_backlog;
+	bool		spinning;
+	uint64_t	spin_end = 0;
+	int			n_ready;
+	do {
+		spinning = blocking && keepSpinning(spin_end);
+		n_ready = poll(poll_fds_.data(), poll_fds_.size(), blocking && !spinning ? -1 : 0);
+	} while (spinning && n_ready == 0);
+	startTurn(blocking, spinning);
+	if (n_ready < 0){
+		if (errno == EINTR){
+			return; // the caller checks why
+		}
+		throw std::runtime_error("Error: poll: " + std::string(strerror(errno)));
+	}
+	size_t	n_fds = poll_fds_.size();
+	for (size_t i = 0; i < n_fds && i < poll_fds_.size() && n_ready > 0; i++){
+		short	revents = poll_fds_[i].revents;
+		if (revents == 0){
+			continue;
+		}
+		poll_fds_[i].revents = 0;
+		n_ready--;
+		handleReady(handler, poll_fds_[i].fd, revents & POLLIN, revents & POLLOUT,
+			revents & POLLERR, revents & (POLLHUP | POLLNVAL));
+	}
+	serveReadyList(handler, n_listed);
+	serveAcceptBacklog(handler, n_backlog);
+}
+
+bool	PollLoop::watch(int fd, bool want_write, bool is_new){
+	short	events = want_write ? (POLLIN | POLLOUT) : POLLIN;
+	if (is_new){
+		index_[fd] = poll_fds_.size();
+		poll_fds_.push_back({fd, events, 0});
+		return true;
+	}
+	auto	it = index_.find(fd);
+	if (it == index_.end()){
+		return false;
+	}
+	poll_fds_[it->second].events = events;
+	return true;
+}
+
+void	PollLoop::unwatch(int fd){
+	auto	it = index_.find(fd);
+	if (it == index_.end()){
+		return;
+	}
+	size_t	pos = it->second;
+	index_.erase(it);
+	if (pos != poll_fds_.size() - 1){
+		poll_fds_[pos] = poll_fds_.back();
+		index_[poll_fds_[pos].fd] = pos;
+	}
+	poll_fds_.pop_back();
+}
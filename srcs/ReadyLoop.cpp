@@ -0,0 +1,467 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ReadyLoop.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 10:31:47 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 10:31:47 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ReadyLoop.hpp"
+#include "Client.hpp"
+#include "Logger.hpp"
+#include "Tls.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h> // for struct sock_extended_err
+
+ReadyLoop::ReadyLoop() : zerocopy_min_(0){
+}
+
+void	ReadyLoop::addListener(int fd){
+	if (!watch(fd, false, true)){
+		throw std::runtime_error("Error: can't watch the listening socket: "
+			+ std::string(strerror(errno)));
+	}
+	listeners_.push_back(fd);
+}
+
+bool	ReadyLoop::addTlsListener(int fd, TlsContext& tls){
+	addListener(fd);
+	tls_listeners_[fd] = &tls;
+	return true;
+}
+
+void	ReadyLoop::addClient(const std::shared_ptr<Client>& cli){
+	if (!watch(cli->getSocketFd(), false, true)){
+		throw std::runtime_error("Error: can't watch client " + std::to_string(cli->getSocketFd())
+			+ ": " + strerror(errno));
+	}
+	clients_[cli->getSocketFd()] = cli;
+	// the kernel can't send TLS records from user pages
+	if (zerocopy_min_ > 0 && !cli->getTls()){
+		int	one = 1;
+		cli->setZerocopy(setsockopt(cli->getSocketFd(), SOL_SOCKET, SO_ZEROCOPY,
+			&one, sizeof(one)) == 0);
+	}
+}
+
+void	ReadyLoop::removeClient(Client& cli){
+	int	fd = cli.getSocketFd();
+	if (clients_.erase(fd)){
+		unwatch(fd);
+		// its fd is free again
+		resumeListeners();
+	}
+}
+
+/**
+ * @brief Nothing is written here: the replies of the whole turn go out together
+ * in flushSends(). Called only when the queue was empty, so a client is listed
+ * once.
+ */
+void	ReadyLoop::startSend(Client& cli){
+	send_ready_.push_back(cli.shared_from_this());
+}
+
+/**
+ * @brief Every client accepted from now on gets SO_ZEROCOPY, and its sendmsg()
+ * calls of at least min_bytes use MSG_ZEROCOPY. Below that, pinning the pages
+ * and reading the completion cost more than the copy they save.
+ */
+bool	ReadyLoop::enableZerocopy(size_t min_bytes){
+	zerocopy_min_ = min_bytes;
+	return true;
+}
+
+void	ReadyLoop::flushSends(EventHandler& handler){
+	if (send_ready_.empty()){
+		return;
+	}
+	std::vector<std::shared_ptr<Client>>	ready;
+	ready.swap(send_ready_);
+	for (auto& cli : ready){
+		if (cli->isDisconnected()){
+			continue;
+		}
+		if (!writeClient(*cli)){
+			handler.onWriteError(*cli);
+			continue;
+		}
+		updateInterest(*cli);
+	}
+}
+
+/**
+ * @brief Dispatch the readiness of one fd reported by the wait.
+ *
+ * @param error: error condition, also set while MSG_ZEROCOPY completions wait
+ * on the error queue
+ * @param hangup: the connection is gone, the client is dropped once the
+ * complete lines it sent before have run
+ */
+void	ReadyLoop::handleReady(EventHandler& handler, int fd, bool readable, bool writable,
+			bool error, bool hangup){
+	// 1) replies handed over by other workers, or shutdown
+	if (fd == wake_fd_){
+		clearWake();
+		handler.onWake();
+		return;
+	}
+	if (fd == timer_fd_){
+		if (uint64_t n_ticks = clearTimer()){
+			// fds freed by other workers or processes, memory given back
+			resumeListeners();
+			handler.onTick(n_ticks);
+		}
+		return;
+	}
+	// 2) new connections on a listening socket, accept them. A listener with a
+	// backlog from an earlier turn waits for its turn
+	if (std::find(listeners_.begin(), listeners_.end(), fd) != listeners_.end()){
+		if (std::find(accept_backlog_.begin(), accept_backlog_.end(), fd)
+			== accept_backlog_.end()){
+			acceptClients(handler, fd);
+		}
+		return;
+	}
+	auto	it = clients_.find(fd);
+	if (it == clients_.end()){
+		return;
+	}
+	// keeps the client alive if a handler removes it
+	std::shared_ptr<Client>	cli = it->second;
+	// 3) check for error or hang-up. Zerocopy completions aren't errors
+	if (error && cli->hasZerocopyPending()){
+		error = !readZerocopyCompletions(*cli);
+	}
+	if (error || hangup){
+		// complete lines it sent before still run, from the ready list
+		if (cli->hasCompleteMessage()){
+			cli->markInputClosed();
+			addToReadyList(*cli);
+			return;
+		}
+		handler.onDisconnect(*cli, "disconnected");
+		return;
+	}
+	// 4) a TLS connection shakes hands first
+	if (cli->getTls() && !cli->getTls()->isEstablished()){
+		continueHandshake(handler, cli);
+		return;
+	}
+	// 5) data to read. A listed client waits for its turn on the ready list
+	if (readable && !cli->isReadyListed()){
+		readClient(handler, cli);
+	}
+	// 6) socket has room again, send what is left in the queue
+	if (writable && !cli->isDisconnected()){
+		if (!writeClient(*cli)){
+			handler.onWriteError(*cli);
+			return;
+		}
+		updateInterest(*cli);
+	}
+}
+
+void	ReadyLoop::serveReadyList(EventHandler& handler, size_t n_listed){
+	for (; n_listed > 0 && !ready_list_.empty(); n_listed--){
+		std::shared_ptr<Client>	cli = popReadyList();
+		if (cli){
+			readClient(handler, cli);
+		}
+	}
+}
+
+void	ReadyLoop::serveAcceptBacklog(EventHandler& handler, size_t n_listed){
+	n_listed = std::min(n_listed, accept_backlog_.size());
+	std::vector<int>	listed(accept_backlog_.begin(), accept_backlog_.begin() + n_listed);
+	accept_backlog_.erase(accept_backlog_.begin(), accept_backlog_.begin() + n_listed);
+	for (int fd : listed){
+		acceptClients(handler, fd);
+	}
+}
+
+/**
+ * @brief Read and run one budget worth of the client's input. Lines left from
+ * an earlier turn are run first, without reading more. The lines that came
+ * with the end of stream still run(on the next turns if they don't fit in the
+ * budget), then the client is removed.
+ */
+void	ReadyLoop::readClient(EventHandler& handler, const std::shared_ptr<Client>& cli){
+	bool	more_input = true;
+	if (!cli->hasCompleteMessage()){
+		RECV_STATUS	status = cli->isInputClosed() ? RECV_STATUS::CLOSED
+			: cli->receiveRawData(CLIENT_READ_BUDGET);
+		if (status == RECV_STATUS::CLOSED){
+			cli->markInputClosed();
+			if (!cli->hasCompleteMessage()){
+				handler.onDisconnect(*cli, "Client disconnect");
+				return;
+			}
+		}
+		more_input = status == RECV_STATUS::BUDGET;
+	}
+	if (handler.onData(*cli)){
+		more_input = true;
+	}
+	if (more_input){
+		addToReadyList(*cli);
+	} else if (cli->isInputClosed() && !cli->isDisconnected()){
+		handler.onDisconnect(*cli, "Client disconnect");
+	}
+}
+
+/**
+ * @brief Accept up to ACCEPT_BUDGET pending connections. accept4() hands the
+ * socket over already non-blocking and close-on-exec. When the budget runs out
+ * the listener goes on accept_backlog_: with edge-triggered epoll nothing would
+ * tell us again about the connections still queued.
+ *
+ * The Server checks its user limit in onAccept(), before the socket is added to
+ * the interest set.
+ */
+void	ReadyLoop::acceptClients(EventHandler& handler, int listen_fd){
+	for (int n_accepted = 0; n_accepted < ACCEPT_BUDGET; n_accepted++){
+		sockaddr_storage client_addr;
+		socklen_t  clientLen = sizeof(client_addr);
+		int client_fd = accept4(listen_fd, reinterpret_cast<sockaddr*>(&client_addr),
+							&clientLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client_fd < 0) {
+			// No more pending connections
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return ;
+			}
+			// the connection died in the queue, take the next one
+			if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+				continue;
+			}
+			// out of fds or memory: the queue stays readable, stop asking
+			// until some is freed
+			if (isAcceptResourceError(errno)){
+				noteAcceptFailure(errno);
+				pauseListener(listen_fd);
+				return ;
+			}
+			Logger::log(Logger::WARNING, "accept failed: " + std::string(strerror(errno)));
+			return ;
+		}
+
+		noteAcceptSuccess();
+		tuneSocket(client_fd, client_addr.ss_family);
+		// a refused socket is already closed, keep draining the backlog
+		std::shared_ptr<Client>	cli = handler.onAccept(client_fd,
+			formatHost(client_fd, reinterpret_cast<sockaddr*>(&client_addr)));
+		if (!cli){
+			continue;
+		}
+		try {
+			auto	tls = tls_listeners_.find(listen_fd);
+			if (tls != tls_listeners_.end()){
+				cli->startTls(*tls->second);
+			}
+			addClient(cli);
+		} catch (std::exception& e){
+			Logger::log(Logger::ERROR, e.what());
+			handler.onDisconnect(*cli, "Internal error");
+		}
+	}
+	accept_backlog_.push_back(listen_fd);
+}
+
+/**
+ * @brief accept4() ran out of fds or memory. The listener stays readable, so
+ * it leaves the interest set instead of failing on every turn.
+ */
+void	ReadyLoop::pauseListener(int listen_fd){
+	unwatch(listen_fd);
+	paused_listeners_.push_back(listen_fd);
+}
+
+/**
+ * @brief Watch the paused listeners again. They go on accept_backlog_ as well:
+ * with edge-triggered epoll the connections already queued raise no new event.
+ */
+void	ReadyLoop::resumeListeners(){
+	for (int fd : paused_listeners_){
+		if (watch(fd, false, true)){
+			accept_backlog_.push_back(fd);
+		} else {
+			Logger::log(Logger::ERROR, "can't watch the listening socket again: "
+				+ std::string(strerror(errno)));
+		}
+	}
+	paused_listeners_.clear();
+}
+
+/**
+ * @brief Write the send queue, one sendmsg() for up to CLIENT_SEND_IOV replies,
+ * until it is empty or the socket is full. A short write means the socket is
+ * full, no need to wait for EAGAIN.
+ *
+ * @return
+ *  True, the queue is drained or the socket is full, the rest waits until the
+ *  socket is writable again;
+ *  False, the connection is broken.
+ */
+bool	ReadyLoop::writeClient(Client& cli){
+	if (TlsSession* tls = cli.getTls()){
+		if (!tls->isEstablished()){
+			return true; // nothing goes out before the handshake is done
+		}
+		if (!tls->isKtlsSend()){
+			return writeTlsClient(cli);
+		}
+	}
+	while (struct msghdr* msg = cli.prepareSendMsg()){
+		size_t	wanted = 0;
+		for (size_t i = 0; i < msg->msg_iovlen; i++){
+			wanted += msg->msg_iov[i].iov_len;
+		}
+		bool	zerocopy = cli.isZerocopy() && wanted >= zerocopy_min_;
+		int		flags = MSG_DONTWAIT | MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0);
+		ssize_t	n_bytes = sendmsg(cli.getSocketFd(), msg, flags);
+		stats_.send_calls++;
+		if (n_bytes < 0 && zerocopy && errno == ENOBUFS){
+			// too many pages pinned for the socket(optmem), copy this one
+			n_bytes = sendmsg(cli.getSocketFd(), msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+			stats_.send_calls++;
+			zerocopy = false;
+		}
+		if (n_bytes < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		if (zerocopy){
+			cli.holdForZerocopy(n_bytes);
+			stats_.zerocopy_sends++;
+			stats_.zerocopy_bytes += n_bytes;
+		}
+		recordSend(cli);
+		stats_.replies_sent += cli.consumeSent(n_bytes);
+		if (static_cast<size_t>(n_bytes) < wanted){
+			return true;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief writeClient() through the userspace TLS session: the queued replies are
+ * gathered into records of up to TLS_RECORD_SIZE bytes, one SSL_write() each.
+ * After a full socket the next call rebuilds the record from the queue, which
+ * starts with the same bytes, as SSL_write() wants for its retry.
+ */
+bool	ReadyLoop::writeTlsClient(Client& cli){
+	while (struct msghdr* msg = cli.prepareSendMsg()){
+		tls_record_.clear();
+		for (size_t i = 0; i < msg->msg_iovlen && tls_record_.size() < TLS_RECORD_SIZE; i++){
+			size_t	len = std::min(msg->msg_iov[i].iov_len, TLS_RECORD_SIZE - tls_record_.size());
+			tls_record_.append(static_cast<const char*>(msg->msg_iov[i].iov_base), len);
+		}
+		ssize_t	n_bytes = cli.getTls()->write(tls_record_.data(), tls_record_.size());
+		stats_.send_calls++;
+		if (n_bytes < 0){
+			return errno == EAGAIN;
+		}
+		recordSend(cli);
+		stats_.replies_sent += cli.consumeSent(n_bytes);
+	}
+	return true;
+}
+
+/**
+ * @brief Readiness on a TLS client still in its handshake: take it as far as the
+ * socket allows. Once established, what the client sent behind its Finished
+ * message is read right away, an edge-triggered epoll wouldn't report it
+ * again.
+ */
+void	ReadyLoop::continueHandshake(EventHandler& handler, const std::shared_ptr<Client>& cli){
+	TlsSession&	tls = *cli->getTls();
+	TLS_STATUS	status = tls.handshake();
+	if (status == TLS_STATUS::FAILED){
+		handler.onDisconnect(*cli, "TLS handshake failed");
+		return;
+	}
+	updateInterest(*cli);
+	if (status == TLS_STATUS::WANT_IO){
+		return;
+	}
+	stats_.tls_handshakes++;
+	stats_.tls_resumed += tls.isResumed();
+	stats_.tls_ktls += tls.isKtlsSend();
+	readClient(handler, cli);
+}
+
+/**
+ * @brief Keep the write interest of the client in sync with its send queue: it
+ * is registered only while there is something left to write(or the TLS
+ * handshake waits for room).
+ */
+void	ReadyLoop::updateInterest(Client& cli){
+	bool	want_write = cli.wantsWrite();
+	if (want_write == cli.isWriteArmed()){
+		return;
+	}
+	if (!watch(cli.getSocketFd(), want_write, false)){
+		Logger::log(Logger::WARNING, "Failed to update the events of client "
+			+ std::to_string(cli.getSocketFd()) + ": " + strerror(errno));
+		return;
+	}
+	cli.setWriteArmed(want_write);
+}
+
+/**
+ * @brief Read the MSG_ZEROCOPY completions queued on the client's error queue
+ * and release the messages of the sends they cover. When the kernel had to copy
+ * anyway(e.g. loopback, or a device without scatter-gather), zerocopy only adds
+ * cost for this socket: its next sends are plain ones.
+ *
+ * @return
+ *  True, only completions were queued;
+ *  False, the socket has a real error.
+ */
+bool	ReadyLoop::readZerocopyCompletions(Client& cli){
+	while (true){
+		char			control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+		struct msghdr	msg{};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(cli.getSocketFd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			break; // EAGAIN, the queue is empty
+		}
+		for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)){
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+				&& !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)){
+				continue;
+			}
+			const struct sock_extended_err*	ee
+				= reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+			if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY || ee->ee_errno != 0){
+				return false;
+			}
+			// ee_info..ee_data: the ids of the completed sends
+			cli.releaseZerocopy(ee->ee_info, ee->ee_data);
+			if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED){
+				stats_.zerocopy_copied++;
+				cli.setZerocopy(false);
+			}
+		}
+	}
+	int			sock_error = 0;
+	socklen_t	len = sizeof(sock_error);
+	getsockopt(cli.getSocketFd(), SOL_SOCKET, SO_ERROR, &sock_error, &len);
+	return sock_error == 0;
+}
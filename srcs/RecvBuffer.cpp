@@ -0,0 +1,279 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RecvBuffer.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/28 10:12:40 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/28 10:12:40 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "RecvBuffer.hpp"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#if defined(__x86_64__)
+# include <immintrin.h>
+#endif
+
+namespace {
+
+using FindLf = const char* (*)(const char* data, size_t len);
+
+const char*	findLfScalar(const char* data, size_t len){
+	for (size_t i = 0; i < len; i++){
+		if (data[i] == '\n'){
+			return data + i;
+		}
+	}
+	return nullptr;
+}
+
+#if defined(__x86_64__)
+// SSE2 is part of x86-64: compare 16 bytes at once, the mask has a bit per LF
+const char*	findLfSse2(const char* data, size_t len){
+	const __m128i	lf = _mm_set1_epi8('\n');
+	size_t			i = 0;
+
+	for (; i + 16 <= len; i += 16){
+		__m128i	chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		int		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf));
+		if (mask != 0){
+			return data + i + __builtin_ctz(mask);
+		}
+	}
+	return findLfScalar(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+const char*	findLfAvx2(const char* data, size_t len){
+	const __m256i	lf = _mm256_set1_epi8('\n');
+	size_t			i = 0;
+
+	for (; i + 32 <= len; i += 32){
+		__m256i		chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		uint32_t	mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, lf));
+		if (mask != 0){
+			return data + i + __builtin_ctz(mask);
+		}
+	}
+	return findLfSse2(data + i, len - i);
+}
+#endif
+
+// the widest search the CPU runs, picked once at startup
+FindLf	pickFindLf(){
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")){
+		return findLfAvx2;
+	}
+	return findLfSse2;
+#else
+	return findLfScalar;
+#endif
+}
+
+const FindLf	find_lf = pickFindLf();
+
+} // namespace
+
+RecvBuffer::RecvBuffer() : next_size_(RECV_BUFFER_MIN), head_(0), tail_(0), scanned_(0),
+	line_len_(0){}
+
+RecvBuffer::RecvBuffer(const RecvBuffer& other) : RecvBuffer(){
+	*this = other;
+}
+
+RecvBuffer&	RecvBuffer::operator=(const RecvBuffer& other){
+	if (this != &other){
+		release();
+		std::string	data = other.contents();
+		append(data.data(), data.size());
+	}
+	return *this;
+}
+
+size_t	RecvBuffer::size() const{
+	return tail_ - head_;
+}
+
+bool	RecvBuffer::empty() const{
+	return head_ == tail_;
+}
+
+size_t	RecvBuffer::capacity() const{
+	return buf_.size();
+}
+
+size_t	RecvBuffer::room() const{
+	return capacity() - size();
+}
+
+/**
+ * @brief Make room for at least n_bytes more. The capacity doubles until they
+ * fit and the data is moved to the start of the new ring.
+ */
+void	RecvBuffer::reserve(size_t n_bytes){
+	if (room() >= n_bytes){
+		return;
+	}
+	size_t	cap = capacity() > 0 ? capacity() : next_size_;
+	while (cap - size() < n_bytes){
+		cap *= 2;
+	}
+	PoolBuffer	bigger(cap);
+	size_t	len = size();
+	copyOut(bigger.data(), len);
+	buf_ = std::move(bigger);
+	head_ = 0;
+	tail_ = len;
+	next_size_ = std::min<size_t>(cap, RECV_BUFFER_KEEP);
+}
+
+/**
+ * @brief Give the chunk back to the pool, the buffer is empty.
+ */
+void	RecvBuffer::release(){
+	buf_.reset();
+	std::string().swap(wrapped_);
+	head_ = tail_ = 0;
+	scanned_ = line_len_ = 0;
+}
+
+/**
+ * @brief Copy the first len bytes of the data, which may wrap around the end
+ * of the ring, into dst.
+ */
+void	RecvBuffer::copyOut(char* dst, size_t len) const{
+	if (len == 0){
+		return;
+	}
+	size_t	start = head_ & (capacity() - 1);
+	size_t	first = std::min(len, capacity() - start);
+	std::memcpy(dst, buf_.data() + start, first);
+	std::memcpy(dst + first, buf_.data(), len - first);
+}
+
+/**
+ * @brief Describe the free room for a read of at most max bytes: one span, or
+ * two when it wraps around the end of the ring. A full ring grows first, so
+ * at least min(max, RECV_BUFFER_MIN) bytes are offered. An empty ring starts
+ * over at its beginning(one span).
+ *
+ * @return the bytes offered, n_iov is set to the number of spans used
+ */
+size_t	RecvBuffer::prepareRead(struct iovec iov[2], int& n_iov, size_t max){
+	if (empty()){
+		head_ = tail_ = 0;
+	}
+	reserve(std::min<size_t>(max, RECV_BUFFER_MIN));
+	size_t	len = std::min(max, room());
+	size_t	start = tail_ & (capacity() - 1);
+	size_t	first = std::min(len, capacity() - start);
+
+	iov[0].iov_base = buf_.data() + start;
+	iov[0].iov_len = first;
+	iov[1].iov_base = buf_.data();
+	iov[1].iov_len = len - first;
+	n_iov = len > first ? 2 : 1;
+	return len;
+}
+
+/**
+ * @brief A read wrote n_bytes into the room given by prepareRead().
+ */
+void	RecvBuffer::commit(size_t n_bytes){
+	tail_ += n_bytes;
+}
+
+/**
+ * @brief Copy in data received some other way(io_uring's provided buffers,
+ * the state handed over by a hot restart).
+ */
+void	RecvBuffer::append(const char* data, size_t len){
+	struct iovec	iov[2];
+	int				n_iov;
+
+	while (len > 0){
+		size_t	n_bytes = prepareRead(iov, n_iov, len);
+		std::memcpy(iov[0].iov_base, data, iov[0].iov_len);
+		std::memcpy(iov[1].iov_base, data + iov[0].iov_len, iov[1].iov_len);
+		commit(n_bytes);
+		data += n_bytes;
+		len -= n_bytes;
+	}
+}
+
+/**
+ * @brief A whole line is waiting. Only the bytes that arrived since the last
+ * call are scanned.
+ */
+bool	RecvBuffer::hasLine() const{
+	if (line_len_ > 0){
+		return true;
+	}
+	while (scanned_ < size()){
+		// search the contiguous part of the ring that follows
+		size_t		start = (head_ + scanned_) & (capacity() - 1);
+		size_t		len = std::min(size() - scanned_, capacity() - start);
+		const char*	span = buf_.data() + start;
+		const char*	lf = find_lf(span, len);
+
+		if (lf != nullptr){
+			line_len_ = scanned_ + (lf - span) + 1;
+			scanned_ = line_len_;
+			return true;
+		}
+		scanned_ += len;
+	}
+	return false;
+}
+
+/**
+ * @brief Take the next line out, its terminator(CRLF or LF) included. The
+ * view points into the ring, or into wrapped_ when the line wraps around.
+ *
+ * @return false when no whole line is waiting. Once everything was taken out
+ * the chunk goes back to the pool then.
+ */
+bool	RecvBuffer::nextLine(std::string_view& line){
+	if (!hasLine()){
+		if (empty()){
+			release();
+		}
+		return false;
+	}
+	size_t	start = head_ & (capacity() - 1);
+	if (start + line_len_ <= capacity()){
+		line = std::string_view(buf_.data() + start, line_len_);
+	} else {
+		wrapped_.resize(line_len_);
+		copyOut(&wrapped_[0], line_len_);
+		line = wrapped_;
+	}
+	head_ += line_len_;
+	scanned_ = 0;
+	line_len_ = 0;
+	return true;
+}
+
+/**
+ * @brief Memory held for the client, 0 while it is idle.
+ */
+size_t	RecvBuffer::getBufferBytes() const{
+	return capacity() + (wrapped_.empty() ? 0 : wrapped_.capacity());
+}
+
+/**
+ * @brief Everything not taken out yet, complete lines and the start of the
+ * next one.
+ */
+std::string	RecvBuffer::contents() const{
+	std::string	data(size(), '\0');
+
+	copyOut(&data[0], data.size());
+	return data;
+}
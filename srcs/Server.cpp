@@ -15,12 +15,11 @@
 /**
  * Parsing the parameters and initilize the pass and port variables
  */
-Server::Server(std::string port, std::string password){
+Server::Server(std::string port, std::string password, const ServerConfig& config)
+	: config_(config){
 	// 1. parsing for port
-	for (auto it : port){
-		if (!isdigit(it)){
-			throw std::invalid_argument("Error: non-digit character found in port");
-		}
+	if (!allIn(port, DIGIT_CHARS)){
+		throw std::invalid_argument("Error: non-digit character found in port");
 	}
 	int port_num;
 	try{
@@ -36,83 +35,63 @@ Server::Server(std::string port, std::string password){
 	if (password.size() < 4 || password.size() > 20){
 		throw std::overflow_error("Error: password should be 4~20 characters");
 	}
-	// if we don't cast the c to unsigned char, it can crash with UTF-8
-	for (auto c : password){
-		if (!isalnum(static_cast<unsigned char>(c))
-			&& std::string(SPECIAL_CHARS_PASSWD).find(c) == std::string::npos){
-			throw std::invalid_argument("Error: invalid character in password: '"
-				+ std::string(1,c) + "'\n" + PASSWORD_RULE);
-		}
+	size_t	bad = findFirstNotIn(password, PASSWORD_CHARS);
+	if (bad != std::string::npos){
+		throw std::invalid_argument("Error: invalid character in password: '"
+			+ std::string(1, password[bad]) + "'\n" + PASSWORD_RULE);
 	}
 	serv_port_ = port_num;
 	serv_passwd_ = password;
-	epoll_fd_ = epoll_create1(0);
-	if (epoll_fd_ == -1){
-		throw std::runtime_error("Error: epoll_create1 failed");
+	// --listen: the addresses without a port take <port>(TLS ones 6697), no
+	// --listen is <port> on every address, next to the --tls-listen ones
+	// and --unix-listen ones
+	bool	plain = false;
+	for (const ListenAddress& addr : config_.listeners){
+		plain = plain || (!addr.tls && !addr.isUnix());
+	}
+	if (!plain){
+		config_.listeners.insert(config_.listeners.begin(), {"*", 0, false, ""});
+	}
+	for (ListenAddress& addr : config_.listeners){
+		if (addr.port == 0 && !addr.isUnix()){
+			addr.port = addr.tls ? TLS_DEFAULT_PORT : serv_port_;
+		}
 	}
 	n_channel_ = 0;
 	n_user_ = 0;
+	handoff_fd_ = -1;
+	// responseToClient() is static (Channel calls it too), it reaches the
+	// workers through this pointer
+	server_ = this;
 }
 
 Server*	Server::server_ = nullptr;
 
-volatile sig_atomic_t	Server::keep_running_ = 1;
-
-
+std::atomic<int>	Server::keep_running_{1};
 
-/**
- * @brief Define the commands that an unregistered client can execute. Currenctly
- * set to PASS, NICK, USER and QUIT
- */
-const std::set<COMMANDTYPE> Server::pre_registration_allowed_commands_ = {
-	PASS,
-	NICK,
-	USER,
-	CAP,
-	PING,
-	WHOIS,
-	WHO,
-	QUIT
-};
+std::atomic<int>	Server::upgrade_requested_{0};
+std::atomic<EventLoop*>	Server::signal_loop_{nullptr};
 
-/**
- * @brief Define the commands that only an operator can execute. Currenctly
- * set to: KICK, INVITE and MODE
- */
-const std::set<COMMANDTYPE> Server::operator_commands_ = {
-	KICK,
-	INVITE,
-	MODE
-};
-
-/**
- * @brief Setup the map for commands and execute functions
- */
-const std::unordered_map<COMMANDTYPE, Server::executeFunc> Server::execute_map_ = {
-	{PASS, &Server::passCommand},
-	{NICK, &Server::nickCommand},
-	{USER, &Server::userCommand},
-	{PRIVMSG, &Server::privmsgCommand},
-	{JOIN, &Server::joinCommand},
-	{PART, &Server::partCommand},
-	{KICK, &Server::kickUser},
-	{INVITE, &Server::inviteUser},
-	{TOPIC, &Server::topic},
-	{MODE, &Server::mode},
-	{CAP, &Server::capCommand},
-	{PING, &Server::pingCommand},
-	{WHOIS, &Server::whoisCommand},
-	{WHO, &Server::whoCommand},
-	{QUIT, &Server::quitCommand}
-};
+thread_local Worker*	Server::current_worker_ = nullptr;
 
 
 Server::~Server(){
+	if (server_ == this){
+		server_ = nullptr;
+	}
 }
 
 void	Server::signalHandler(int signum){
 	if (signum == SIGINT || signum == SIGTERM){
 		Server::keep_running_ = 0;
+	} else if (signum == SIGUSR2){
+		Server::upgrade_requested_ = 1;
+	}
+	// a signal landing while worker 0 spins(--busy-poll) or right before its
+	// wait interrupts no syscall: the eventfd write(async-signal-safe) ends the
+	// wait
+	if (EventLoop* loop = signal_loop_){
+		loop->wake();
 	}
 }
 
@@ -123,9 +102,178 @@ void	Server::setupSignalHandlers(){
 	sa.sa_flags = 0;
 	sigaction(SIGINT, &sa, NULL);
 	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGUSR2, &sa, NULL);
 	signal(SIGPIPE, SIG_IGN);
 }
 
+/**
+ * @brief Load the certificate when there are TLS listeners. The handshakes run in
+ * the readiness loops, io_uring gives way to edge-triggered epoll.
+ */
+void	Server::setupTls(){
+	bool	with_tls = false;
+	for (const ListenAddress& addr : config_.listeners){
+		with_tls = with_tls || addr.tls;
+	}
+	if (!with_tls){
+		return;
+	}
+	if (config_.tls_cert.empty()){
+		throw std::invalid_argument("Error: --tls-listen needs --tls-cert");
+	}
+	tls_ = std::make_unique<TlsContext>(config_.tls_cert,
+		config_.tls_key.empty() ? config_.tls_cert : config_.tls_key, config_.ktls);
+	if (config_.backend == BACKEND::URING){
+		Logger::log(Logger::WARNING, "TLS listeners need a readiness loop, using epoll-et");
+		config_.backend = BACKEND::EPOLL_ET;
+	}
+}
+
+/**
+ * @brief Create the listening sockets and the event loop of one worker.
+ *
+ * @param adopted: listening sockets handed over by a hot restart, the ones
+ * bound to our addresses are taken instead of new sockets
+ */
+void	Server::setupWorker(Worker& w, std::vector<int>& adopted){
+	w.loop = EventLoop::create(config_.backend);
+	// every listener gets its own accept budget per turn
+	for (const ListenAddress& addr : config_.listeners){
+		if (addr.isUnix() && w.id != 0){
+			continue;
+		}
+		int	fd = takeListener(adopted, addr);
+		w.listen_fds.push_back(fd != -1 ? fd : setupServSocket(addr));
+		if (addr.isUnix()){
+			unix_paths_.push_back(addr.path);
+		}
+		Logger::log(Logger::INFO, "Worker " + std::to_string(w.id) + " listening on "
+			+ addr.toString() + (addr.tls ? " (TLS)" : ""));
+		if (!addr.tls){
+			w.loop->addListener(w.listen_fds.back());
+		} else if (!w.loop->addTlsListener(w.listen_fds.back(), *tls_)){
+			throw std::runtime_error(std::string("Error: TLS is not supported by ")
+				+ w.loop->getName());
+		}
+	}
+	w.loop->startTimer(TIMER_TICK_MS);
+	if (config_.busy_poll_usec > 0){
+		w.loop->enableBusyPoll(config_.busy_poll_usec);
+	}
+	w.loop->setNotsentLowat(config_.notsent_lowat);
+	Logger::log(Logger::INFO, "Worker " + std::to_string(w.id) + " uses " + w.loop->getName());
+	if (config_.zerocopy_min > 0 && !w.loop->enableZerocopy(config_.zerocopy_min)){
+		Logger::log(Logger::WARNING, std::string("--zerocopy is not supported by ")
+			+ w.loop->getName() + ", replies are copied");
+	}
+}
+
+/**
+ * @brief The socket address of a listener. "*" is the IPv6 wildcard, which
+ * takes the IPv4 connections too(IPV6_V6ONLY off), or the IPv4 one(family
+ * AF_INET) on a host without IPv6. A Unix socket's length is the one
+ * getsockname() gives back: up to the path's '\0'.
+ */
+static socklen_t	listenSockaddr(const ListenAddress& addr, int family, sockaddr_storage& sa){
+	memset(&sa, 0, sizeof(sa)); // zero out everyting before use
+	if (family == AF_UNIX){
+		sockaddr_un&	sun = reinterpret_cast<sockaddr_un&>(sa);
+		sun.sun_family = AF_UNIX;
+		memcpy(sun.sun_path, addr.path.c_str(), addr.path.size());
+		return offsetof(sockaddr_un, sun_path) + addr.path.size() + 1;
+	}
+	if (family == AF_INET){
+		sockaddr_in&	sin = reinterpret_cast<sockaddr_in&>(sa);
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(addr.port);
+		if (addr.host == "*"){
+			sin.sin_addr.s_addr = INADDR_ANY;
+		} else {
+			inet_pton(AF_INET, addr.host.c_str(), &sin.sin_addr);
+		}
+		return sizeof(sin);
+	}
+	sockaddr_in6&	sin6 = reinterpret_cast<sockaddr_in6&>(sa);
+	sin6.sin6_family = AF_INET6;
+	sin6.sin6_port = htons(addr.port);
+	if (addr.host == "*"){
+		sin6.sin6_addr = in6addr_any;
+	} else {
+		inet_pton(AF_INET6, addr.host.c_str(), &sin6.sin6_addr);
+	}
+	return sizeof(sin6);
+}
+
+static int	listenFamily(const ListenAddress& addr){
+	if (addr.isUnix()){
+		return AF_UNIX;
+	}
+	if (addr.host == "*" || addr.host.find(':') != std::string::npos){
+		return AF_INET6;
+	}
+	return AF_INET;
+}
+
+/**
+ * @brief Find in adopted a listening socket bound to addr and take it out.
+ *
+ * @return the socket, -1 when there is none
+ */
+int	Server::takeListener(std::vector<int>& adopted, const ListenAddress& addr){
+	for (auto it = adopted.begin(); it != adopted.end(); ++it){
+		sockaddr_storage	bound;
+		socklen_t			len = sizeof(bound);
+		if (getsockname(*it, reinterpret_cast<sockaddr*>(&bound), &len) == -1){
+			continue;
+		}
+		sockaddr_storage	want;
+		socklen_t			want_len = listenSockaddr(addr, bound.ss_family, want);
+		int					v6only = 0;
+		socklen_t			opt_len = sizeof(v6only);
+		if (bound.ss_family == AF_INET6){
+			getsockopt(*it, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, &opt_len);
+		}
+		if ((bound.ss_family == listenFamily(addr) || addr.host == "*")
+			&& len == want_len && memcmp(&bound, &want, want_len) == 0
+			&& v6only == (bound.ss_family == AF_INET6 && addr.host != "*")){
+			int	fd = *it;
+			adopted.erase(it);
+			// --backlog may have changed
+			listen(fd, config_.backlog);
+			return fd;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief The Unix socket file is in use: remove it when nobody listens on it
+ * any more(connect() refused), never when another server still does or when
+ * it isn't a socket.
+ *
+ * @return true when the file was removed
+ */
+static bool	removeStaleSocket(const sockaddr* addr, socklen_t len){
+	const char*	path = reinterpret_cast<const sockaddr_un*>(addr)->sun_path;
+	struct stat	st;
+	if (lstat(path, &st) == -1 || !S_ISSOCK(st.st_mode)){
+		errno = EADDRINUSE;
+		return false;
+	}
+	int	probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (probe == -1){
+		return false;
+	}
+	bool	stale = connect(probe, addr, len) == -1 && errno == ECONNREFUSED;
+	close(probe);
+	if (!stale){
+		errno = EADDRINUSE;
+		return false;
+	}
+	Logger::log(Logger::WARNING, std::string("Removing the stale socket file ") + path);
+	return unlink(path) == 0;
+}
+
 /**
  * Stages for Server
  * 	The server is created using the following steps:
@@ -133,205 +281,414 @@ void	Server::setupSignalHandlers(){
  * 		2) Setsockopt;;
  * 		3) Bind;
  * 		4) Listen;
+ *
+ * Every worker calls it for every address and gets its own listening socket,
+ * SO_REUSEPORT lets the kernel balance the new connections between them. A
+ * Unix socket is created once(worker 0) and needs no option.
+ *
+ * @return the listening socket
  */
-void	Server::setupServSocket(){
+int	Server::setupServSocket(const ListenAddress& addr){
 	// 1. Socket createtion
 	Logger::log(Logger::INFO, "initServer::Socket createtion ");
-	serv_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-	if (serv_fd_ == -1){
+	// non-blocking from the start, the event loop registers it for read
+	int	family = listenFamily(addr);
+	int	fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1 && addr.host == "*" && errno == EAFNOSUPPORT){
+		family = AF_INET;
+		fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	}
+	if (fd == -1){
 		throw std::runtime_error("Error: failed to create socket for the server");
 	}
-	// 2. enable port reuse
-	int opt = 1;
-	// pass the value of opt to "const void* optval", in this case it is "SO_REUSEADDR"
-	// or "SO_REUSEPORT", when the value is 1, it means turn it on; when the value is '0'
-	// it means turn it off
-	Logger::log(Logger::INFO, "initServer::Set socket option");
-	if (setsockopt(serv_fd_, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt,
-				sizeof(opt)) < 0){
-		throw std::runtime_error("Error: setsockopt");
-	}
-	// 3. Bind to all the avaiable IPs and server port
-	Logger::log(Logger::INFO, "initServer::Binding on port " + std::to_string(serv_port_));
-	memset(&serv_addr_, 0, sizeof(serv_addr_)); // zero out everyting before use
-	serv_addr_.sin_family = AF_INET;
-	serv_addr_.sin_addr.s_addr = INADDR_ANY;
-	serv_addr_.sin_port = htons(this->serv_port_);
-	if (bind(serv_fd_, (sockaddr*)&serv_addr_, sizeof(serv_addr_)) < 0){
-		throw std::runtime_error("Error: bind failed");
-	}
-	// 4. listen, the backlog number(now set to 10) can be changed based on the
-	// performance during testing
-	// After do listen(fd, backlog), now the "fd" become a listening fd.
-	if (listen(serv_fd_, 10) == -1){
-		throw std::runtime_error("Error: something wrong happended on listen");
-	}
-
-	// 5. register listeing socket for read(EPOLLIN)
-	int flags = fcntl(serv_fd_, F_GETFL, 0);
-	fcntl(serv_fd_, F_SETFL, flags | O_NONBLOCK);
-
-	struct epoll_event ev{};
-	// EPOLLIN for read events + EPOLLET for edge-triggered
-	ev.events = EPOLLIN | EPOLLET;
-	ev.data.fd = serv_fd_;
-	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, serv_fd_, &ev) == -1){
-		throw std::runtime_error("Error: epoll_ctl ADD listen_fd failed");
-	}
-	// prepare event buffer
-	events_.resize(MAX_EVENTS);
-
-	// add log message
-	Logger::log(Logger::INFO, "Server listening on port " + std::to_string(serv_port_));
+	try {
+		// 2. enable port reuse
+		int opt = 1;
+		// pass the value of opt to "const void* optval", in this case it is "SO_REUSEADDR"
+		// or "SO_REUSEPORT", when the value is 1, it means turn it on; when the value is '0'
+		// it means turn it off. They are two different options, so they are set one by one
+		// (OR-ing the names together is just another option number).
+		// IPV6_V6ONLY: an IPv6 address only takes IPv6, except the "*" wildcard
+		Logger::log(Logger::INFO, "initServer::Set socket option");
+		int	v6only = addr.host != "*";
+		if (family != AF_UNIX
+			&& (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0
+			|| setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0
+			|| (family == AF_INET6
+				&& setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) < 0))){
+			throw std::runtime_error("Error: setsockopt");
+		}
+		// 3. Bind to the address and port. A socket file left by a server that
+		// didn't shut down cleanly is replaced
+		Logger::log(Logger::INFO, "initServer::Binding on " + addr.toString());
+		sockaddr_storage	serv_addr;
+		socklen_t			addr_len = listenSockaddr(addr, family, serv_addr);
+		sockaddr*			sa = reinterpret_cast<sockaddr*>(&serv_addr);
+		if (bind(fd, sa, addr_len) < 0 && !(family == AF_UNIX && errno == EADDRINUSE
+			&& removeStaleSocket(sa, addr_len) && bind(fd, sa, addr_len) == 0)){
+			throw std::runtime_error("Error: bind " + addr.toString() + " failed: "
+				+ strerror(errno));
+		}
+		// 4. listen, the backlog(--backlog) holds the connections the loop hasn't
+		// accepted yet. After a restart every client reconnects at once, a short
+		// queue drops their SYNs and they retry only seconds later.
+		// After do listen(fd, backlog), now the "fd" become a listening fd.
+		if (listen(fd, config_.backlog) == -1){
+			throw std::runtime_error("Error: something wrong happended on listen");
+		}
+	} catch (...){
+		close(fd);
+		throw;
+	}
+	return fd;
 }
 
+/**
+ * @brief Start config_.n_workers event loops. Worker 0 runs in the calling thread,
+ * the others get their own thread. SIGINT/SIGTERM/SIGUSR2 are blocked in the
+ * extra threads so the signal always interrupts worker 0, which then wakes the
+ * others.
+ *
+ * Started by a hot restart(config_.handoff_fd), the listening sockets, the
+ * clients and the channels come from the old process instead. When we hand
+ * over ourselves, the sockets are only closed after the new process took them.
+ */
 void	Server::startServer(){
 	setupSignalHandlers();
-	setupServSocket();
-	while (keep_running_){
-		// Wait indefinitely for events
-		// the return value of epoll_wait():
-		// > 0  Number of file descriptors that are ready for the requested I/O.
-		// =0   Timeout occurred — no file descriptors were ready
-		// < 0  Error occurred — check errno for the specific error cause.
-		int nready = epoll_wait(epoll_fd_, events_.data(), events_.size(), -1);
-		if (nready < 0){
-			if (errno == EINTR){
-				continue; // restart on signal
+	setupTls();
+	SlabPool::setHugePages(config_.huge_pages);
+	for (int i = 0; i < config_.n_workers; i++){
+		workers_.push_back(std::make_unique<Worker>(i));
+	}
+	try {
+		if (config_.handoff_fd != -1){
+			restoreState(config_.handoff_fd);
+		} else {
+			std::vector<int>	no_sockets;
+			for (auto& w : workers_){
+				setupWorker(*w, no_sockets);
 			}
-			throw std::runtime_error("Error:" + std::string("epoll_wait: ") + strerror(errno));
 		}
-		for (int i = 0; i < nready; i++){
-			int		fd = events_[i].data.fd;
-			auto	evs = events_[i].events;
-			// 1) new connections on listening socket, accept it
-			if (fd == serv_fd_){
-				acceptNewClient();
-				Logger::log(Logger::DEBUG, "Active clients: " +
-							std::to_string(clients_.size()));
-				continue;
-			}
-			// 2) check for error or hang-up
-			else if (evs & (EPOLLERR | EPOLLHUP)){
-				removeClient(*(clients_.find(fd)->second), "disconnected");
-				Logger::log(Logger::INFO, "one client is disoneccted:" + std::to_string(fd));
-				continue;
-			}
-			// 3) date to read
-			else if (evs & EPOLLIN){
+		sigset_t	block_set;
+		sigset_t	old_set;
+		sigemptyset(&block_set);
+		sigaddset(&block_set, SIGINT);
+		sigaddset(&block_set, SIGTERM);
+		sigaddset(&block_set, SIGUSR2);
+		pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+		for (size_t i = 1; i < workers_.size(); i++){
+			Worker&	w = *workers_[i];
+			w.thread = std::thread([this, &w](){
 				try {
-					processDataFromClient(i);
-				}catch (std::invalid_argument& e){
-					Logger::log(Logger::WARNING, e.what());
+					runWorker(w);
 				} catch (std::exception& e){
-					Logger::log(Logger::ERROR, e.what());
+					Logger::log(Logger::ERROR, "Worker " + std::to_string(w.id) + ": " + e.what());
+					keep_running_ = 0;
+					workers_[0]->loop->wake();
 				}
-			}
+			});
+		}
+		pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+		signal_loop_ = workers_[0]->loop.get();
+		runWorker(*workers_[0]);
+		stopWorkers();
+		if (handoff_fd_ != -1){
+			handOver();
 		}
+	} catch (...){
+		stopWorkers();
+		cleanServer();
+		throw;
 	}
 	cleanServer();
 	return;
 }
 
+/**
+ * @brief The event loop of one worker. It only touches the sockets it owns; any
+ * access to the shared IRC state goes through state_mutex_.
+ */
+void	Server::runWorker(Worker& w){
+	current_worker_ = &w;
+	while (keep_running_){
+		// wait and dispatch one batch, the loop calls back the on*() handlers
+		w.loop->runOnce(*this);
+		// drop the clients whose send queue overflowed or broke during this round
+		reapClients(w);
+		// the signal handler only raises the flag, worker 0 gets it
+		if (w.id == 0 && upgrade_requested_.exchange(0)){
+			startUpgrade();
+		}
+	}
+	// a new process takes over: leave nothing in flight in the kernel
+	if (handoff_fd_ != -1){
+		w.loop->quiesce(*this);
+		reapClients(w);
+	}
+	current_worker_ = nullptr;
+}
+
+/**
+ * @brief Ask every extra worker to leave its loop and wait for it.
+ */
+void	Server::stopWorkers(){
+	keep_running_ = 0;
+	for (auto& w : workers_){
+		if (w->thread.joinable()){
+			w->loop->wake();
+		}
+	}
+	for (auto& w : workers_){
+		if (w->thread.joinable()){
+			w->thread.join();
+		}
+	}
+}
+
 void	Server::cleanServer(){
 	Logger::log(Logger::INFO, "Shutting down Server");
+	// memory of the connections: an idle one(nothing received or queued)
+	// should hold no buffer at all
+	size_t	n_idle = 0;
+	size_t	idle_bytes = 0;
+	size_t	buffer_bytes = 0;
 	for (auto const& [fd, cli] : clients_) {
-		epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+		size_t	held = cli->getBufferBytes();
+		buffer_bytes += held;
+		if (!cli->hasPendingOutput() && cli->getRawData().empty()){
+			n_idle++;
+			idle_bytes += held;
+		}
 		close(fd);
 	}
+	signal_loop_ = nullptr;
+	LatencyHistogram	relay_latency;
+	for (auto& w : workers_){
+		w->mailbox.clear();
+		w->pending_removals.clear();
+		// the I/O counters, printed whatever the LOG_LEVEL(the benchmarks read them)
+		if (w->loop){
+			const IoStats&	stats = w->loop->getStats();
+			relay_latency.merge(stats.relay_latency);
+			std::cout << "Worker " << w->id << " stats: " << stats.replies_sent
+				<< " replies in " << stats.send_calls << " send calls";
+			if (stats.zerocopy_sends > 0){
+				std::cout << ", " << stats.zerocopy_sends << " zerocopy sends ("
+					<< stats.zerocopy_bytes << " bytes, " << stats.zerocopy_copied
+					<< " copied by the kernel)";
+			}
+			if (stats.tls_handshakes > 0){
+				std::cout << ", " << stats.tls_handshakes << " TLS handshakes ("
+					<< stats.tls_resumed << " resumed, " << stats.tls_ktls << " kTLS)";
+			}
+			if (config_.busy_poll_usec > 0){
+				std::cout << ", " << stats.busy_poll_hits << " waits served spinning, "
+					<< stats.sleeps << " sleeping";
+			}
+			std::cout << std::endl;
+		}
+		// closing an io_uring cancels what is still in flight
+		w->loop.reset();
+		for (int fd : w->listen_fds){
+			close(fd);
+		}
+	}
+	if (relay_latency.n_samples > 0){
+		char	percentiles[64];
+		snprintf(percentiles, sizeof(percentiles), "p50 %.1f us, p99 %.1f us",
+			relay_latency.percentile(0.5) / 1000.0, relay_latency.percentile(0.99) / 1000.0);
+		std::cout << "Relay latency: " << percentiles << " (" << relay_latency.n_samples
+			<< " send calls, " << (config_.busy_poll_usec > 0 ? "busy-poll" : "sleeping")
+			<< " loops)" << std::endl;
+	}
+	if (!clients_.empty()){
+		std::cout << "Connection buffers: " << buffer_bytes << " bytes for " << clients_.size()
+			<< " clients, " << (n_idle > 0 ? idle_bytes / n_idle : 0) << " bytes per idle client ("
+			<< n_idle << " idle, Client object " << sizeof(Client) << " bytes), "
+			<< SlabPool::getReservedBytes() / 1024 << " KB of slabs" << std::endl;
+	}
+	for (const std::string& path : unix_paths_){
+		unlink(path.c_str());
+	}
+	unix_paths_.clear();
+	workers_.clear();
 	clients_.clear();
-	close(epoll_fd_);
-	close(serv_fd_);
+	nicks_.clear();
+	channels_.clear();
 }
 
 /**
- * @brief This function will accept all the pending connections at once.
+ * @brief Create the Client of a freshly accepted socket and add it to the shared
+ * client map and to the worker. If the server is full, the socket is answered
+ * and closed instead.
+ *
+ * @return the new client, nullptr when it was rejected
  */
-void	Server::acceptNewClient(){
-	// Process all pending connections at once before processing other events
-	while (true) {
-        sockaddr_in client_addr;
-        socklen_t  clientLen = sizeof(client_addr);
-        int client_fd = accept(serv_fd_,
-                               reinterpret_cast<sockaddr*>(&client_addr),
-                               &clientLen);
-        if (client_fd < 0) {
-            // No more pending connections
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                return ;
-            }
-            // real errors
-            throw std::runtime_error("accept failed: " + std::string(strerror(errno)));
-        }
-
-		// get the host information
-		char host[INET_ADDRSTRLEN];
-		inet_ntop(AF_INET, &client_addr.sin_addr, host, INET_ADDRSTRLEN);
-
-        // setting non-blockning mode
-        int flags = fcntl(client_fd, F_GETFL, 0);
-        fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-
-        // Register new client into epoll
-        epoll_event ev{};
-        ev.events = EPOLLIN;
-        ev.data.fd = client_fd;
-        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
-            close(client_fd);
-			cleanServer();
-            throw std::runtime_error("epoll_ctl ADD client failed");
-        }
-		// checking if the server has reached its user maximum
-		if (n_user_ >= SERVER_USER_LIMIT){
-			std::string response = "Server has reached its user maximum";
-			// send the error response to the fd
-			int	n_bytes = send(client_fd, response.c_str(), response.length(), MSG_DONTWAIT);
-			if (n_bytes < 0){
-				Logger::log(Logger::WARNING, "Failed to send data to user " + std::to_string(client_fd) +
-				": " + response);
-			} else {
-				Logger::log(Logger::DEBUG, "Sent successfully "+ std::to_string(client_fd) + ": " + response);
-			}
-			Logger::log(Logger::ERROR, "Server has reached its user maximum");
-			close(client_fd);
-			return;
+std::shared_ptr<Client>	Server::registerClient(Worker& w, int client_fd, const std::string& host){
+	std::lock_guard<std::mutex>	lock(state_mutex_);
+	// checking if the server has reached its user maximum
+	if (n_user_ >= SERVER_USER_LIMIT){
+		std::string response = "Server has reached its user maximum";
+		// send the error response to the fd
+		int	n_bytes = send(client_fd, response.c_str(), response.length(), MSG_DONTWAIT);
+		if (n_bytes < 0){
+			Logger::log(Logger::WARNING, "Failed to send data to user " + std::to_string(client_fd) +
+			": " + response);
+		} else {
+			Logger::log(Logger::DEBUG, "Sent successfully "+ std::to_string(client_fd) + ": " + response);
 		}
+		Logger::log(Logger::ERROR, "Server has reached its user maximum");
+		close(client_fd);
+		return nullptr;
+	}
 
-		// Because the Client(client_fd) will return client&, but in Clients_
-		// the key value is std::shared_ptr type. So need use "std::make_shared"
-		// to match the return value
-        clients_[client_fd] = std::make_shared<Client>(client_fd, host);
-		n_user_++;
-        Logger::log(Logger::INFO, "New client " + std::to_string(client_fd));
-    }
+	// Because the Client(client_fd) will return client&, but in Clients_
+	// the key value is std::shared_ptr type. So need use "std::make_shared"
+	// to match the return value
+	std::shared_ptr<Client>	client = std::make_shared<Client>(client_fd, host);
+	client->setWorkerId(w.id);
+	client->touch(w.timers.now());
+	w.timers.schedule(client->getTimer(), config_.registration_timeout);
+	clients_[client_fd] = client;
+	n_user_++;
+	Logger::log(Logger::INFO, "New client " + std::to_string(client_fd)
+		+ " on worker " + std::to_string(w.id));
+	return client;
 }
 
 /**
- * @brief This function will first try to receive the data from client socket first. If
- * receive successfully, then store it in client instantiation; otherwise, it means
- * the client wants to close the connection. Second, if the receive the client data
- * succeffuly, then get the line separate by CRLF, saving into buffer. then parse it,
- * execute it.
+ * @brief A connection was accepted by the loop of the running worker.
  */
-void	Server::processDataFromClient(int idx){
-	int	client_fd = events_[idx].data.fd;
-	std::shared_ptr<Client> client = clients_[client_fd];
-	if (!client->receiveRawData()){
-		Logger::log(Logger::INFO, "Client '" + std::to_string(client_fd) + "' disconnected");
-		removeClient(*client, "Client disconnect");
+std::shared_ptr<Client>	Server::onAccept(int fd, const std::string& host){
+	return registerClient(*current_worker_, fd, host);
+}
+
+/**
+ * @brief The loop received data from the client, get the lines separate by CRLF,
+ * parse and execute them.
+ *
+ * Reading and parsing run without the lock, only the command execution takes
+ * state_mutex_.
+ *
+ * @return true when lines are left for the client's next turn
+ */
+bool	Server::onData(Client& cli){
+	cli.touch(current_worker_->timers.now());
+	try {
+		return runClientCommands(cli.shared_from_this());
+	}catch (std::invalid_argument& e){
+		Logger::log(Logger::WARNING, e.what());
+	} catch (std::exception& e){
+		Logger::log(Logger::ERROR, e.what());
+	}
+	return false;
+}
+
+/**
+ * @brief The client closed the connection(or it broke), remove it.
+ */
+void	Server::onDisconnect(Client& cli, const std::string& reason){
+	Logger::log(Logger::INFO, "Client '" + std::to_string(cli.getSocketFd()) + "' disconnected");
+	std::lock_guard<std::mutex>	lock(state_mutex_);
+	removeClient(cli, reason);
+}
+
+void	Server::onWriteError(Client& cli){
+	Logger::log(Logger::WARNING, "Failed to send data to client " + std::to_string(cli.getSocketFd()));
+	scheduleRemoval(cli, "Write error");
+}
+
+/**
+ * @brief Replies handed over by other workers, or shutdown.
+ */
+void	Server::onWake(){
+	drainMailbox(*current_worker_);
+}
+
+/**
+ * @brief One second(or more, if the loop fell behind) passed: fire the due
+ * timers of the worker's clients.
+ */
+void	Server::onTick(uint64_t n_ticks){
+	Worker&					w = *current_worker_;
+	std::vector<TimerNode*>	expired;
+	w.timers.advance(n_ticks, expired);
+	if (expired.empty()){
+		return;
+	}
+	std::lock_guard<std::mutex>	lock(state_mutex_);
+	for (TimerNode* node : expired){
+		checkLiveness(w, *node->client);
+	}
+}
+
+/**
+ * @brief The timer of a client fired. A connection that didn't register in
+ * time, or didn't answer our PING, is dropped. A client quiet for
+ * ping_interval gets a PING and pong_timeout to answer; anything it sends
+ * counts(Client::touch()). Otherwise the timer is set for the moment it will
+ * have been quiet that long, so a busy client costs nothing between checks.
+ */
+void	Server::checkLiveness(Worker& w, Client& cli){
+	if (cli.isDisconnected()){
+		return;
+	}
+	if (!cli.isRegistered()){
+		scheduleRemoval(cli, "Registration timeout");
+		return;
+	}
+	if (cli.isAwaitingPong()){
+		scheduleRemoval(cli, "Ping timeout: " + std::to_string(config_.pong_timeout) + " seconds");
 		return;
 	}
-	std::string	buffer;
-	// extract one line command/message that separate by CRLF
-	while (client->getNextMessage(buffer)){
+	uint64_t	idle = w.timers.now() - cli.getLastActive();
+	uint64_t	interval = config_.ping_interval;
+	if (idle >= interval){
+		responseToClient(cli, "PING :" + std::string(SERVER) + "\r\n");
+		cli.setAwaitingPong(true);
+		w.timers.schedule(cli.getTimer(), config_.pong_timeout);
+	} else {
+		w.timers.schedule(cli.getTimer(), interval - idle);
+	}
+}
+
+/**
+ * @brief Parse and execute the complete lines waiting in the client's receive
+ * buffer, one CLIENT_COMMAND_BUDGET worth(CommandTable::cost()) per turn. The
+ * shared_ptr keeps the client alive if a command removes it.
+ *
+ * The budget is a deficit round robin: the command that runs it out still runs
+ * and what it overspent is taken from the next turns, so a client sending
+ * expensive commands runs as few per turn as their cost says, and one that
+ * was idle starts again with a single budget, not with what it saved up.
+ *
+ * @return true when complete lines are left
+ */
+bool	Server::runClientCommands(std::shared_ptr<Client> client){
+	int					credit = std::min(client->getCommandCredit() + CLIENT_COMMAND_BUDGET,
+		CLIENT_COMMAND_BUDGET);
+	std::string_view	line;
+	// extract one line command/message that separate by CRLF. Stop as soon as the
+	// client is gone(QUIT, or its send queue overflowed)
+	for (; credit > 0 && !client->isDisconnected() && client->getNextMessage(line);){
+		if (Logger::enabled(Logger::DEBUG)){
+			Logger::log(Logger::DEBUG, "Received from " + std::to_string(client->getSocketFd())
+				+ ": " + std::string(line));
+		}
 		try{
-			Message	msg(buffer);
+			// parsed in place, line stays valid until the next getNextMessage()
+			Message	msg(line);
+			credit--; // a line that doesn't parse costs 1
 			msg.parseMessage();
+			credit -= static_cast<int>(CommandTable::cost(msg)) - 1;
+			std::lock_guard<std::mutex>	lock(state_mutex_);
 			executeCommand(msg, *client);
 		} catch (std::exception& e){
 			Logger::log(Logger::WARNING, e.what());
 		}
 	}
+	client->setCommandCredit(credit);
+	return !client->isDisconnected() && client->hasCompleteMessage();
 }
 
 /**
@@ -366,20 +723,18 @@ void	Server::removeClient(Client& usr, std::string reason){
 		}
 		++it;
 	}
-	// 2.Remove from epoll container
-	auto it = std::remove_if(events_.begin(), events_.end(),[usr_fd](const epoll_event& ev){
-		return ev.data.fd == usr_fd;
-	});
-	if (it != events_.end()){
-		events_.erase(it, events_.end());
-	}
-
-	// 3.Inform the kernel to remove the file descriptor from the actual epoll monitoring set
-	epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, usr_fd, nullptr);
-
-	// 4. Remove from Clients map
+	// 2.Stop watching the socket. Only the owner worker removes a client, so this
+	// is the running loop.
+	workers_[usr.getWorkerId()]->loop->removeClient(usr);
+	workers_[usr.getWorkerId()]->timers.cancel(usr.getTimer());
+
+	// 3. Remove from Clients map
+	removeNick(usr);
+	usr.markDisconnected();
     close(usr_fd);
-	clients_.erase(usr_fd);
+	if (clients_.erase(usr_fd)){
+		n_user_--;
+	}
 	Logger::log(Logger::INFO, "Removing client " + std::to_string(usr_fd) + ": " + reason);
 }
 
@@ -405,61 +760,168 @@ void Server::removeChannel(const std::string& channel_name) {
 
 /**
  * @brief If the client hasn't finished registration process, and execute no-permission-
- * command, then just return. Otherwise, call Message::execute to execute the command
+ * command, then just return. Otherwise, call the command's method from the
+ * CommandTable, found by the parser.
  *
  */
 void	Server::executeCommand(Message& msg, Client& cli){
-	COMMANDTYPE	cmd_type = msg.getCommandType();
-	std::string cmd_str_type = msg.getCommandString();
+	const CommandDescriptor*	command = msg.getCommand();
 
-	if (cmd_type == INVALID){
-		responseToClient(cli, unknowCommand(cli.getNick(), cmd_str_type));
+	if (command == nullptr){
+		responseToClient(cli, unknowCommand(cli.getNick(), std::string(msg.getCommandString())));
 		return;
 	}
 	// Before the user sends the correct password, he/she can't execute any commands
-	if (cli.getPassword().empty()){
-		if (cmd_type != PASS && cmd_type != CAP && cmd_type != PING && cmd_type != WHOIS){
-			responseToClient(cli, passwdMismatch(cli.getNick()));
-			Logger::log(Logger::WARNING, "User hasn't sent correct password yet, can't execute the command");
-			return;
-		}
+	// but PASS, CAP, PING and WHOIS
+	if (cli.getPassword().empty() && !(command->flags & COMMAND_BEFORE_PASS)){
+		responseToClient(cli, passwdMismatch(cli.getNick()));
+		Logger::log(Logger::WARNING, "User hasn't sent correct password yet, can't execute the command");
+		return;
 	}
 	// 1.If the client hasn't finished registration, then the user can not operate
-	// the commands except PASS, NICK, USER and QUIT
-	if (!cli.isRegistered() && pre_registration_allowed_commands_.find(cmd_type)
-		== pre_registration_allowed_commands_.end() ){
+	// the commands except PASS, NICK, USER, QUIT and the few others marked so
+	if (!cli.isRegistered() && !(command->flags & COMMAND_BEFORE_REGISTRATION)){
 		Logger::log(Logger::WARNING, "Unregistered client can't execute the command");
-		responseToClient(cli, NotRegistered(cmd_str_type));
+		responseToClient(cli, NotRegistered(std::string(command->name)));
 		return;
 	}
-	// 2. Find the matched command, then call that command; otherwise, response
-	// unknowncommand error
-	std::unordered_map<COMMANDTYPE, executeFunc>::const_iterator it =
-		execute_map_.find(cmd_type);
-	if (it != execute_map_.end()){
-		(this->*it->second)(msg, cli);
-	} else {
-		responseToClient(cli, unknowCommand(cli.getNick(), cmd_str_type));
-	}
+	// 2. Call the matched command
+	(this->*command->execute)(msg, cli);
 }
 
 /**
  * @brief Send response message to client
  *
+ * The response is appended to the client's send queue. If the queue was empty the
+ * client is handed to the worker's loop(EventLoop::startSend), which writes
+ * every reply of the turn with one vectored send before it waits again(a JOIN's
+ * replies, or all the lines a fanout gave one member, cost one syscall);
+ * whatever the socket doesn't take stays queued and the loop finishes it later.
+ * It never blocks, so a slow reader can't stall a channel fanout.
+ *
+ * A client owned by another worker is never written from here: the reply is
+ * handed over to its worker's mailbox.
+ *
  * @param cli: the response message receiver
  * @param repsonse: the reponse message
  *
- * @return bytes written or throw error(negative value)
+ * @return bytes queued or -1 when the client is gone / being dropped
  */
 int	Server::responseToClient(Client& cli, const std::string& response){
-	int	n_bytes = send(cli.getSocketFd(), response.c_str(), response.length(), MSG_DONTWAIT);
-	if (n_bytes < 0){
-		Logger::log(Logger::WARNING, "Failed to send data to user " + cli.getNick() +
-		": " + response);
-	} else {
-		Logger::log(Logger::DEBUG, "Sent successfully "+ cli.getNick() + ": " + response);
+	if (cli.isDisconnected()){
+		return (-1);
+	}
+	return (responseToClient(cli, std::make_shared<const std::string>(response)));
+}
+
+/**
+ * @brief Same, for a message shared by several receivers(channel broadcast): only
+ * a reference is queued, the bytes are never copied per receiver.
+ */
+int	Server::responseToClient(Client& cli, const SharedMessage& response){
+	if (cli.isDisconnected()){
+		return (-1);
+	}
+	uint64_t	since = current_worker_ ? current_worker_->loop->getTurnStart() : 0;
+	if (current_worker_ && cli.getWorkerId() != current_worker_->id){
+		server_->postToWorker(cli, response, since);
+		return (response->length());
+	}
+	return (server_->queueToClient(cli, response, since));
+}
+
+/**
+ * @brief Queue a reply for a client of the running worker and try to write it.
+ *
+ * @param since: when the line behind the reply was read, for the relay latency
+ */
+int	Server::queueToClient(Client& cli, const SharedMessage& response, uint64_t since){
+	if (cli.isDisconnected()){
+		return (-1);
+	}
+	bool	was_idle = !cli.hasPendingOutput();
+	if (!cli.queueResponse(response, since)){
+		Logger::log(Logger::WARNING, "Send queue of client " + std::to_string(cli.getSocketFd())
+		+ " exceeded " + std::to_string(CLIENT_SENDQ_LIMIT) + " bytes");
+		scheduleRemoval(cli, "Max SendQ exceeded");
+		return (-1);
+	}
+	// built only when it's printed, it would copy every broadcast per receiver
+	if (Logger::enabled(Logger::DEBUG)){
+		Logger::log(Logger::DEBUG, "Queued for "+ std::to_string(cli.getSocketFd()) + ": " + *response);
+	}
+	// when data is already waiting, the loop already has the client and keeps
+	// the order
+	if (was_idle){
+		workers_[cli.getWorkerId()]->loop->startSend(cli);
+	}
+	return (response->length());
+}
+
+/**
+ * @brief Hand a reply over to the worker owning the client. The owner is only
+ * woken when its mailbox goes from empty to non-empty, a burst costs one wakeup.
+ */
+void	Server::postToWorker(Client& cli, const SharedMessage& response, uint64_t since){
+	Worker&	w = *workers_[cli.getWorkerId()];
+	bool	was_empty;
+	{
+		std::lock_guard<std::mutex>	lock(w.mailbox_mutex);
+		was_empty = w.mailbox.empty();
+		w.mailbox.push_back({cli.shared_from_this(), response, since});
+	}
+	if (was_empty){
+		w.loop->wake();
+	}
+}
+
+/**
+ * @brief Move the replies other workers handed over into the send queues of our
+ * clients, in the order they were posted.
+ */
+void	Server::drainMailbox(Worker& w){
+	std::vector<MailboxEntry>	batch;
+	{
+		std::lock_guard<std::mutex>	lock(w.mailbox_mutex);
+		batch.swap(w.mailbox);
+	}
+	for (auto& [cli, response, since] : batch){
+		queueToClient(*cli, response, since);
+	}
+}
+
+/**
+ * @brief Mark a client to be removed once the current loop iteration is done.
+ * Used from the send path, where the client can't be removed right away because
+ * the caller may be walking a channel's user list.
+ */
+void	Server::scheduleRemoval(Client& cli, const std::string& reason){
+	if (cli.isDisconnected()){
+		return;
+	}
+	cli.markDisconnected();
+	workers_[cli.getWorkerId()]->pending_removals.emplace_back(cli.shared_from_this(), reason);
+}
+
+/**
+ * @brief Remove the clients collected by scheduleRemoval(). Removing a client
+ * notifies its channels, which can schedule more removals, so loop until empty.
+ */
+void	Server::reapClients(Worker& w){
+	if (w.pending_removals.empty()){
+		return;
+	}
+	std::lock_guard<std::mutex>	lock(state_mutex_);
+	while (!w.pending_removals.empty()){
+		auto	pending = std::move(w.pending_removals);
+		w.pending_removals.clear();
+		for (auto& [cli, reason] : pending){
+			auto	it = clients_.find(cli->getSocketFd());
+			if (it != clients_.end() && it->second == cli){
+				removeClient(*cli, reason);
+			}
+		}
 	}
-	return (n_bytes);
 }
 
 /**
@@ -479,19 +941,19 @@ std::string Server::getChannelsOfUser(Client& client){
 }
 
 /**
- * @brief Finds a client by their nickname.
+ * @brief Finds a registered client by their nickname, case-insensitively
+ * (RFC 1459 casemapping).
  *
  * @param nick: The nickname of the client to search for.
  * @return Pointer to the Client if found, nullptr otherwise.
  */
 // we can't return a reference, becasue it might be a nullptr
  std::shared_ptr<Client>	Server::getUserByNick(const std::string& user_nick) const{
-	for (auto& [fd, user] : clients_){
-		if (user && user->getNick() == user_nick){
-			return user;
-		}
+	auto	it = nicks_.find(casemapNick(user_nick));
+	if (it == nicks_.end()){
+		return nullptr;
 	}
-	return nullptr;
+	return it->second;
 }
 
 /**
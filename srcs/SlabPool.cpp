@@ -0,0 +1,177 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   SlabPool.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/29 14:03:51 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/29 14:03:51 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "SlabPool.hpp"
+#include "Logger.hpp"
+#include <mutex>
+#include <atomic>
+#include <sys/mman.h>
+
+namespace {
+
+// a free chunk links to the next one through its own first bytes
+struct FreeChunk{
+	FreeChunk*	next;
+};
+
+struct FreeList{
+	FreeChunk*	head = nullptr;
+	size_t		length = 0;
+
+	void	push(FreeChunk* chunk){
+		chunk->next = head;
+		head = chunk;
+		length++;
+	}
+	FreeChunk*	pop(){
+		FreeChunk*	chunk = head;
+		head = chunk->next;
+		length--;
+		return chunk;
+	}
+	// move up to n chunks to other
+	void	moveTo(FreeList& other, size_t n){
+		while (n-- > 0 && head != nullptr){
+			other.push(pop());
+		}
+	}
+};
+
+struct SizeClass{
+	std::mutex	mutex;
+	FreeList	free;
+};
+
+SizeClass			classes[SLAB_CLASSES];
+std::atomic<bool>	huge_pages{false};
+std::atomic<size_t>	reserved_bytes{0};
+
+/**
+ * @brief The chunks of one thread that no client holds. Given back to the global
+ * lists when the thread ends.
+ */
+struct ThreadCache{
+	FreeList	free[SLAB_CLASSES];
+
+	~ThreadCache(){
+		for (int i = 0; i < SLAB_CLASSES; i++){
+			std::lock_guard<std::mutex>	lock(classes[i].mutex);
+			free[i].moveTo(classes[i].free, free[i].length);
+		}
+	}
+};
+
+thread_local ThreadCache	cache;
+
+int	classOf(size_t n_bytes){
+	int	shift = SLAB_MIN_SHIFT;
+	while ((static_cast<size_t>(1) << shift) < n_bytes){
+		shift++;
+	}
+	return shift - SLAB_MIN_SHIFT;
+}
+
+void*	mapSlab(){
+	void*	slab = MAP_FAILED;
+	if (huge_pages){
+		slab = mmap(nullptr, SLAB_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+	if (slab == MAP_FAILED){
+		slab = mmap(nullptr, SLAB_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (slab == MAP_FAILED){
+			throw std::bad_alloc();
+		}
+		if (huge_pages){
+			madvise(slab, SLAB_SIZE, MADV_HUGEPAGE);
+		}
+	}
+	reserved_bytes += SLAB_SIZE;
+	return slab;
+}
+
+/**
+ * @brief Fill an empty thread cache with up to half of SLAB_CACHE_CHUNKS chunks
+ * from the global list. A new slab is mapped only when the list is empty: the
+ * chunks other threads gave back are used up first, even if fewer than half.
+ */
+void	refill(int index){
+	SizeClass&	size_class = classes[index];
+	std::lock_guard<std::mutex>	lock(size_class.mutex);
+
+	if (size_class.free.head == nullptr){
+		size_t	chunk_size = static_cast<size_t>(1) << (index + SLAB_MIN_SHIFT);
+		char*	slab = static_cast<char*>(mapSlab());
+		for (size_t offset = 0; offset < SLAB_SIZE; offset += chunk_size){
+			size_class.free.push(reinterpret_cast<FreeChunk*>(slab + offset));
+		}
+	}
+	size_class.free.moveTo(cache.free[index], SLAB_CACHE_CHUNKS / 2);
+}
+
+} // namespace
+
+/**
+ * @brief What a request for n_bytes really gets: the chunk size it falls in,
+ * or n_bytes itself above the largest chunk.
+ */
+size_t	SlabPool::chunkSize(size_t n_bytes){
+	if (n_bytes > (static_cast<size_t>(1) << SLAB_MAX_SHIFT)){
+		return n_bytes;
+	}
+	return static_cast<size_t>(1) << (classOf(n_bytes) + SLAB_MIN_SHIFT);
+}
+
+void*	SlabPool::allocate(size_t n_bytes){
+	if (n_bytes > (static_cast<size_t>(1) << SLAB_MAX_SHIFT)){
+		return ::operator new(n_bytes);
+	}
+	int	index = classOf(n_bytes);
+	if (cache.free[index].head == nullptr){
+		refill(index);
+	}
+	return cache.free[index].pop();
+}
+
+/**
+ * @brief Give back a chunk of allocate(n_bytes). A thread cache holding
+ * SLAB_CACHE_CHUNKS of its size hands half of them to the global list.
+ */
+void	SlabPool::release(void* chunk, size_t n_bytes){
+	if (n_bytes > (static_cast<size_t>(1) << SLAB_MAX_SHIFT)){
+		::operator delete(chunk);
+		return;
+	}
+	int			index = classOf(n_bytes);
+	FreeList&	free = cache.free[index];
+
+	free.push(static_cast<FreeChunk*>(chunk));
+	if (free.length >= SLAB_CACHE_CHUNKS){
+		std::lock_guard<std::mutex>	lock(classes[index].mutex);
+		free.moveTo(classes[index].free, SLAB_CACHE_CHUNKS / 2);
+	}
+}
+
+/**
+ * @brief Map the next slabs in huge pages. Set before the workers start.
+ */
+void	SlabPool::setHugePages(bool enabled){
+	huge_pages = enabled;
+}
+
+/**
+ * @brief Memory mapped for slabs so far, in use or not.
+ */
+size_t	SlabPool::getReservedBytes(){
+	return reserved_bytes;
+}
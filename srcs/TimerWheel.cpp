@@ -0,0 +1,104 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TimerWheel.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/26 09:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/26 09:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "TimerWheel.hpp"
+
+TimerWheel::TimerWheel() : now_(0){
+	// every slot is an empty circular list
+	for (auto& level : slots_){
+		for (TimerNode& head : level){
+			head.prev = &head;
+			head.next = &head;
+		}
+	}
+}
+
+uint64_t	TimerWheel::now() const{
+	return now_;
+}
+
+void	TimerWheel::schedule(TimerNode& node, uint64_t ticks){
+	cancel(node);
+	node.expires = now_ + (ticks ? ticks : 1);
+	link(node);
+}
+
+void	TimerWheel::cancel(TimerNode& node){
+	if (!node.prev){
+		return;
+	}
+	node.prev->next = node.next;
+	node.next->prev = node.prev;
+	node.prev = nullptr;
+	node.next = nullptr;
+}
+
+/**
+ * @brief Put the node in the slot of its expiry, in the lowest level that
+ * reaches it. Further than the top level reaches, it waits in the farthest slot
+ * and is placed again when that slot is spread.
+ */
+void	TimerWheel::link(TimerNode& node){
+	uint64_t	delta = node.expires > now_ ? node.expires - now_ : 0;
+	int			level = 0;
+	while (level < TIMER_WHEEL_LEVELS - 1
+		&& delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1)))){
+		level++;
+	}
+	uint64_t	max_delta = (1ULL << (TIMER_WHEEL_BITS * (level + 1))) - 1;
+	uint64_t	at = delta > max_delta ? now_ + max_delta : node.expires;
+	TimerNode&	head = slots_[level][(at >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+	node.prev = head.prev;
+	node.next = &head;
+	head.prev->next = &node;
+	head.prev = &node;
+}
+
+/**
+ * @brief Take every timer of the current slot of level and place it again, now
+ * that it is closer it lands in a lower level.
+ */
+void	TimerWheel::cascade(int level){
+	TimerNode&	head = slots_[level][(now_ >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+	TimerNode*	node = head.next;
+	head.prev = &head;
+	head.next = &head;
+	while (node != &head){
+		TimerNode*	next = node->next;
+		link(*node);
+		node = next;
+	}
+}
+
+void	TimerWheel::advance(uint64_t n_ticks, std::vector<TimerNode*>& expired){
+	for (; n_ticks > 0; n_ticks--){
+		now_++;
+		// a level 0 round is done: bring the next slot of the levels above down,
+		// the highest level whose round is also done first
+		if ((now_ & (TIMER_WHEEL_SLOTS - 1)) == 0){
+			int	top = 1;
+			while (top < TIMER_WHEEL_LEVELS - 1
+				&& (now_ & ((1ULL << (TIMER_WHEEL_BITS * (top + 1))) - 1)) == 0){
+				top++;
+			}
+			for (int level = top; level >= 1; level--){
+				cascade(level);
+			}
+		}
+		TimerNode&	head = slots_[0][now_ & (TIMER_WHEEL_SLOTS - 1)];
+		while (head.next != &head){
+			TimerNode*	node = head.next;
+			cancel(*node);
+			expired.push_back(node);
+		}
+	}
+}
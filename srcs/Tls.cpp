@@ -0,0 +1,158 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Tls.cpp                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 15:41:07 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 15:41:07 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Tls.hpp"
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <stdexcept>
+#include <cerrno>
+
+/**
+ * @brief The last OpenSSL error of this thread, as text.
+ */
+static std::string	tlsError(){
+	char	buf[256] = "unknown error";
+	if (unsigned long code = ERR_get_error()){
+		ERR_error_string_n(code, buf, sizeof(buf));
+	}
+	ERR_clear_error();
+	return buf;
+}
+
+TlsContext::TlsContext(const std::string& cert_file, const std::string& key_file, bool ktls){
+	ctx_ = SSL_CTX_new(TLS_server_method());
+	if (!ctx_){
+		throw std::runtime_error("Error: SSL_CTX_new: " + tlsError());
+	}
+	if (SSL_CTX_use_certificate_chain_file(ctx_, cert_file.c_str()) != 1
+		|| SSL_CTX_use_PrivateKey_file(ctx_, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+		|| SSL_CTX_check_private_key(ctx_) != 1){
+		std::string	error = tlsError();
+		SSL_CTX_free(ctx_);
+		throw std::runtime_error("Error: TLS certificate " + cert_file + " / key "
+			+ key_file + ": " + error);
+	}
+	SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+	// partial writes: a full socket doesn't hold back a whole record batch, and
+	// the retry may come from a rebuilt buffer holding the same bytes
+	SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER
+		| SSL_MODE_RELEASE_BUFFERS);
+	// resumption: stateless tickets(TLS 1.3 and 1.2) from the keys of this
+	// context, the server keeps no per-session memory
+	SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+	SSL_CTX_set_num_tickets(ctx_, 1);
+	SSL_CTX_set_session_id_context(ctx_, reinterpret_cast<const unsigned char*>("ircserv"), 7);
+	if (ktls){
+		SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+	}
+}
+
+TlsContext::~TlsContext(){
+	SSL_CTX_free(ctx_);
+}
+
+SSL_CTX*	TlsContext::get() const{
+	return ctx_;
+}
+
+TlsSession::TlsSession(TlsContext& ctx, int fd) : established_(false), wants_write_(false){
+	ssl_ = SSL_new(ctx.get());
+	if (!ssl_ || SSL_set_fd(ssl_, fd) != 1){
+		SSL_free(ssl_);
+		throw std::runtime_error("Error: SSL_new: " + tlsError());
+	}
+	SSL_set_accept_state(ssl_);
+}
+
+/**
+ * @brief No close_notify: the socket is closed right after(or already broken),
+ * and waiting for the peer's answer would block.
+ */
+TlsSession::~TlsSession(){
+	SSL_free(ssl_);
+}
+
+/**
+ * @brief Go on with the handshake as far as the socket allows.
+ */
+TLS_STATUS	TlsSession::handshake(){
+	int	ret = SSL_do_handshake(ssl_);
+	if (ret == 1){
+		established_ = true;
+		wants_write_ = false;
+		return TLS_STATUS::DONE;
+	}
+	return result(ret) < 0 && errno == EAGAIN ? TLS_STATUS::WANT_IO : TLS_STATUS::FAILED;
+}
+
+bool	TlsSession::isEstablished() const{
+	return established_;
+}
+
+bool	TlsSession::wantsWrite() const{
+	return wants_write_;
+}
+
+bool	TlsSession::isResumed() const{
+	return SSL_session_reused(ssl_) == 1;
+}
+
+bool	TlsSession::isKtlsSend() const{
+	return BIO_get_ktls_send(SSL_get_wbio(ssl_)) == 1;
+}
+
+bool	TlsSession::isKtlsRecv() const{
+	return BIO_get_ktls_recv(SSL_get_rbio(ssl_)) == 1;
+}
+
+/**
+ * @brief Decrypted data, at most one record per call: a short read doesn't mean
+ * the socket is drained.
+ *
+ * @return bytes read, 0 when the peer closed the TLS session, -1 otherwise
+ */
+ssize_t	TlsSession::read(char* buf, size_t len){
+	return result(SSL_read(ssl_, buf, len));
+}
+
+/**
+ * @brief Encrypt and send up to len bytes. After -1/EAGAIN the next call must
+ * start with the same bytes(it may be longer).
+ */
+ssize_t	TlsSession::write(const char* buf, size_t len){
+	return result(SSL_write(ssl_, buf, len));
+}
+
+/**
+ * @brief Map the result of an SSL call to the recv()/send() convention.
+ */
+ssize_t	TlsSession::result(int ret){
+	wants_write_ = false;
+	if (ret > 0){
+		return ret;
+	}
+	switch (SSL_get_error(ssl_, ret)){
+		case SSL_ERROR_WANT_WRITE:
+			wants_write_ = true;
+			errno = EAGAIN;
+			return -1;
+		case SSL_ERROR_WANT_READ:
+			errno = EAGAIN;
+			return -1;
+		case SSL_ERROR_ZERO_RETURN:
+			return 0;
+		default:
+			ERR_clear_error();
+			errno = EIO;
+			return -1;
+	}
+}
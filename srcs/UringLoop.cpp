@@ -0,0 +1,473 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   UringLoop.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: jingwu <jingwu@student.hive.fi>            +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/05/24 13:16:55 by jingwu            #+#    #+#             */
+/*   Updated: 2025/05/24 13:16:55 by jingwu           ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "UringLoop.hpp"
+#include "Client.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <poll.h> // for POLLIN
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// user_data of a request: the Client address with the request type in the low
+// bits(a Client is at least 8 bytes aligned). An accept carries its listening
+// socket instead, the wake and timer polls nothing.
+#define URING_OP_MASK (7ULL)
+#define URING_OP_SHIFT (3)
+#define URING_OP_ACCEPT (1ULL)
+#define URING_OP_WAKE (2ULL)
+#define URING_OP_RECV (3ULL)
+#define URING_OP_SEND (4ULL)
+#define URING_OP_CANCEL (5ULL)
+#define URING_OP_TIMER (6ULL)
+
+static uint64_t	userData(Client* cli, uint64_t op){
+	return reinterpret_cast<uint64_t>(cli) | op;
+}
+
+static uint64_t	acceptData(int listen_fd){
+	return (static_cast<uint64_t>(listen_fd) << URING_OP_SHIFT) | URING_OP_ACCEPT;
+}
+
+UringLoop::UringLoop() : n_accepts_(0), quiescing_(false), ring_(URING_ENTRIES){
+	ring_.setupBufferRing(URING_BUF_GROUP, URING_BUF_COUNT, URING_BUF_SIZE);
+	armWake();
+	armTimer();
+}
+
+const char*	UringLoop::getName() const{
+	return "io_uring";
+}
+
+void	UringLoop::addListener(int fd){
+	listeners_.push_back(fd);
+	armAccept(fd);
+}
+
+void	UringLoop::addClient(const std::shared_ptr<Client>& cli){
+	clients_[cli.get()] = cli;
+	armRecv(*cli);
+}
+
+/**
+ * @brief The requests hold their own reference to the socket, close() alone
+ * wouldn't end them: shutdown() makes them complete. The Client is released
+ * with the last completion.
+ */
+void	UringLoop::removeClient(Client& cli){
+	shutdown(cli.getSocketFd(), SHUT_RDWR);
+	closing_.push_back(cli.shared_from_this());
+	// its fd is about to be free again
+	resumeAccepts();
+}
+
+/**
+ * @brief Nothing is written here: the send goes out with the next submit.
+ */
+void	UringLoop::startSend(Client& cli){
+	if (!cli.isSendInflight()){
+		send_ready_.push_back(cli.shared_from_this());
+	}
+}
+
+void	UringLoop::runOnce(EventHandler& handler){
+	// hand the replies of the previous turn to the kernel and wait, one syscall.
+	// With clients on the ready list only collect what is there. With
+	// --busy-poll enter without waiting a while before blocking
+	submitSends();
+	size_t		n_listed = ready_list_.size();
+	bool		spinning;
+	uint64_t	spin_end = 0;
+	int			ret;
+	do {
+		spinning = !n_listed && keepSpinning(spin_end);
+		ret = n_listed || spinning ? ring_.submitAndPoll() : ring_.submitAndWait(1);
+	} while (spinning && ret >= 0 && ring_.cqReady() == 0);
+	startTurn(!n_listed, spinning);
+	if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY){
+		throw std::runtime_error("Error: io_uring_enter: " + std::string(strerror(-ret)));
+	}
+	// a bounded batch of what is already there: multishot recv keeps posting
+	// while we run, and the replies of this batch must go out before the next
+	handleCompletions(handler, std::min(ring_.cqReady(), URING_CQE_BATCH));
+	// every client with new data or lines left from earlier turns gets one line
+	// budget; the recv stays off while lines are left
+	for (size_t n_clients = ready_list_.size(); n_clients > 0 && !ready_list_.empty(); n_clients--){
+		std::shared_ptr<Client>	cli = popReadyList();
+		if (!cli){
+			continue;
+		}
+		try {
+			if (handler.onData(*cli)){
+				addToReadyList(*cli);
+				if (cli->isRecvArmed() && !cli->isDisconnected()){
+					cancelRecv(*cli);
+				}
+			} else if (cli->isInputClosed() && !cli->isDisconnected()){
+				handler.onDisconnect(*cli, "Client disconnect");
+			} else if (!cli->isDisconnected() && !cli->isRecvArmed()){
+				armRecv(*cli);
+			}
+		} catch (std::exception& e){
+			Logger::log(Logger::ERROR, e.what());
+		}
+	}
+	for (auto& cli : closing_){
+		releaseIfIdle(*cli);
+	}
+	closing_.clear();
+}
+
+/**
+ * @brief Take n_cqes completions off the ring and dispatch them.
+ */
+void	UringLoop::handleCompletions(EventHandler& handler, unsigned n_cqes){
+	for (; n_cqes > 0; n_cqes--){
+		io_uring_cqe*	cqe = ring_.peekCqe();
+		uint64_t	data = cqe->user_data;
+		int			res = cqe->res;
+		unsigned	flags = cqe->flags;
+		ring_.cqeSeen();
+		Client*		cli = reinterpret_cast<Client*>(data & ~URING_OP_MASK);
+		try {
+			switch (data & URING_OP_MASK){
+				case URING_OP_ACCEPT:
+					handleAccept(handler, static_cast<int>(data >> URING_OP_SHIFT), res, flags);
+					break;
+				case URING_OP_WAKE:
+					clearWake();
+					handler.onWake();
+					if (!(flags & IORING_CQE_F_MORE)){
+						armWake();
+					}
+					break;
+				case URING_OP_TIMER:
+					if (uint64_t n_ticks = clearTimer()){
+						resumeAccepts();
+						handler.onTick(n_ticks);
+					}
+					if (!(flags & IORING_CQE_F_MORE)){
+						armTimer();
+					}
+					break;
+				case URING_OP_RECV:
+					handleRecv(handler, *cli, res, flags);
+					break;
+				case URING_OP_SEND:
+					handleSend(handler, *cli, res);
+					break;
+			}
+		} catch (std::invalid_argument& e){
+			Logger::log(Logger::WARNING, e.what());
+		} catch (std::exception& e){
+			Logger::log(Logger::ERROR, e.what());
+		}
+	}
+}
+
+/**
+ * @brief Cancel what could still post a completion and wait for the rest. A
+ * client can't lose anything: a cancelled recv took nothing from the socket, a
+ * cancelled send wrote nothing and stays queued.
+ */
+void	UringLoop::quiesce(EventHandler& handler){
+	quiescing_ = true;
+	std::vector<uint64_t>	targets;
+	for (int fd : listeners_){
+		targets.push_back(acceptData(fd));
+	}
+	for (auto& [ptr, cli] : clients_){
+		if (cli->isRecvArmed()){
+			targets.push_back(userData(ptr, URING_OP_RECV));
+		}
+		if (cli->isSendInflight()){
+			targets.push_back(userData(ptr, URING_OP_SEND));
+		}
+	}
+	for (uint64_t target : targets){
+		if (!cancel(target)){
+			ring_.submit(); // the submission queue is full, make room
+			cancel(target);
+		}
+	}
+	for (;;){
+		bool	pending = n_accepts_ > 0;
+		for (auto it = clients_.begin(); !pending && it != clients_.end(); ++it){
+			pending = it->second->getIoPending() > 0;
+		}
+		if (!pending){
+			break;
+		}
+		int	ret = ring_.submitAndWait(1);
+		if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY){
+			throw std::runtime_error("Error: io_uring_enter: " + std::string(strerror(-ret)));
+		}
+		handleCompletions(handler, ring_.cqReady());
+	}
+	for (auto& cli : closing_){
+		releaseIfIdle(*cli);
+	}
+	closing_.clear();
+}
+
+void	UringLoop::armAccept(int listen_fd){
+	io_uring_sqe*	sqe = ring_.getSqe();
+	if (!sqe){
+		throw std::runtime_error("Error: io_uring submission queue is full");
+	}
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listen_fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = acceptData(listen_fd);
+	n_accepts_++;
+}
+
+/**
+ * @brief Arm the accepts that stopped on EMFILE/ENFILE/ENOBUFS/ENOMEM again, a
+ * client was removed or a tick passed.
+ */
+void	UringLoop::resumeAccepts(){
+	if (quiescing_){
+		return;
+	}
+	for (int fd : paused_listeners_){
+		armAccept(fd);
+	}
+	paused_listeners_.clear();
+}
+
+void	UringLoop::armWake(){
+	io_uring_sqe*	sqe = ring_.getSqe();
+	if (!sqe){
+		throw std::runtime_error("Error: io_uring submission queue is full");
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = wake_fd_;
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = userData(nullptr, URING_OP_WAKE);
+}
+
+void	UringLoop::armTimer(){
+	io_uring_sqe*	sqe = ring_.getSqe();
+	if (!sqe){
+		throw std::runtime_error("Error: io_uring submission queue is full");
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = timer_fd_;
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = userData(nullptr, URING_OP_TIMER);
+}
+
+/**
+ * @brief Multishot recv with buffer selection: one request keeps delivering data
+ * until it fails or the buffers run out.
+ */
+void	UringLoop::armRecv(Client& cli){
+	if (quiescing_){
+		return;
+	}
+	io_uring_sqe*	sqe = ring_.getSqe();
+	if (!sqe){
+		throw std::runtime_error("Error: io_uring submission queue is full");
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = cli.getSocketFd();
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUF_GROUP;
+	sqe->user_data = userData(&cli, URING_OP_RECV);
+	cli.increaseIoPending();
+	cli.setRecvArmed(true);
+}
+
+/**
+ * @brief Stop the multishot recv of a client that has lines left on the ready
+ * list: what it would keep delivering only piles up in the receive buffer.
+ * Left in the socket, the data holds the sender back(TCP backpressure).
+ * Its completion comes as -ECANCELED.
+ */
+void	UringLoop::cancelRecv(Client& cli){
+	// when the submission queue is full the recv keeps going, only the
+	// backpressure is lost
+	cancel(userData(&cli, URING_OP_RECV));
+}
+
+/**
+ * @brief Queue the cancellation of the request with user_data target.
+ *
+ * @return false when the submission queue is full
+ */
+bool	UringLoop::cancel(uint64_t target){
+	io_uring_sqe*	sqe = ring_.getSqe();
+	if (!sqe){
+		return false;
+	}
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = target;
+	sqe->user_data = userData(nullptr, URING_OP_CANCEL);
+	return true;
+}
+
+/**
+ * @brief For every client with queued replies and nothing in flight, submit one
+ * sendmsg covering up to CLIENT_SEND_IOV of them. A partial write completes
+ * early, the rest goes with the next turn.
+ */
+void	UringLoop::submitSends(){
+	if (send_ready_.empty()){
+		return;
+	}
+	std::vector<std::shared_ptr<Client>>	ready;
+	ready.swap(send_ready_);
+	for (auto& cli : ready){
+		if (cli->isDisconnected() || cli->isSendInflight()){
+			continue;
+		}
+		struct msghdr*	msg = cli->prepareSendMsg();
+		if (!msg){
+			continue;
+		}
+		io_uring_sqe*	sqe = ring_.getSqe();
+		if (!sqe){
+			// retried on the next turn
+			send_ready_.push_back(cli);
+			continue;
+		}
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = cli->getSocketFd();
+		sqe->addr = reinterpret_cast<uint64_t>(msg);
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = userData(cli.get(), URING_OP_SEND);
+		cli->increaseIoPending();
+		cli->setSendInflight(true);
+		stats_.send_calls++;
+	}
+}
+
+void	UringLoop::handleAccept(EventHandler& handler, int listen_fd, int res, unsigned flags){
+	bool	resource_error = res < 0 && isAcceptResourceError(-res);
+	if (resource_error){
+		noteAcceptFailure(-res);
+	}
+	// the multishot accept stopped, queue a new one. Out of fds or memory it
+	// would fail again at once: it waits for resumeAccepts()
+	if (!(flags & IORING_CQE_F_MORE)){
+		n_accepts_--;
+		if (resource_error){
+			paused_listeners_.push_back(listen_fd);
+		} else if (!quiescing_){
+			armAccept(listen_fd);
+		}
+	}
+	if (res < 0){
+		if (res != -ECANCELED && !resource_error){
+			Logger::log(Logger::WARNING, "accept failed: " + std::string(strerror(-res)));
+		}
+		return;
+	}
+	noteAcceptSuccess();
+	// get the host information
+	sockaddr_storage	client_addr;
+	socklen_t			clientLen = sizeof(client_addr);
+	std::string			host = "0.0.0.0";
+	if (getpeername(res, reinterpret_cast<sockaddr*>(&client_addr), &clientLen) == 0){
+		host = formatHost(res, reinterpret_cast<sockaddr*>(&client_addr));
+		tuneSocket(res, client_addr.ss_family);
+	}
+	std::shared_ptr<Client>	cli = handler.onAccept(res, host);
+	if (!cli){
+		return;
+	}
+	try {
+		addClient(cli);
+	} catch (std::exception& e){
+		Logger::log(Logger::ERROR, e.what());
+		handler.onDisconnect(*cli, "Internal error");
+	}
+}
+
+/**
+ * @brief Data(or end of stream) for a client. The provided buffer is copied into
+ * the client's receive buffer and given back to the kernel straight away, the
+ * client goes on the ready list.
+ */
+void	UringLoop::handleRecv(EventHandler& handler, Client& cli, int res, unsigned flags){
+	bool	more = flags & IORING_CQE_F_MORE;
+	if (flags & IORING_CQE_F_BUFFER){
+		uint16_t	bid = flags >> IORING_CQE_BUFFER_SHIFT;
+		if (res > 0 && !cli.isDisconnected()){
+			cli.appendRawData(ring_.getBuffer(bid), res);
+		}
+		ring_.recycleBuffer(bid);
+	}
+	if (!more){
+		cli.decreaseIoPending();
+		cli.setRecvArmed(false);
+	}
+	if (cli.isDisconnected()){
+		// nothing to do
+	} else if (res > 0){
+		// the lines run after this batch(one command budget per client and turn),
+		// that is also where a stopped recv is armed again
+		addToReadyList(cli);
+	} else if (res == -ENOBUFS || res == -ECANCELED){
+		// every provided buffer is in use(ask again), or cancelRecv(). A listed
+		// client gets it back from the ready list
+		if (!cli.isReadyListed()){
+			armRecv(cli);
+		}
+	} else if (cli.hasCompleteMessage()){
+		// the data often completes in the same batch as the end of stream: its
+		// lines run first, the client is removed once they are done
+		cli.markInputClosed();
+		addToReadyList(cli);
+	} else {
+		handler.onDisconnect(cli, res == 0 ? "Client disconnect" : "Read error");
+	}
+	releaseIfIdle(cli);
+}
+
+void	UringLoop::handleSend(EventHandler& handler, Client& cli, int res){
+	cli.decreaseIoPending();
+	cli.setSendInflight(false);
+	if (!cli.isDisconnected()){
+		if (res >= 0){
+			recordSend(cli);
+			stats_.replies_sent += cli.consumeSent(res);
+		} else if (res != -ECANCELED || !quiescing_){
+			handler.onWriteError(cli);
+		}
+	}
+	// send what is left or was queued meanwhile
+	if (!cli.isDisconnected() && cli.hasPendingOutput()){
+		send_ready_.push_back(cli.shared_from_this());
+	}
+	releaseIfIdle(cli);
+}
+
+/**
+ * @brief Free a removed client once the kernel returned every request that
+ * referenced it(and its send buffers). cli must not be used afterwards.
+ */
+void	UringLoop::releaseIfIdle(Client& cli){
+	if (cli.isDisconnected() && cli.getIoPending() == 0){
+		clients_.erase(&cli);
+	}
+}
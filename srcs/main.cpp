@@ -14,12 +14,17 @@
 #include "Server.hpp"
 
 int main(int ac, char** av){
-    if (ac != 3){
-        std::cerr << "Usage: ./ircserv <port> <password>\n";
+    if (ac < 3){
+        std::cerr << "Usage: ./ircserv <port> <password> [--workers N] [--backend poll|epoll|epoll-et|uring]"
+            " [--zerocopy BYTES] [--backlog N]"
+            " [--registration-timeout SEC] [--ping-interval SEC] [--pong-timeout SEC]"
+            " [--listen ADDR[:PORT]]... [--tls-listen ADDR[:PORT]]... [--tls-cert FILE]"
+            " [--tls-key FILE] [--ktls on|off] [--unix-listen PATH]... [--busy-poll USEC]"
+            " [--notsent-lowat BYTES] [--huge-pages on|off]\n";
         return EXIT_FAILURE;
     }
     try{
-        Server serv(av[1], av[2]);
+        Server serv(av[1], av[2], ServerConfig::parseOptions(ac, av, 3));
         serv.startServer();
         return EXIT_SUCCESS;
     }catch(const std::exception& e){